@@ -0,0 +1,202 @@
+/* bench-counters.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define G_LOG_DOMAIN "bench-counters"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+#endif
+
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
+#include "bench-counters.h"
+
+struct _BenchCounters
+{
+  /* An instruction counter for each thread of the process */
+  GArray *fds;
+  gssize  heap;
+};
+
+/*
+ * Returns the number of bytes allocated with malloc() which have not
+ * been freed, or -1 if the C library can not tell us.
+ */
+static gssize
+get_heap_in_use (void)
+{
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+  return mallinfo2 ().uordblks;
+#else
+  return (guint)mallinfo ().uordblks;
+#endif
+#else
+  return -1;
+#endif
+}
+
+#ifdef __linux__
+static gint
+open_instruction_counter (pid_t    tid,
+                          GError **error)
+{
+  struct perf_event_attr attr = { 0 };
+  gint fd;
+
+  attr.size = sizeof attr;
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1;
+
+  fd = syscall (__NR_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+  if (fd == -1)
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "perf_event_open: %s",
+                   g_strerror (errsv));
+    }
+
+  return fd;
+}
+#endif
+
+/*
+ * Counting has to happen for every thread, as queries and some of the
+ * loaders run in the GTask thread pool. Threads spawned during a stage
+ * are counted only once they exit, so callers should make sure the
+ * pool is warm before they begin a stage.
+ */
+static void
+open_instruction_counters (GArray *fds)
+{
+#ifdef __linux__
+  static gboolean warned;
+  g_autoptr(GDir) dir = NULL;
+  g_autoptr(GError) error = NULL;
+  const gchar *name;
+
+  if (NULL == (dir = g_dir_open ("/proc/self/task", 0, &error)))
+    goto failure;
+
+  while (NULL != (name = g_dir_read_name (dir)))
+    {
+      gint fd;
+
+      if (-1 == (fd = open_instruction_counter (g_ascii_strtoll (name, NULL, 10), &error)))
+        goto failure;
+
+      g_array_append_val (fds, fd);
+    }
+
+  return;
+
+failure:
+  if (!warned)
+    {
+      g_printerr ("Instruction counters are unavailable: %s\n", error->message);
+      warned = TRUE;
+    }
+
+  while (fds->len > 0)
+    {
+      close (g_array_index (fds, gint, fds->len - 1));
+      g_array_set_size (fds, fds->len - 1);
+    }
+#endif
+}
+
+/**
+ * bench_counters_begin:
+ *
+ * Starts counting for a stage of a benchmark, which is completed with
+ * bench_counters_end().
+ *
+ * Returns: (transfer full): A #BenchCounters
+ */
+BenchCounters *
+bench_counters_begin (void)
+{
+  BenchCounters *counters;
+
+  counters = g_slice_new0 (BenchCounters);
+  counters->fds = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  open_instruction_counters (counters->fds);
+
+  counters->heap = get_heap_in_use ();
+
+  return counters;
+}
+
+/**
+ * bench_counters_end:
+ * @counters: (transfer full): A #BenchCounters
+ * @stage: The name of the stage
+ *
+ * Stops counting and prints "@stage.instructions" and "@stage.heap"
+ * in the tab separated format used by the benchmarks. The heap is
+ * the number of bytes allocated during the stage which are still in
+ * use, such as the size of an index in memory.
+ */
+void
+bench_counters_end (BenchCounters *counters,
+                    const gchar   *stage)
+{
+  gssize heap = get_heap_in_use ();
+  guint64 instructions = 0;
+  guint i;
+
+  g_return_if_fail (counters != NULL);
+  g_return_if_fail (stage != NULL);
+
+  for (i = 0; i < counters->fds->len; i++)
+    {
+      gint fd = g_array_index (counters->fds, gint, i);
+      guint64 count;
+
+      if (read (fd, &count, sizeof count) == sizeof count)
+        instructions += count;
+
+      close (fd);
+    }
+
+  if (counters->fds->len > 0)
+    g_print ("%s.instructions\t%.3lf\tinstructions\n", stage, (gdouble)instructions);
+
+  if (heap != -1 && counters->heap != -1)
+    g_print ("%s.heap\t%.3lf\tbytes\n", stage, (gdouble)(heap - counters->heap));
+
+  g_array_unref (counters->fds);
+  g_slice_free (BenchCounters, counters);
+}
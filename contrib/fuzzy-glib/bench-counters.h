@@ -0,0 +1,40 @@
+/* bench-counters.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BENCH_COUNTERS_H
+#define BENCH_COUNTERS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Counters which are stable across runs on the same machine, unlike
+ * wall-clock time, so that benchmarks can be compared to a baseline.
+ * Counters that are not available on the host are not reported.
+ */
+typedef struct _BenchCounters BenchCounters;
+
+BenchCounters *bench_counters_begin (void);
+void           bench_counters_end   (BenchCounters *counters,
+                                     const gchar   *stage);
+
+G_END_DECLS
+
+#endif /* BENCH_COUNTERS_H */
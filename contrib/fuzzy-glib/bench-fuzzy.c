@@ -0,0 +1,344 @@
+/* bench-fuzzy.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro-benchmarks for fuzzy-glib using synthetic keys. Results are
+ * printed as tab separated "metric value unit" lines, so that runs on
+ * two commits can be compared with diff or a small script.
+ */
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench-counters.h"
+#include "fuzzy-glib.h"
+
+static gint     n_keys = 50000;
+static gint     min_len = 8;
+static gint     max_len = 32;
+static gint     n_queries = 1000;
+static gint     max_matches = 25;
+static gint     seed = 1234;
+static gchar   *alphabet;
+
+static GOptionEntry entries[] = {
+  { "keys", 'n', 0, G_OPTION_ARG_INT, &n_keys, "Number of keys to index", "N" },
+  { "min-length", 0, 0, G_OPTION_ARG_INT, &min_len, "Minimum key length", "N" },
+  { "max-length", 0, 0, G_OPTION_ARG_INT, &max_len, "Maximum key length", "N" },
+  { "alphabet", 'a', 0, G_OPTION_ARG_STRING, &alphabet, "Characters to generate keys from", "CHARS" },
+  { "queries", 'q', 0, G_OPTION_ARG_INT, &n_queries, "Number of queries of each kind", "N" },
+  { "max-matches", 'm', 0, G_OPTION_ARG_INT, &max_matches, "Maximum matches per query", "N" },
+  { "seed", 's', 0, G_OPTION_ARG_INT, &seed, "Seed for the key generator", "N" },
+  { NULL }
+};
+
+typedef struct
+{
+  GMainLoop  *main_loop;
+  GListModel *results;
+} QueryState;
+
+static void
+report (const gchar *metric,
+        gdouble      value,
+        const gchar *unit)
+{
+  g_print ("%s\t%.3lf\t%s\n", metric, value, unit);
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble da = *(const gdouble *)a;
+  gdouble db = *(const gdouble *)b;
+
+  return (da > db) - (da < db);
+}
+
+static gdouble
+percentile (GArray  *sorted,
+            gdouble  pct)
+{
+  guint pos;
+
+  if (sorted->len == 0)
+    return 0.0;
+
+  pos = (guint)ceil (pct / 100.0 * sorted->len);
+  pos = CLAMP (pos, 1, sorted->len);
+
+  return g_array_index (sorted, gdouble, pos - 1);
+}
+
+/*
+ * Generates an identifier-like key, with words separated by
+ * underscores, as that is what the indexes mostly contain.
+ */
+static gchar *
+generate_key (GRand       *rand,
+              const gchar *chars,
+              gsize        n_chars)
+{
+  GString *str;
+  gint len;
+  gint i;
+
+  len = g_rand_int_range (rand, min_len, max_len + 1);
+  str = g_string_sized_new (len);
+
+  for (i = 0; i < len; i++)
+    {
+      if (i > 0 && i + 1 < len && g_rand_int_range (rand, 0, 6) == 0 && str->str [str->len - 1] != '_')
+        g_string_append_c (str, '_');
+      else
+        g_string_append_c (str, chars [g_rand_int_range (rand, 0, n_chars)]);
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+query_cb (GObject      *object,
+          GAsyncResult *result,
+          gpointer      user_data)
+{
+  QueryState *state = user_data;
+  g_autoptr(GError) error = NULL;
+
+  state->results = fuzzy_index_query_finish (FUZZY_INDEX (object), result, &error);
+
+  if (error != NULL)
+    g_printerr ("%s\n", error->message);
+
+  g_main_loop_quit (state->main_loop);
+}
+
+static void
+run_queries (FuzzyIndex   *index,
+             const gchar  *name,
+             GPtrArray    *queries)
+{
+  g_autoptr(GMainLoop) main_loop = g_main_loop_new (NULL, FALSE);
+  g_autoptr(GArray) timings = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  g_autofree gchar *metric = NULL;
+  BenchCounters *counters;
+  guint n_results = 0;
+  guint i;
+
+  /* Warm up the thread pool so that every worker is counted */
+  if (queries->len > 0)
+    {
+      QueryState state = { main_loop, NULL };
+
+      fuzzy_index_query_async (index, g_ptr_array_index (queries, 0), max_matches, NULL, query_cb, &state);
+      g_main_loop_run (main_loop);
+      g_clear_object (&state.results);
+    }
+
+  metric = g_strdup_printf ("query.%s", name);
+  counters = bench_counters_begin ();
+
+  for (i = 0; i < queries->len; i++)
+    {
+      QueryState state = { main_loop, NULL };
+      gint64 begin;
+      gdouble usec;
+
+      begin = g_get_monotonic_time ();
+      fuzzy_index_query_async (index, g_ptr_array_index (queries, i), max_matches, NULL, query_cb, &state);
+      g_main_loop_run (main_loop);
+      usec = g_get_monotonic_time () - begin;
+
+      if (state.results != NULL)
+        n_results += g_list_model_get_n_items (state.results);
+      g_clear_object (&state.results);
+
+      g_array_append_val (timings, usec);
+    }
+
+  bench_counters_end (counters, metric);
+
+  g_array_sort (timings, compare_double);
+
+#define REPORT(suffix, value, unit) \
+  G_STMT_START { \
+    g_free (metric); \
+    metric = g_strdup_printf ("query.%s.%s", name, suffix); \
+    report (metric, value, unit); \
+  } G_STMT_END
+
+  REPORT ("p50", percentile (timings, 50), "usec");
+  REPORT ("p90", percentile (timings, 90), "usec");
+  REPORT ("p99", percentile (timings, 99), "usec");
+  REPORT ("max", percentile (timings, 100), "usec");
+  REPORT ("results", queries->len ? (gdouble)n_results / queries->len : 0.0, "matches");
+
+#undef REPORT
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GPtrArray) keys = NULL;
+  g_autoptr(GPtrArray) short_queries = NULL;
+  g_autoptr(GPtrArray) long_queries = NULL;
+  g_autoptr(GPtrArray) miss_queries = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GRand) rand = NULL;
+  g_autofree gchar *path = NULL;
+  BenchCounters *counters;
+  const gchar *miss_chars = "0123456789";
+  gsize n_chars;
+  gint64 begin;
+  gdouble elapsed;
+  gint fd;
+  gint i;
+
+  context = g_option_context_new ("- benchmark fuzzy-glib with synthetic keys");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (alphabet == NULL)
+    alphabet = g_strdup ("abcdefghijklmnopqrstuvwxyz");
+
+  n_chars = strlen (alphabet);
+
+  if (n_keys <= 0 || n_chars == 0 || min_len <= 0 || max_len < min_len)
+    {
+      g_printerr ("Invalid options\n");
+      return EXIT_FAILURE;
+    }
+
+  /* No-hit queries need characters which never appear in a key */
+  if (strpbrk (alphabet, miss_chars) != NULL)
+    miss_chars = "~";
+
+  rand = g_rand_new_with_seed (seed);
+  keys = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < n_keys; i++)
+    g_ptr_array_add (keys, generate_key (rand, alphabet, n_chars));
+
+  short_queries = g_ptr_array_new_with_free_func (g_free);
+  long_queries = g_ptr_array_new_with_free_func (g_free);
+  miss_queries = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < n_queries; i++)
+    {
+      const gchar *key = g_ptr_array_index (keys, g_rand_int_range (rand, 0, n_keys));
+      gsize len = strlen (key);
+      GString *str;
+      gsize j;
+
+      /* A few characters, as typed at the start of a search */
+      g_ptr_array_add (short_queries, g_strndup (key, MIN (len, 3)));
+
+      /* Every other character of a key, which forces the fuzzy walk */
+      str = g_string_new (NULL);
+      for (j = 0; j < len; j += 2)
+        g_string_append_c (str, key [j]);
+      g_ptr_array_add (long_queries, g_string_free (str, FALSE));
+
+      str = g_string_new (NULL);
+      for (j = 0; j < 6; j++)
+        g_string_append_c (str, miss_chars [g_rand_int_range (rand, 0, strlen (miss_chars))]);
+      g_ptr_array_add (miss_queries, g_string_free (str, FALSE));
+    }
+
+  report ("keys", n_keys, "keys");
+
+  /* Builder throughput */
+  builder = fuzzy_index_builder_new ();
+
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  for (i = 0; i < n_keys; i++)
+    fuzzy_index_builder_insert (builder, g_ptr_array_index (keys, i), g_variant_new_uint32 (i), 0);
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "build.insert");
+  report ("build.insert", elapsed * 1000.0, "msec");
+  report ("build.insert.rate", n_keys / MAX (elapsed, 1e-9), "keys/sec");
+
+  fd = g_file_open_tmp ("bench-fuzzy-XXXXXX.gvariant", &path, &error);
+  if (fd == -1)
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  close (fd);
+
+  file = g_file_new_for_path (path);
+
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  if (!fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_unlink (path);
+      return EXIT_FAILURE;
+    }
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "build.write");
+  report ("build.write", elapsed * 1000.0, "msec");
+  report ("build.write.rate", n_keys / MAX (elapsed, 1e-9), "keys/sec");
+
+  g_clear_object (&builder);
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, 0, NULL, NULL);
+  if (info != NULL)
+    {
+      report ("index.size", g_file_info_get_size (info), "bytes");
+      report ("index.size.per-key", g_file_info_get_size (info) / (gdouble)n_keys, "bytes");
+    }
+
+  /* Load time, which includes validating the checksum */
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  index = fuzzy_index_new ();
+  if (!fuzzy_index_load_file (index, file, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      g_unlink (path);
+      return EXIT_FAILURE;
+    }
+  report ("load", (g_get_monotonic_time () - begin) / 1000.0, "msec");
+  bench_counters_end (counters, "load");
+
+  run_queries (index, "short", short_queries);
+  run_queries (index, "long", long_queries);
+  run_queries (index, "miss", miss_queries);
+
+  g_unlink (path);
+
+  return EXIT_SUCCESS;
+}
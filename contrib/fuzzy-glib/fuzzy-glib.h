@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 # include "fuzzy-index-builder.h"
 # include "fuzzy-index-cursor.h"
 # include "fuzzy-index-match.h"
+# include "fuzzy-index-merge.h"
 # include "fuzzy-version.h"
 #undef FUZZY_GLIB_INSIDE
 
@@ -19,8 +19,10 @@
 #define G_LOG_DOMAIN "fuzzy-index-builder"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "fuzzy-index-builder.h"
+#include "fuzzy-index-private.h"
 #include "fuzzy-util.h"
 
 struct _FuzzyIndexBuilder
@@ -76,6 +78,13 @@ struct _FuzzyIndexBuilder
    */
   GArray *kv_pairs;
 
+  /*
+   * The static rank for each document, indexed by document id. This
+   * is only allocated once a rank is set, and documents past the end
+   * of the array have a rank of zero.
+   */
+  GArray *ranks;
+
   /*
    * Metadata for the search index, which is stored as the "metadata"
    * key in the final search index. You can use fuzzy_index_get_metadata()
@@ -96,6 +105,9 @@ typedef struct
 
   /* The position within the documents array of the document */
   guint document_id;
+
+  /* The priority of the key, lower values are preferred */
+  guint priority;
 } KVPair;
 
 typedef struct
@@ -110,6 +122,12 @@ typedef struct
   guint lookaside_id;
 } IndexItem;
 
+typedef struct
+{
+  const KVPair        *pairs;
+  const gchar * const *keys;
+} SortedState;
+
 G_DEFINE_TYPE (FuzzyIndexBuilder, fuzzy_index_builder, G_TYPE_OBJECT)
 
 enum {
@@ -129,6 +147,7 @@ fuzzy_index_builder_finalize (GObject *object)
   g_clear_pointer (&self->documents, g_ptr_array_unref);
   g_clear_pointer (&self->strings, g_string_chunk_free);
   g_clear_pointer (&self->kv_pairs, g_array_unref);
+  g_clear_pointer (&self->ranks, g_array_unref);
   g_clear_pointer (&self->metadata, g_hash_table_unref);
   g_clear_pointer (&self->key_ids, g_hash_table_unref);
 
@@ -214,9 +233,15 @@ fuzzy_index_builder_new (void)
  * @self: A #FuzzyIndexBuilder
  * @key: The UTF-8 encoded key for the document
  * @document: The document to store
+ * @priority: The priority of @key, with 0 being the most important
  *
  * Inserts @document into the index using @key as the lookup key.
  *
+ * @priority allows for a document inserted under multiple keys to
+ * prefer some of those keys over others, such as preferring a match
+ * on an identifier over a match on a description. Matches are scored
+ * as 1/(1+@priority) of what they would be with a priority of 0.
+ *
  * If a matching document (checked by hashing @document) has already
  * been inserted, only a single instance of the document will be stored.
  *
@@ -228,7 +253,8 @@ fuzzy_index_builder_new (void)
 guint64
 fuzzy_index_builder_insert (FuzzyIndexBuilder *self,
                             const gchar       *key,
-                            GVariant          *document)
+                            GVariant          *document,
+                            guint              priority)
 {
   GVariant *real_document = NULL;
   gpointer document_id = NULL;
@@ -256,16 +282,49 @@ fuzzy_index_builder_insert (FuzzyIndexBuilder *self,
     {
       key_id = GUINT_TO_POINTER (self->keys->len);
       g_ptr_array_add (self->keys, (gchar *)key);
+      g_hash_table_insert (self->key_ids, (gchar *)key, key_id);
     }
 
   pair.key_id = GPOINTER_TO_UINT (key_id);
   pair.document_id = GPOINTER_TO_UINT (document_id);
+  pair.priority = priority;
 
   g_array_append_val (self->kv_pairs, pair);
 
   return pair.document_id;
 }
 
+/**
+ * fuzzy_index_builder_set_document_rank:
+ * @self: A #FuzzyIndexBuilder
+ * @document_id: A document id returned from fuzzy_index_builder_insert()
+ * @rank: The static rank for the document
+ *
+ * Sets the static rank of a document. This is a query-independent prior,
+ * such as how commonly the document is used, which is added to the score
+ * of every match for the document. Since it is applied by the cursor
+ * before truncating to max-matches, a highly ranked document can not be
+ * crowded out by slightly better matches on less important documents.
+ *
+ * Documents without a rank have a rank of zero.
+ */
+void
+fuzzy_index_builder_set_document_rank (FuzzyIndexBuilder *self,
+                                       guint64            document_id,
+                                       gdouble            rank)
+{
+  g_return_if_fail (FUZZY_IS_INDEX_BUILDER (self));
+  g_return_if_fail (document_id < self->documents->len);
+
+  if (self->ranks == NULL)
+    self->ranks = g_array_new (FALSE, TRUE, sizeof (gdouble));
+
+  if (document_id >= self->ranks->len)
+    g_array_set_size (self->ranks, document_id + 1);
+
+  g_array_index (self->ranks, gdouble, document_id) = rank;
+}
+
 static gint
 pos_doc_pair_compare (gconstpointer a,
                       gconstpointer b)
@@ -296,14 +355,178 @@ fuzzy_index_builder_build_lookaside (FuzzyIndexBuilder *self)
 {
   g_assert (FUZZY_IS_INDEX_BUILDER (self));
 
-  return g_variant_new_fixed_array ((const GVariantType *)"(uu)",
+  return g_variant_new_fixed_array ((const GVariantType *)"(uuu)",
                                     self->kv_pairs->data,
                                     self->kv_pairs->len,
                                     sizeof (KVPair));
 }
 
+static gint
+sorted_compare (gconstpointer a,
+                gconstpointer b,
+                gpointer      user_data)
+{
+  const SortedState *state = user_data;
+  guint ida = *(const guint *)a;
+  guint idb = *(const guint *)b;
+  gint ret;
+
+  ret = strcmp (state->keys [state->pairs [ida].key_id],
+                state->keys [state->pairs [idb].key_id]);
+
+  if (ret == 0)
+    ret = (ida > idb) - (ida < idb);
+
+  return ret;
+}
+
+/*
+ * Gets the keys in the same form that the cursor will see the query,
+ * which means casefolded for case-insensitive indexes. Keys are folded
+ * once up front rather than on every comparison.
+ */
+static GPtrArray *
+fuzzy_index_builder_fold_keys (FuzzyIndexBuilder *self)
+{
+  GPtrArray *folded;
+  guint i;
+
+  g_assert (FUZZY_IS_INDEX_BUILDER (self));
+
+  if (self->case_sensitive)
+    return g_ptr_array_ref (self->keys);
+
+  folded = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < self->keys->len; i++)
+    g_ptr_array_add (folded, g_utf8_casefold (g_ptr_array_index (self->keys, i), -1));
+
+  return folded;
+}
+
 static GVariant *
-fuzzy_index_builder_build_index (FuzzyIndexBuilder *self)
+fuzzy_index_builder_build_sorted (FuzzyIndexBuilder *self,
+                                  GPtrArray         *folded)
+{
+  g_autoptr(GArray) sorted = NULL;
+  SortedState state;
+  guint i;
+
+  g_assert (FUZZY_IS_INDEX_BUILDER (self));
+  g_assert (folded != NULL);
+
+  state.keys = (const gchar * const *)folded->pdata;
+  state.pairs = (const KVPair *)(gpointer)self->kv_pairs->data;
+
+  sorted = g_array_sized_new (FALSE, FALSE, sizeof (guint), self->kv_pairs->len);
+  for (i = 0; i < self->kv_pairs->len; i++)
+    g_array_append_val (sorted, i);
+  g_array_sort_with_data (sorted, sorted_compare, &state);
+
+  return g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                    sorted->data,
+                                    sorted->len,
+                                    sizeof (guint));
+}
+
+static gint
+deletion_compare (gconstpointer a,
+                  gconstpointer b,
+                  gpointer      user_data)
+{
+  const SortedState *state = user_data;
+  const DeletionEntry *item_a = a;
+  const DeletionEntry *item_b = b;
+  gint ret;
+
+  ret = fuzzy_deletion_compare (state->keys [state->pairs [item_a->lookaside_id].key_id],
+                                item_a->offset,
+                                state->keys [state->pairs [item_b->lookaside_id].key_id],
+                                item_b->offset,
+                                G_MAXSIZE);
+
+  if (ret == 0)
+    ret = (item_a->lookaside_id > item_b->lookaside_id) - (item_a->lookaside_id < item_b->lookaside_id);
+
+  if (ret == 0)
+    ret = (item_a->offset > item_b->offset) - (item_a->offset < item_b->offset);
+
+  return ret;
+}
+
+/*
+ * Builds the deletion neighbourhood of the keys: every key with one of
+ * its first FUZZY_TYPO_MAX_CHARS characters removed, sorted so that the
+ * cursor can find the keys within one edit of a query with a few binary
+ * searches. Only offsets into the keys are stored.
+ */
+static GVariant *
+fuzzy_index_builder_build_deletions (FuzzyIndexBuilder *self,
+                                     GPtrArray         *folded)
+{
+  g_autoptr(GArray) deletions = NULL;
+  SortedState state;
+  guint i;
+
+  g_assert (FUZZY_IS_INDEX_BUILDER (self));
+  g_assert (folded != NULL);
+
+  state.keys = (const gchar * const *)folded->pdata;
+  state.pairs = (const KVPair *)(gpointer)self->kv_pairs->data;
+
+  deletions = g_array_new (FALSE, FALSE, sizeof (DeletionEntry));
+
+  for (i = 0; i < self->kv_pairs->len; i++)
+    {
+      const gchar *key = state.keys [state.pairs [i].key_id];
+      gunichar last = 0;
+      const gchar *tmp;
+      guint n_chars = 0;
+
+      /* Too short to be within one edit of a query we would correct */
+      if (g_utf8_strlen (key, FUZZY_TYPO_MIN_CHARS * 6) < FUZZY_TYPO_MIN_CHARS)
+        continue;
+
+      for (tmp = key;
+           *tmp != '\0' && n_chars < FUZZY_TYPO_MAX_CHARS;
+           tmp = g_utf8_next_char (tmp), n_chars++)
+        {
+          gunichar ch = g_utf8_get_char (tmp);
+          DeletionEntry item = { i, tmp - key };
+
+          /* Dropping either letter of a doubled pair gives the same key */
+          if (ch != last)
+            g_array_append_val (deletions, item);
+
+          last = ch;
+        }
+    }
+
+  g_array_sort_with_data (deletions, deletion_compare, &state);
+
+  return g_variant_new_fixed_array ((const GVariantType *)"(uu)",
+                                    deletions->data,
+                                    deletions->len,
+                                    sizeof (DeletionEntry));
+}
+
+static GVariant *
+fuzzy_index_builder_build_ranks (FuzzyIndexBuilder *self)
+{
+  g_assert (FUZZY_IS_INDEX_BUILDER (self));
+  g_assert (self->ranks != NULL);
+
+  /* Pad with zero so that every document has a rank */
+  if (self->ranks->len < self->documents->len)
+    g_array_set_size (self->ranks, self->documents->len);
+
+  return g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+                                    self->ranks->data,
+                                    self->ranks->len,
+                                    sizeof (gdouble));
+}
+
+static GVariant *
+fuzzy_index_builder_build_tables (FuzzyIndexBuilder *self)
 {
   g_autoptr(GPtrArray) ar = NULL;
   g_autoptr(GHashTable) rows = NULL;
@@ -397,24 +620,14 @@ fuzzy_index_builder_build_metadata (FuzzyIndexBuilder *self)
   return g_variant_dict_end (&dict);
 }
 
-static void
-fuzzy_index_builder_write_worker (GTask        *task,
-                                  gpointer      source_object,
-                                  gpointer      task_data,
-                                  GCancellable *cancellable)
+static GVariant *
+fuzzy_index_builder_build (FuzzyIndexBuilder *self)
 {
-  FuzzyIndexBuilder *self = source_object;
-  g_autoptr(GVariant) variant = NULL;
   g_autoptr(GVariant) documents = NULL;
-  g_autoptr(GPtrArray) array_of_keys = NULL;
+  g_autoptr(GPtrArray) folded = NULL;
   GVariantDict dict;
-  GFile *file = task_data;
-  GError *error = NULL;
 
-  g_assert (G_IS_TASK (task));
   g_assert (FUZZY_IS_INDEX_BUILDER (self));
-  g_assert (G_IS_FILE (file));
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   if (!self->case_sensitive)
     {
@@ -424,7 +637,7 @@ fuzzy_index_builder_write_worker (GTask        *task,
   g_variant_dict_init (&dict, NULL);
 
   /* Set our version number for the document */
-  g_variant_dict_insert (&dict, "version", "i", 1);
+  g_variant_dict_insert (&dict, "version", "i", FUZZY_INDEX_VERSION);
 
   /* Build our dicitionary of metadata */
   g_variant_dict_insert_value (&dict,
@@ -440,7 +653,8 @@ fuzzy_index_builder_write_worker (GTask        *task,
    * documents. This allows the tables to use the kvpair id as the value
    * in the index so we can have both document deduplication as well as
    * the ability to disambiguate the keys which point to the same
-   * document. The contents are "a{uu}".
+   * document. The contents are "a(uuu)" of key_id, document_id and
+   * the priority of the key.
    */
   g_variant_dict_insert_value (&dict,
                                "lookaside",
@@ -453,7 +667,33 @@ fuzzy_index_builder_write_worker (GTask        *task,
    */
   g_variant_dict_insert_value (&dict,
                                "tables",
-                               fuzzy_index_builder_build_index (self));
+                               fuzzy_index_builder_build_tables (self));
+
+  /* The lookaside ids ordered by their (casefolded) key. This allows the
+   * cursor to resolve exact and prefix matches with a binary search
+   * before falling back to the fuzzy walk of the tables.
+   */
+  folded = fuzzy_index_builder_fold_keys (self);
+
+  g_variant_dict_insert_value (&dict,
+                               "sorted",
+                               fuzzy_index_builder_build_sorted (self, folded));
+
+  /* The deletion neighbourhood of the keys as "a(uu)" of lookaside_id and
+   * the byte offset of the removed character, ordered by the keys with
+   * that character removed. The cursor uses this to correct typos.
+   */
+  g_variant_dict_insert_value (&dict,
+                               "deletions",
+                               fuzzy_index_builder_build_deletions (self, folded));
+
+  /* The static rank of each document, indexed by document_id. This is
+   * only written when a rank was set, as it is optional in the index.
+   */
+  if (self->ranks != NULL)
+    g_variant_dict_insert_value (&dict,
+                                 "ranks",
+                                 fuzzy_index_builder_build_ranks (self));
 
   /*
    * The documents are stored as an array where the document identifier is
@@ -467,17 +707,28 @@ fuzzy_index_builder_write_worker (GTask        *task,
                                    self->documents->len);
   g_variant_dict_insert_value (&dict, "documents", g_variant_ref_sink (documents));
 
+  return g_variant_ref_sink (g_variant_dict_end (&dict));
+}
+
+static void
+fuzzy_index_builder_write_worker (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+  FuzzyIndexBuilder *self = source_object;
+  g_autoptr(GVariant) variant = NULL;
+  GFile *file = task_data;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (FUZZY_IS_INDEX_BUILDER (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
   /* Now write the variant to disk */
-  variant = g_variant_ref_sink (g_variant_dict_end (&dict));
-  if (!g_file_replace_contents (file,
-                                g_variant_get_data (variant),
-                                g_variant_get_size (variant),
-                                NULL,
-                                FALSE,
-                                G_FILE_CREATE_NONE,
-                                NULL,
-                                cancellable,
-                                &error))
+  variant = fuzzy_index_builder_build (self);
+  if (!_fuzzy_index_write_variant (file, variant, cancellable, &error))
     g_task_return_error (task, error);
   else
     g_task_return_boolean (task, TRUE);
@@ -551,6 +802,35 @@ fuzzy_index_builder_write (FuzzyIndexBuilder  *self,
   return g_task_propagate_boolean (task, error);
 }
 
+/**
+ * fuzzy_index_builder_build_index:
+ * @self: A #FuzzyIndexBuilder
+ *
+ * Builds the index in memory and returns a #FuzzyIndex that can be
+ * queried right away, without a round trip through the filesystem.
+ * Use fuzzy_index_write() to save it for a later fuzzy_index_load_file().
+ *
+ * Returns: (transfer full): A #FuzzyIndex
+ */
+FuzzyIndex *
+fuzzy_index_builder_build_index (FuzzyIndexBuilder *self)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_return_val_if_fail (FUZZY_IS_INDEX_BUILDER (self), NULL);
+
+  variant = fuzzy_index_builder_build (self);
+  index = fuzzy_index_new ();
+
+  /* We just built the variant ourselves, so this can only fail on a bug */
+  if (!_fuzzy_index_load_built (index, variant, &error))
+    g_critical ("Failed to load built index: %s", error->message);
+
+  return g_steal_pointer (&index);
+}
+
 /**
  * fuzzy_index_builder_get_document:
  *
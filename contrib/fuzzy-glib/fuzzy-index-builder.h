@@ -21,6 +21,8 @@
 
 #include <gio/gio.h>
 
+#include "fuzzy-index.h"
+
 G_BEGIN_DECLS
 
 #define FUZZY_TYPE_INDEX_BUILDER (fuzzy_index_builder_get_type())
@@ -33,7 +35,11 @@ void               fuzzy_index_builder_set_case_sensitive  (FuzzyIndexBuilder
                                                             gboolean              case_sensitive);
 guint64            fuzzy_index_builder_insert              (FuzzyIndexBuilder    *self,
                                                             const gchar          *key,
-                                                            GVariant             *document);
+                                                            GVariant             *document,
+                                                            guint                 priority);
+void               fuzzy_index_builder_set_document_rank   (FuzzyIndexBuilder    *self,
+                                                            guint64               document_id,
+                                                            gdouble               rank);
 gboolean           fuzzy_index_builder_write               (FuzzyIndexBuilder    *self,
                                                             GFile                *file,
                                                             gint                  io_priority,
@@ -48,6 +54,7 @@ void               fuzzy_index_builder_write_async         (FuzzyIndexBuilder
 gboolean           fuzzy_index_builder_write_finish        (FuzzyIndexBuilder    *self,
                                                             GAsyncResult         *result,
                                                             GError              **error);
+FuzzyIndex        *fuzzy_index_builder_build_index         (FuzzyIndexBuilder    *self);
 const GVariant    *fuzzy_index_builder_get_document        (FuzzyIndexBuilder    *self,
                                                             guint64               document_id);
 void               fuzzy_index_builder_set_metadata        (FuzzyIndexBuilder    *self,
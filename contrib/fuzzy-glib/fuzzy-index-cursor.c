@@ -23,6 +23,7 @@
 #include "fuzzy-index-cursor.h"
 #include "fuzzy-index-match.h"
 #include "fuzzy-index-private.h"
+#include "fuzzy-util.h"
 
 struct _FuzzyIndexCursor
 {
@@ -34,6 +35,19 @@ struct _FuzzyIndexCursor
   GArray       *matches;
   guint         max_matches;
   guint         case_sensitive : 1;
+  guint         incremental : 1;
+
+  /*
+   * When incremental, the worker publishes provisional results as it
+   * goes. The most recent snapshot is stored in @pending and applied to
+   * @matches from an idle in @main_context, so that several snapshots
+   * arriving before the main loop gets to them only emit items-changed
+   * once. These are protected by @mutex.
+   */
+  GMutex        mutex;
+  GMainContext *main_context;
+  GSource      *publish_source;
+  GArray       *pending;
 };
 
 typedef struct
@@ -64,6 +78,7 @@ typedef struct
 enum {
   PROP_0,
   PROP_CASE_SENSITIVE,
+  PROP_INCREMENTAL,
   PROP_INDEX,
   PROP_TABLES,
   PROP_MAX_MATCHES,
@@ -71,8 +86,12 @@ enum {
   N_PROPS
 };
 
-static void async_initable_iface_init (GAsyncInitableIface *iface);
-static void list_model_iface_init     (GListModelInterface *iface);
+static void    async_initable_iface_init  (GAsyncInitableIface *iface);
+static void    list_model_iface_init      (GListModelInterface *iface);
+static void    fuzzy_index_cursor_publish (FuzzyIndexCursor    *self,
+                                           GHashTable          *matches);
+static GArray *fuzzy_index_cursor_resolve (FuzzyIndexCursor    *self,
+                                           GHashTable          *matches);
 
 static GParamSpec *properties [N_PROPS];
 
@@ -89,6 +108,16 @@ fuzzy_index_cursor_finalize (GObject *object)
   g_clear_pointer (&self->query, g_free);
   g_clear_pointer (&self->matches, g_array_unref);
   g_clear_pointer (&self->tables, g_variant_dict_unref);
+  g_clear_pointer (&self->pending, g_array_unref);
+  g_clear_pointer (&self->main_context, g_main_context_unref);
+
+  if (self->publish_source != NULL)
+    {
+      g_source_destroy (self->publish_source);
+      g_clear_pointer (&self->publish_source, g_source_unref);
+    }
+
+  g_mutex_clear (&self->mutex);
 
   G_OBJECT_CLASS (fuzzy_index_cursor_parent_class)->finalize (object);
 }
@@ -107,6 +136,10 @@ fuzzy_index_cursor_get_property (GObject    *object,
       g_value_set_boolean (value, self->case_sensitive);
       break;
 
+    case PROP_INCREMENTAL:
+      g_value_set_boolean (value, self->incremental);
+      break;
+
     case PROP_INDEX:
       g_value_set_object (value, self->index);
       break;
@@ -138,6 +171,10 @@ fuzzy_index_cursor_set_property (GObject      *object,
       self->case_sensitive = g_value_get_boolean (value);
       break;
 
+    case PROP_INCREMENTAL:
+      self->incremental = g_value_get_boolean (value);
+      break;
+
     case PROP_INDEX:
       self->index = g_value_dup_object (value);
       break;
@@ -175,6 +212,13 @@ fuzzy_index_cursor_class_init (FuzzyIndexCursorClass *klass)
                           FALSE,
                           (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
 
+  properties [PROP_INCREMENTAL] =
+    g_param_spec_boolean ("incremental",
+                          "Incremental",
+                          "If provisional results should be published while searching",
+                          FALSE,
+                          (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
   properties [PROP_INDEX] =
     g_param_spec_object ("index",
                          "Index",
@@ -211,6 +255,7 @@ fuzzy_index_cursor_class_init (FuzzyIndexCursorClass *klass)
 static void
 fuzzy_index_cursor_init (FuzzyIndexCursor *self)
 {
+  g_mutex_init (&self->mutex);
   self->matches = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
 }
 
@@ -288,44 +333,132 @@ fuzzy_do_match (const FuzzyLookup    *lookup,
   return FALSE;
 }
 
-static void
-fuzzy_index_cursor_worker (GTask        *task,
-                           gpointer      source_object,
-                           gpointer      task_data,
-                           GCancellable *cancellable)
+static const gchar *
+fuzzy_index_cursor_get_key (FuzzyIndexCursor  *self,
+                            guint              lookaside_id,
+                            guint             *document_id,
+                            gchar            **freeme)
 {
-  FuzzyIndexCursor *self = source_object;
-  g_autoptr(GHashTable) matches = NULL;
-  g_autoptr(GHashTable) by_document = NULL;
-  g_autoptr(GPtrArray) tables = NULL;
-  g_autoptr(GArray) tables_n_elements = NULL;
-  g_autofree gint *tables_state = NULL;
-  g_autofree gchar *freeme = NULL;
-  const gchar *query;
-  FuzzyLookup lookup = { 0 };
-  GHashTableIter iter;
-  const gchar *str;
-  gpointer key, value;
-  guint i;
+  const gchar *key;
 
   g_assert (FUZZY_IS_INDEX_CURSOR (self));
-  g_assert (G_IS_TASK (task));
+  g_assert (document_id != NULL);
+  g_assert (freeme != NULL);
 
-  if (g_task_return_error_if_cancelled (task))
-    return;
+  if G_UNLIKELY (!_fuzzy_index_resolve (self->index, lookaside_id, document_id, &key, NULL))
+    return NULL;
 
-  /* No matches with empty query */
-  if (self->query == NULL || *self->query == '\0')
-    goto cleanup;
-
-  /* If we are not case-sensitive, we need to downcase the query string */
-  query = self->query;
   if (!self->case_sensitive)
-    query = freeme = g_utf8_casefold (query, -1);
+    key = *freeme = g_utf8_casefold (key, -1);
 
-  tables = g_ptr_array_new ();
-  tables_n_elements = g_array_new (FALSE, FALSE, sizeof (gsize));
-  matches = g_hash_table_new (NULL, NULL);
+  return key;
+}
+
+/*
+ * Locates every key starting with @query using the sorted lookaside
+ * array of the index. Matches are added to @matches using the same
+ * gap score that fuzzy_do_match() would have produced for a contiguous
+ * match (plus @penalty), so the two paths score consistently.
+ *
+ * Returns: the number of unique documents that were matched.
+ */
+static guint
+fuzzy_index_cursor_match_prefix (FuzzyIndexCursor *self,
+                                 const gchar      *query,
+                                 guint             query_len,
+                                 guint             penalty,
+                                 GHashTable       *matches)
+{
+  g_autoptr(GHashTable) documents = NULL;
+  const guint *sorted;
+  gsize n_sorted;
+  gsize query_bytes;
+  gsize lo;
+  gsize hi;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (query != NULL);
+  g_assert (query_len > 0);
+  g_assert (matches != NULL);
+
+  sorted = _fuzzy_index_get_sorted (self->index, &n_sorted);
+
+  if (sorted == NULL || n_sorted == 0)
+    return 0;
+
+  query_bytes = strlen (query);
+
+  /* Find the first key that is >= query */
+  lo = 0;
+  hi = n_sorted;
+
+  while (lo < hi)
+    {
+      g_autofree gchar *freeme = NULL;
+      gsize mid = lo + ((hi - lo) / 2);
+      const gchar *key;
+      guint document_id;
+
+      if G_UNLIKELY (NULL == (key = fuzzy_index_cursor_get_key (self, sorted [mid], &document_id, &freeme)))
+        return 0;
+
+      if (strcmp (key, query) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  documents = g_hash_table_new (NULL, NULL);
+
+  /* Every key sharing our prefix is now contiguous starting at lo */
+  for (; lo < n_sorted; lo++)
+    {
+      g_autofree gchar *freeme = NULL;
+      gpointer lookup_score;
+      const gchar *key;
+      guint document_id;
+      gint score = penalty + query_len - 1;
+
+      if G_UNLIKELY (NULL == (key = fuzzy_index_cursor_get_key (self, sorted [lo], &document_id, &freeme)))
+        break;
+
+      if (strncmp (key, query, query_bytes) != 0)
+        break;
+
+      if (!g_hash_table_lookup_extended (matches, GUINT_TO_POINTER (sorted [lo]), NULL, &lookup_score) ||
+          score < GPOINTER_TO_INT (lookup_score))
+        g_hash_table_insert (matches,
+                             GUINT_TO_POINTER (sorted [lo]),
+                             GINT_TO_POINTER (score));
+
+      g_hash_table_add (documents, GUINT_TO_POINTER (document_id));
+    }
+
+  return g_hash_table_size (documents);
+}
+
+/*
+ * Loads the character table for every non-space character in @query.
+ *
+ * Returns: %FALSE if a character has no table, in which case nothing
+ *   within the index can match @query.
+ */
+static gboolean
+fuzzy_index_cursor_load_tables (FuzzyIndexCursor *self,
+                                const gchar      *query,
+                                GPtrArray        *tables,
+                                GArray           *tables_n_elements,
+                                gboolean         *has_space)
+{
+  const gchar *str;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (query != NULL);
+  g_assert (tables != NULL);
+  g_assert (tables_n_elements != NULL);
+  g_assert (has_space != NULL);
+
+  *has_space = FALSE;
 
   for (str = query; *str; str = g_utf8_next_char (str))
     {
@@ -336,7 +469,10 @@ fuzzy_index_cursor_worker (GTask        *task,
       gchar char_key[8];
 
       if (g_unichar_isspace (ch))
-        continue;
+        {
+          *has_space = TRUE;
+          continue;
+        }
 
       char_key [g_unichar_to_utf8 (ch, char_key)] = '\0';
       table = g_variant_dict_lookup_value (self->tables,
@@ -345,17 +481,86 @@ fuzzy_index_cursor_worker (GTask        *task,
 
       /* No possible matches, missing table for character */
       if (table == NULL)
-        goto cleanup;
+        return FALSE;
 
       fixed = g_variant_get_fixed_array (table, &n_elements, sizeof (FuzzyIndexItem));
       g_array_append_val (tables_n_elements, n_elements);
       g_ptr_array_add (tables, (gpointer)fixed);
     }
 
-  if (tables->len == 0)
-    goto cleanup;
+  return TRUE;
+}
+
+/*
+ * Checks whether the prefix matches in @matches already fill every
+ * result slot with scores that no other match could beat, in which case
+ * the walk of the tables cannot change the results.
+ *
+ * A key matching @query anywhere but at its start has at least one more
+ * byte than @query and at least the gap score of a contiguous match. Its
+ * final score is therefore at most what such a key would get with the
+ * best priority and the highest rank of any document.
+ */
+static gboolean
+fuzzy_index_cursor_prefix_is_final (FuzzyIndexCursor *self,
+                                    const gchar      *query,
+                                    guint             query_len,
+                                    guint             penalty,
+                                    GHashTable       *matches)
+{
+  g_autoptr(GArray) resolved = NULL;
+  gdouble best_other;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (query != NULL);
+  g_assert (matches != NULL);
+
+  if (self->max_matches == 0)
+    return FALSE;
+
+  resolved = fuzzy_index_cursor_resolve (self, matches);
+
+  if (resolved->len < self->max_matches)
+    return FALSE;
+
+  best_other = 1.0 / (strlen (query) + 1 + penalty + query_len - 1);
+  best_other += _fuzzy_index_get_max_rank (self->index);
+
+  return g_array_index (resolved, FuzzyMatch, resolved->len - 1).score >= best_other;
+}
+
+/*
+ * Walks the character tables for @query (which must contain at least two
+ * non-space characters) and adds the gap score of every matching
+ * lookaside_id to @matches. @penalty is added to each of those scores.
+ */
+static void
+fuzzy_index_cursor_walk (FuzzyIndexCursor *self,
+                         const gchar      *query,
+                         guint             penalty,
+                         GHashTable       *matches)
+{
+  g_autoptr(GPtrArray) tables = NULL;
+  g_autoptr(GArray) tables_n_elements = NULL;
+  g_autofree gint *tables_state = NULL;
+  FuzzyLookup lookup = { 0 };
+  gboolean has_space = FALSE;
+  guint n_prefix = 0;
+  guint i;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (query != NULL);
+  g_assert (matches != NULL);
+
+  tables = g_ptr_array_new ();
+  tables_n_elements = g_array_new (FALSE, FALSE, sizeof (gsize));
+
+  if (!fuzzy_index_cursor_load_tables (self, query, tables, tables_n_elements, &has_space))
+    return;
+
+  if (tables->len < 2)
+    return;
 
-  g_assert (tables->len > 0);
   g_assert (tables->len == tables_n_elements->len);
 
   tables_state = g_new0 (gint, tables->len);
@@ -363,55 +568,233 @@ fuzzy_index_cursor_worker (GTask        *task,
   lookup.index = self->index;
   lookup.matches = matches;
   lookup.tables = (const FuzzyIndexItem * const *)tables->pdata;
-  lookup.tables_n_elements = (const gsize *)tables_n_elements->data;
+  lookup.tables_n_elements = (const gsize *)(gpointer)tables_n_elements->data;
   lookup.tables_state = tables_state;
   lookup.n_tables = tables->len;
   lookup.needle = query;
   lookup.max_matches = self->max_matches;
 
-  if G_LIKELY (lookup.n_tables > 1)
+  /*
+   * Resolve exact and prefix matches with a binary search first. Pasted
+   * identifiers are almost always an exact match, and if those matches
+   * already fill every result slot with scores the walk cannot beat, we
+   * can skip the walk of the tables entirely. Otherwise the fuzzy walk
+   * fills in the remaining slots.
+   */
+  if (!has_space)
+    n_prefix = fuzzy_index_cursor_match_prefix (self, query, lookup.n_tables, penalty, matches);
+
+  if (lookup.max_matches > 0 &&
+      n_prefix >= lookup.max_matches &&
+      fuzzy_index_cursor_prefix_is_final (self, query, lookup.n_tables, penalty, matches))
+    return;
+
+  /*
+   * Exact and prefix matches are the best we can find, so show them while
+   * walking the tables. Typo walks (with a penalty) are not worth it.
+   */
+  if (penalty == 0 && n_prefix > 0)
+    fuzzy_index_cursor_publish (self, matches);
+
+  for (i = 0; i < lookup.tables_n_elements[0]; i++)
     {
-      for (i = 0; i < lookup.tables_n_elements[0]; i++)
-        {
-          const FuzzyIndexItem *item;
+      const FuzzyIndexItem *item;
 
-          item = &lookup.tables[0][i];
-          fuzzy_do_match (&lookup, item, 1, 0);
-        }
+      item = &lookup.tables[0][i];
+      fuzzy_do_match (&lookup, item, 1, penalty);
     }
-  else
+}
+
+static guint
+fuzzy_index_cursor_count_documents (FuzzyIndexCursor *self,
+                                    GHashTable       *matches)
+{
+  g_autoptr(GHashTable) documents = NULL;
+  GHashTableIter iter;
+  gpointer key;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (matches != NULL);
+
+  documents = g_hash_table_new (NULL, NULL);
+
+  g_hash_table_iter_init (&iter, matches);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
     {
-      guint last_id = G_MAXUINT;
+      guint document_id;
 
-      for (i = 0; i < lookup.tables_n_elements[0]; i++)
-        {
-          const FuzzyIndexItem *item;
-          FuzzyMatch match;
+      if (_fuzzy_index_resolve (self->index, GPOINTER_TO_UINT (key), &document_id, NULL, NULL))
+        g_hash_table_add (documents, GUINT_TO_POINTER (document_id));
+    }
 
-          item = &lookup.tables[0][i];
+  return g_hash_table_size (documents);
+}
 
-          if (item->lookaside_id != last_id)
-            {
-              last_id = item->lookaside_id;
+/*
+ * Locates every key which, with one character removed, starts with
+ * @variant, using the deletion neighbourhood precomputed by the builder.
+ * Matches are added to @matches with the score of a prefix match of
+ * @query_len characters, plus @penalty.
+ */
+static void
+fuzzy_index_cursor_match_deletions (FuzzyIndexCursor *self,
+                                    const gchar      *variant,
+                                    guint             query_len,
+                                    guint             penalty,
+                                    GHashTable       *matches)
+{
+  const DeletionEntry *deletions;
+  gsize n_deletions;
+  gsize variant_bytes;
+  gsize lo;
+  gsize hi;
 
-              if G_UNLIKELY (!_fuzzy_index_resolve (self->index,
-                                                    item->lookaside_id,
-                                                    &match.document_id,
-                                                    &match.key))
-                continue;
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (variant != NULL);
+  g_assert (matches != NULL);
 
-              match.score = 0;
+  deletions = _fuzzy_index_get_deletions (self->index, &n_deletions);
 
-              g_array_append_val (self->matches, match);
-            }
-        }
+  if (deletions == NULL || n_deletions == 0)
+    return;
+
+  variant_bytes = strlen (variant);
+
+  /* Find the first deletion that is >= variant */
+  lo = 0;
+  hi = n_deletions;
 
-      goto cleanup;
+  while (lo < hi)
+    {
+      g_autofree gchar *freeme = NULL;
+      gsize mid = lo + ((hi - lo) / 2);
+      const gchar *key;
+      guint document_id;
+
+      if G_UNLIKELY (NULL == (key = fuzzy_index_cursor_get_key (self, deletions [mid].lookaside_id, &document_id, &freeme)))
+        return;
+
+      if (fuzzy_deletion_compare (key, deletions [mid].offset, variant, -1, G_MAXSIZE) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
     }
 
-  if (g_task_return_error_if_cancelled (task))
+  /* Every deletion starting with variant is now contiguous at lo */
+  for (; lo < n_deletions; lo++)
+    {
+      g_autofree gchar *freeme = NULL;
+      gpointer lookup_score;
+      const gchar *key;
+      guint document_id;
+      guint lookaside_id = deletions [lo].lookaside_id;
+      gint score = penalty + query_len - 1;
+
+      if G_UNLIKELY (NULL == (key = fuzzy_index_cursor_get_key (self, lookaside_id, &document_id, &freeme)))
+        break;
+
+      if (fuzzy_deletion_compare (key, deletions [lo].offset, variant, -1, variant_bytes) != 0)
+        break;
+
+      if (!g_hash_table_lookup_extended (matches, GUINT_TO_POINTER (lookaside_id), NULL, &lookup_score) ||
+          score < GPOINTER_TO_INT (lookup_score))
+        g_hash_table_insert (matches,
+                             GUINT_TO_POINTER (lookaside_id),
+                             GINT_TO_POINTER (score));
+    }
+}
+
+/*
+ * Typo fallback for when the regular walk comes up short.
+ *
+ * Since a match only requires the query characters to appear in order,
+ * a dropped letter is already tolerated. What remains of edit distance 1
+ * is found by dropping each character of the query in turn. An extra
+ * letter leaves a prefix of a key, which the sorted keys give us. A
+ * substituted letter or two swapped letters leave a prefix of a key with
+ * one of its characters dropped as well, which is what the deletion
+ * neighbourhood built by FuzzyIndexBuilder contains. Each variant costs
+ * two binary searches, so every position of the query is covered.
+ * Results are penalized by the length of the query so they rank below
+ * real matches.
+ */
+static void
+fuzzy_index_cursor_match_typos (FuzzyIndexCursor *self,
+                                const gchar      *query,
+                                GHashTable       *matches,
+                                GCancellable     *cancellable)
+{
+  g_autofree gchar *variant = NULL;
+  const gchar *str;
+  gunichar last = 0;
+  gsize query_bytes;
+  glong n_chars;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (query != NULL);
+  g_assert (matches != NULL);
+
+  n_chars = g_utf8_strlen (query, -1);
+
+  if (n_chars < FUZZY_TYPO_MIN_CHARS || n_chars > FUZZY_TYPO_MAX_CHARS)
     return;
 
+  /* Only whole keys are in the deletion neighbourhood */
+  for (str = query; *str; str = g_utf8_next_char (str))
+    {
+      if (g_unichar_isspace (g_utf8_get_char (str)))
+        return;
+    }
+
+  query_bytes = str - query;
+  variant = g_malloc (query_bytes + 1);
+
+  for (str = query; *str; str = g_utf8_next_char (str))
+    {
+      const gchar *next = g_utf8_next_char (str);
+      gunichar ch = g_utf8_get_char (str);
+
+      /* Dropping either letter of a doubled pair gives the same variant */
+      if (ch == last)
+        continue;
+
+      last = ch;
+
+      if (g_cancellable_is_cancelled (cancellable))
+        break;
+
+      memcpy (variant, query, str - query);
+      memcpy (variant + (str - query), next, query_bytes - (next - query) + 1);
+
+      fuzzy_index_cursor_match_prefix (self, variant, n_chars - 1, n_chars, matches);
+      fuzzy_index_cursor_match_deletions (self, variant, n_chars - 1, n_chars, matches);
+    }
+}
+
+/*
+ * Converts the gap scores in @matches into a sorted array of the best
+ * match for each document, truncated to max-matches.
+ */
+static GArray *
+fuzzy_index_cursor_resolve (FuzzyIndexCursor *self,
+                            GHashTable       *matches)
+{
+  g_autoptr(GHashTable) by_document = NULL;
+  GHashTableIter iter;
+  gpointer key, value;
+  GArray *ret;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (matches != NULL);
+
+  ret = g_array_new (FALSE, FALSE, sizeof (FuzzyMatch));
+
+  /*
+   * Multiple keys may point at the same document, so we only keep the
+   * best scoring match for each document. by_document maps the
+   * document_id to its position within ret (plus one).
+   */
   by_document = g_hash_table_new (NULL, NULL);
 
   g_hash_table_iter_init (&iter, matches);
@@ -421,77 +804,222 @@ fuzzy_index_cursor_worker (GTask        *task,
       guint lookaside_id = GPOINTER_TO_UINT (key);
       guint score = GPOINTER_TO_UINT (value);
       FuzzyMatch match;
-      union {
-        gpointer ptr;
-        gfloat   fval;
-      } other_score;
+      guint position;
+      guint priority;
 
       if G_UNLIKELY (!_fuzzy_index_resolve (self->index,
                                             lookaside_id,
                                             &match.document_id,
-                                            &match.key))
+                                            &match.key,
+                                            &priority))
         continue;
 
-      match.score = 1.0 / (strlen (match.key) + score);
+      /*
+       * Apply the priority of the key and the static rank of the document
+       * here, before deduplication and truncation to max-matches, so that
+       * the best key for a document wins and the top matches are picked
+       * by their final score.
+       */
+      match.score = 1.0 / (strlen (match.key) + score) / (1.0 + priority);
+      match.score += _fuzzy_index_get_rank (self->index, match.document_id);
 
-      if (g_hash_table_lookup_extended (by_document,
-                                        GUINT_TO_POINTER (match.document_id),
-                                        NULL,
-                                        &other_score.ptr) &&
-          other_score.fval <= match.score)
-        continue;
+      position = GPOINTER_TO_UINT (g_hash_table_lookup (by_document,
+                                                        GUINT_TO_POINTER (match.document_id)));
+
+      if (position == 0)
+        {
+          g_array_append_val (ret, match);
+          g_hash_table_insert (by_document,
+                               GUINT_TO_POINTER (match.document_id),
+                               GUINT_TO_POINTER (ret->len));
+        }
+      else if (g_array_index (ret, FuzzyMatch, position - 1).score < match.score)
+        {
+          g_array_index (ret, FuzzyMatch, position - 1) = match;
+        }
+    }
+
+  g_array_sort (ret, fuzzy_match_compare);
+  if (self->max_matches > 0 && self->max_matches < ret->len)
+    g_array_set_size (ret, self->max_matches);
+
+  return ret;
+}
+
+/*
+ * Replaces the visible matches with @matches. This must only be called
+ * from the main context of the cursor.
+ */
+static void
+fuzzy_index_cursor_replace (FuzzyIndexCursor *self,
+                            GArray           *matches)
+{
+  guint old_len;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (matches != NULL);
+
+  old_len = self->matches->len;
+
+  g_array_unref (self->matches);
+  self->matches = g_array_ref (matches);
+
+  if (old_len > 0 || matches->len > 0)
+    g_list_model_items_changed (G_LIST_MODEL (self), 0, old_len, matches->len);
+}
+
+static gboolean
+fuzzy_index_cursor_publish_cb (gpointer data)
+{
+  FuzzyIndexCursor *self = data;
+  g_autoptr(GArray) pending = NULL;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
 
-      other_score.fval = match.score;
+  g_mutex_lock (&self->mutex);
+  pending = g_steal_pointer (&self->pending);
+  g_clear_pointer (&self->publish_source, g_source_unref);
+  g_mutex_unlock (&self->mutex);
 
-      g_hash_table_insert (by_document,
-                           GUINT_TO_POINTER (match.document_id),
-                           other_score.ptr);
+  if (pending != NULL)
+    fuzzy_index_cursor_replace (self, pending);
 
-      g_array_append_val (self->matches, match);
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Publishes the current state of @matches as provisional results. This
+ * is called from the worker thread, and the snapshot is applied from the
+ * main context. If a previous snapshot has not been applied yet, it is
+ * simply replaced so that consumers only see the most recent one.
+ */
+static void
+fuzzy_index_cursor_publish (FuzzyIndexCursor *self,
+                            GHashTable       *matches)
+{
+  g_autoptr(GArray) snapshot = NULL;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (matches != NULL);
+
+  if (!self->incremental || g_hash_table_size (matches) == 0)
+    return;
+
+  snapshot = fuzzy_index_cursor_resolve (self, matches);
+
+  g_mutex_lock (&self->mutex);
+
+  g_clear_pointer (&self->pending, g_array_unref);
+  self->pending = g_steal_pointer (&snapshot);
+
+  if (self->publish_source == NULL)
+    {
+      self->publish_source = g_idle_source_new ();
+      g_source_set_name (self->publish_source, "[fuzzy] fuzzy_index_cursor_publish_cb");
+      g_source_set_priority (self->publish_source, G_PRIORITY_DEFAULT);
+      g_source_set_callback (self->publish_source,
+                             fuzzy_index_cursor_publish_cb,
+                             g_object_ref (self),
+                             g_object_unref);
+      g_source_attach (self->publish_source, self->main_context);
     }
 
+  g_mutex_unlock (&self->mutex);
+}
+
+static void
+fuzzy_index_cursor_worker (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+  FuzzyIndexCursor *self = source_object;
+  g_autoptr(GHashTable) matches = NULL;
+  g_autoptr(GPtrArray) tables = NULL;
+  g_autoptr(GArray) tables_n_elements = NULL;
+  g_autofree gchar *freeme = NULL;
+  const gchar *query;
+  gboolean has_space = FALSE;
+  guint i;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
+  g_assert (G_IS_TASK (task));
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  /* No matches with empty query */
+  if (self->query == NULL || *self->query == '\0')
+    goto cleanup;
+
+  /* If we are not case-sensitive, we need to downcase the query string */
+  query = self->query;
+  if (!self->case_sensitive)
+    query = freeme = g_utf8_casefold (query, -1);
+
+  tables = g_ptr_array_new ();
+  tables_n_elements = g_array_new (FALSE, FALSE, sizeof (gsize));
+  matches = g_hash_table_new (NULL, NULL);
+
+  if (!fuzzy_index_cursor_load_tables (self, query, tables, tables_n_elements, &has_space))
+    {
+      /* A character with no table can still be a typo */
+      fuzzy_index_cursor_match_typos (self, query, matches, cancellable);
+      goto resolve;
+    }
+
+  if (tables->len == 0)
+    goto cleanup;
+
+  g_assert (tables->len > 0);
+  g_assert (tables->len == tables_n_elements->len);
+
   /*
-   * Because we have to do the deduplication of documents after
-   * searching all the potential matches, we could have duplicates
-   * in the array. So we need to filter them out. Not that big
-   * of a deal, since we can do remove_fast on the index and
-   * we have to sort them afterwards anyway. Potentially, we could
-   * do both at once if we felt like doing our own sort.
+   * A single character matches every key containing it, with no gaps to
+   * score. Resolve them like any other match so that the static rank of
+   * the documents decides which of them are kept.
    */
-  for (i = 0; i < self->matches->len; i++)
+  if G_UNLIKELY (tables->len == 1)
     {
-      FuzzyMatch *match;
-      union {
-        gpointer ptr;
-        gfloat   fval;
-      } other_score;
+      const FuzzyIndexItem *table = g_ptr_array_index (tables, 0);
+      gsize n_elements = g_array_index (tables_n_elements, gsize, 0);
 
-    next:
-      match = &g_array_index (self->matches, FuzzyMatch, i);
-      other_score.ptr = g_hash_table_lookup (by_document,
-                                             GUINT_TO_POINTER (match->document_id));
+      for (i = 0; i < n_elements; i++)
+        g_hash_table_insert (matches,
+                             GUINT_TO_POINTER (table[i].lookaside_id),
+                             GINT_TO_POINTER (0));
 
-      /*
-       * This item should have been discarded, but we didn't have enough
-       * information at the time we built the array.
-       */
-      if (other_score.fval < match->score)
-        {
-          g_array_remove_index_fast (self->matches, i);
-          if (i < self->matches->len - 1)
-            goto next;
-        }
+      goto resolve;
     }
 
+  fuzzy_index_cursor_walk (self, query, 0, matches);
+
   if (g_task_return_error_if_cancelled (task))
     return;
 
-  g_array_sort (self->matches, fuzzy_match_compare);
-  if (lookup.max_matches > 0 && lookup.max_matches < self->matches->len)
-    g_array_set_size (self->matches, lookup.max_matches);
+  /* Only pay for the typo fallback when the regular walk comes up short */
+  if (self->max_matches > 0
+      ? fuzzy_index_cursor_count_documents (self, matches) < self->max_matches
+      : g_hash_table_size (matches) == 0)
+    {
+      /* Show what the table walk found while we look for typos */
+      fuzzy_index_cursor_publish (self, matches);
+      fuzzy_index_cursor_match_typos (self, query, matches, cancellable);
+    }
+
+resolve:
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  g_task_return_pointer (task,
+                         fuzzy_index_cursor_resolve (self, matches),
+                         (GDestroyNotify)g_array_unref);
+  return;
 
 cleanup:
-  g_task_return_boolean (task, TRUE);
+  g_task_return_pointer (task,
+                         g_array_new (FALSE, FALSE, sizeof (FuzzyMatch)),
+                         (GDestroyNotify)g_array_unref);
 }
 
 static void
@@ -507,6 +1035,9 @@ fuzzy_index_cursor_init_async (GAsyncInitable      *initable,
   g_assert (FUZZY_IS_INDEX_CURSOR (self));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
+  g_clear_pointer (&self->main_context, g_main_context_unref);
+  self->main_context = g_main_context_ref_thread_default ();
+
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, fuzzy_index_cursor_init_async);
   g_task_set_priority (task, io_priority);
@@ -519,10 +1050,28 @@ fuzzy_index_cursor_init_finish (GAsyncInitable  *initiable,
                                 GAsyncResult    *result,
                                 GError         **error)
 {
-  g_assert (FUZZY_IS_INDEX_CURSOR (initiable));
+  FuzzyIndexCursor *self = (FuzzyIndexCursor *)initiable;
+  g_autoptr(GArray) matches = NULL;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (self));
   g_assert (G_IS_TASK (result));
 
-  return g_task_propagate_boolean (G_TASK (result), error);
+  /* Drop any provisional results that have not been shown yet */
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->pending, g_array_unref);
+  if (self->publish_source != NULL)
+    {
+      g_source_destroy (self->publish_source);
+      g_clear_pointer (&self->publish_source, g_source_unref);
+    }
+  g_mutex_unlock (&self->mutex);
+
+  if (NULL == (matches = g_task_propagate_pointer (G_TASK (result), error)))
+    return FALSE;
+
+  fuzzy_index_cursor_replace (self, matches);
+
+  return TRUE;
 }
 
 static void
@@ -0,0 +1,817 @@
+/* fuzzy-index-merge.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "fuzzy-index-merge"
+
+#include <string.h>
+
+#include "fuzzy-index-merge.h"
+#include "fuzzy-index-private.h"
+#include "fuzzy-util.h"
+
+typedef struct
+{
+  guint position;
+  guint lookaside_id;
+} FuzzyIndexItem;
+
+typedef struct
+{
+  /* Keeps the mapping and the tables below alive */
+  FuzzyIndex           *index;
+
+  GVariant             *keys;
+  const gchar         **keys_raw;
+  gsize                 n_keys;
+
+  /* Casefolded copy of @keys_raw for case-insensitive indexes */
+  gchar               **folded;
+
+  GVariant             *lookaside;
+  const LookasideEntry *lookaside_raw;
+  gsize                 lookaside_len;
+
+  GVariant             *sorted;
+  const guint          *sorted_raw;
+  gsize                 sorted_len;
+
+  GVariant             *ranks;
+  const gdouble        *ranks_raw;
+  gsize                 ranks_len;
+
+  GVariant             *deletions;
+  const DeletionEntry  *deletions_raw;
+  gsize                 deletions_len;
+
+  GVariant             *tables;
+  GVariant             *documents;
+  GVariant             *metadata;
+
+  gboolean              case_sensitive;
+
+  /* Maps key_id and document_id of this input to the merged index */
+  guint                *key_map;
+  guint                *document_map;
+
+  /* Where the lookaside entries of this input start in the merged index */
+  guint                 lookaside_offset;
+
+  /* Our position within @sorted_raw while merging the sorted tables */
+  gsize                 sorted_pos;
+
+  /* Our position within @deletions_raw while merging the deletions */
+  gsize                 deletions_pos;
+} MergeInput;
+
+typedef gint (*MergeInputCompare) (const MergeInput *a,
+                                   const MergeInput *b);
+
+typedef struct
+{
+  GPtrArray *inputs;
+  GFile     *output;
+} Merge;
+
+static void
+merge_free (gpointer data)
+{
+  Merge *merge = data;
+
+  g_clear_pointer (&merge->inputs, g_ptr_array_unref);
+  g_clear_object (&merge->output);
+  g_slice_free (Merge, merge);
+}
+
+static void
+merge_input_free (gpointer data)
+{
+  MergeInput *input = data;
+
+  g_clear_pointer (&input->keys_raw, g_free);
+  g_clear_pointer (&input->folded, g_strfreev);
+  g_clear_pointer (&input->key_map, g_free);
+  g_clear_pointer (&input->document_map, g_free);
+  g_clear_pointer (&input->keys, g_variant_unref);
+  g_clear_pointer (&input->lookaside, g_variant_unref);
+  g_clear_pointer (&input->sorted, g_variant_unref);
+  g_clear_pointer (&input->ranks, g_variant_unref);
+  g_clear_pointer (&input->deletions, g_variant_unref);
+  g_clear_pointer (&input->tables, g_variant_unref);
+  g_clear_pointer (&input->documents, g_variant_unref);
+  g_clear_pointer (&input->metadata, g_variant_unref);
+  g_clear_object (&input->index);
+  g_slice_free (MergeInput, input);
+}
+
+static MergeInput *
+merge_input_load (GFile         *file,
+                  GCancellable  *cancellable,
+                  GError       **error)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autofree gchar *uri = NULL;
+  MergeInput *input;
+  GVariantDict dict;
+
+  g_assert (G_IS_FILE (file));
+
+  /* We read every table of the input, so verify all of it first */
+  index = fuzzy_index_new ();
+  if (!fuzzy_index_load_file (index, file, cancellable, error) ||
+      !_fuzzy_index_verify (index, error))
+    return NULL;
+
+  input = g_slice_new0 (MergeInput);
+  input->index = g_steal_pointer (&index);
+
+  g_variant_dict_init (&dict, _fuzzy_index_get_variant (input->index));
+  input->keys = g_variant_dict_lookup_value (&dict, "keys", G_VARIANT_TYPE_STRING_ARRAY);
+  input->lookaside = g_variant_dict_lookup_value (&dict, "lookaside", (const GVariantType *)"a(uuu)");
+  input->sorted = g_variant_dict_lookup_value (&dict, "sorted", (const GVariantType *)"au");
+  input->ranks = g_variant_dict_lookup_value (&dict, "ranks", (const GVariantType *)"ad");
+  input->deletions = g_variant_dict_lookup_value (&dict, "deletions", (const GVariantType *)"a(uu)");
+  input->tables = g_variant_dict_lookup_value (&dict, "tables", G_VARIANT_TYPE_VARDICT);
+  input->documents = g_variant_dict_lookup_value (&dict, "documents", G_VARIANT_TYPE_ARRAY);
+  input->metadata = g_variant_dict_lookup_value (&dict, "metadata", G_VARIANT_TYPE_VARDICT);
+  g_variant_dict_clear (&dict);
+
+  /* Everything but the sorted table was checked when loading */
+  if (input->sorted == NULL)
+    {
+      uri = g_file_get_uri (file);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "%s does not contain a sorted table and must be rebuilt",
+                   uri);
+      merge_input_free (input);
+      return NULL;
+    }
+
+  input->keys_raw = g_variant_get_strv (input->keys, &input->n_keys);
+  input->lookaside_raw = g_variant_get_fixed_array (input->lookaside,
+                                                    &input->lookaside_len,
+                                                    sizeof (LookasideEntry));
+  input->sorted_raw = g_variant_get_fixed_array (input->sorted,
+                                                 &input->sorted_len,
+                                                 sizeof (guint));
+
+  if (input->ranks != NULL)
+    input->ranks_raw = g_variant_get_fixed_array (input->ranks,
+                                                  &input->ranks_len,
+                                                  sizeof (gdouble));
+
+  if (input->deletions != NULL)
+    input->deletions_raw = g_variant_get_fixed_array (input->deletions,
+                                                      &input->deletions_len,
+                                                      sizeof (DeletionEntry));
+
+  if (!g_variant_lookup (input->metadata, "case-sensitive", "b", &input->case_sensitive))
+    input->case_sensitive = FALSE;
+
+  if (!input->case_sensitive)
+    {
+      gsize i;
+
+      input->folded = g_new0 (gchar *, input->n_keys + 1);
+      for (i = 0; i < input->n_keys; i++)
+        input->folded [i] = g_utf8_casefold (input->keys_raw [i], -1);
+    }
+
+  return input;
+}
+
+static inline const gchar *
+merge_input_get_sort_key (const MergeInput *input,
+                          guint             lookaside_id)
+{
+  guint key_id = input->lookaside_raw [lookaside_id].key_id;
+
+  return input->folded ? input->folded [key_id] : input->keys_raw [key_id];
+}
+
+/*
+ * Compares the heads of two inputs the same way the builder orders the
+ * sorted table: by key, and then by the (merged) lookaside id.
+ */
+static gint
+merge_input_compare (const MergeInput *a,
+                     const MergeInput *b)
+{
+  guint ida = a->sorted_raw [a->sorted_pos];
+  guint idb = b->sorted_raw [b->sorted_pos];
+  gint ret;
+
+  ret = strcmp (merge_input_get_sort_key (a, ida),
+                merge_input_get_sort_key (b, idb));
+
+  if (ret == 0)
+    {
+      ida += a->lookaside_offset;
+      idb += b->lookaside_offset;
+      ret = (ida > idb) - (ida < idb);
+    }
+
+  return ret;
+}
+
+/*
+ * Compares the heads of two inputs the same way the builder orders the
+ * deletions: by key with a character removed, then by the (merged)
+ * lookaside id and the offset of the removed character.
+ */
+static gint
+merge_input_compare_deletions (const MergeInput *a,
+                               const MergeInput *b)
+{
+  DeletionEntry da = a->deletions_raw [a->deletions_pos];
+  DeletionEntry db = b->deletions_raw [b->deletions_pos];
+  gint ret;
+
+  ret = fuzzy_deletion_compare (merge_input_get_sort_key (a, da.lookaside_id),
+                                da.offset,
+                                merge_input_get_sort_key (b, db.lookaside_id),
+                                db.offset,
+                                G_MAXSIZE);
+
+  if (ret == 0)
+    {
+      da.lookaside_id += a->lookaside_offset;
+      db.lookaside_id += b->lookaside_offset;
+      ret = (da.lookaside_id > db.lookaside_id) - (da.lookaside_id < db.lookaside_id);
+    }
+
+  if (ret == 0)
+    ret = (da.offset > db.offset) - (da.offset < db.offset);
+
+  return ret;
+}
+
+static void
+merge_heap_sift_down (MergeInput        **heap,
+                      guint               n_heap,
+                      guint               pos,
+                      MergeInputCompare   compare)
+{
+  for (;;)
+    {
+      guint left = pos * 2 + 1;
+      guint right = left + 1;
+      guint smallest = pos;
+      MergeInput *tmp;
+
+      if (left < n_heap && compare (heap [left], heap [smallest]) < 0)
+        smallest = left;
+
+      if (right < n_heap && compare (heap [right], heap [smallest]) < 0)
+        smallest = right;
+
+      if (smallest == pos)
+        break;
+
+      tmp = heap [pos];
+      heap [pos] = heap [smallest];
+      heap [smallest] = tmp;
+      pos = smallest;
+    }
+}
+
+/*
+ * Each input already has its lookaside ids sorted by key, so we only
+ * need a k-way merge of those runs rather than sorting every key again.
+ */
+static GVariant *
+fuzzy_index_merge_build_sorted (GPtrArray *inputs,
+                                gsize      n_lookaside)
+{
+  g_autofree MergeInput **heap = NULL;
+  g_autoptr(GArray) sorted = NULL;
+  guint n_heap = 0;
+  guint i;
+
+  heap = g_new0 (MergeInput *, inputs->len);
+  sorted = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_lookaside);
+
+  for (i = 0; i < inputs->len; i++)
+    {
+      MergeInput *input = g_ptr_array_index (inputs, i);
+
+      input->sorted_pos = 0;
+
+      if (input->sorted_len > 0)
+        heap [n_heap++] = input;
+    }
+
+  for (i = n_heap / 2; i > 0; i--)
+    merge_heap_sift_down (heap, n_heap, i - 1, merge_input_compare);
+
+  while (n_heap > 0)
+    {
+      MergeInput *input = heap [0];
+      guint lookaside_id = input->lookaside_offset + input->sorted_raw [input->sorted_pos];
+
+      g_array_append_val (sorted, lookaside_id);
+
+      if (++input->sorted_pos == input->sorted_len)
+        heap [0] = heap [--n_heap];
+
+      merge_heap_sift_down (heap, n_heap, 0, merge_input_compare);
+    }
+
+  return g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                    sorted->data,
+                                    sorted->len,
+                                    sizeof (guint));
+}
+
+/*
+ * The deletions of each input are sorted too, so they are merged the same
+ * way as the sorted tables. The offsets stay valid because merged keys
+ * are the same strings as the input keys.
+ */
+static GVariant *
+fuzzy_index_merge_build_deletions (GPtrArray *inputs)
+{
+  g_autofree MergeInput **heap = NULL;
+  g_autoptr(GArray) deletions = NULL;
+  guint n_heap = 0;
+  guint i;
+
+  heap = g_new0 (MergeInput *, inputs->len);
+  deletions = g_array_new (FALSE, FALSE, sizeof (DeletionEntry));
+
+  for (i = 0; i < inputs->len; i++)
+    {
+      MergeInput *input = g_ptr_array_index (inputs, i);
+
+      input->deletions_pos = 0;
+
+      if (input->deletions_len > 0)
+        heap [n_heap++] = input;
+    }
+
+  for (i = n_heap / 2; i > 0; i--)
+    merge_heap_sift_down (heap, n_heap, i - 1, merge_input_compare_deletions);
+
+  while (n_heap > 0)
+    {
+      MergeInput *input = heap [0];
+      DeletionEntry entry = input->deletions_raw [input->deletions_pos];
+
+      entry.lookaside_id += input->lookaside_offset;
+      g_array_append_val (deletions, entry);
+
+      if (++input->deletions_pos == input->deletions_len)
+        heap [0] = heap [--n_heap];
+
+      merge_heap_sift_down (heap, n_heap, 0, merge_input_compare_deletions);
+    }
+
+  return g_variant_new_fixed_array ((const GVariantType *)"(uu)",
+                                    deletions->data,
+                                    deletions->len,
+                                    sizeof (DeletionEntry));
+}
+
+/*
+ * Rows in each input are ordered by (lookaside_id, position), and the
+ * lookaside ids of later inputs are offset past those of earlier ones.
+ * Appending the rows in input order therefore keeps them sorted, so the
+ * tables are merged in a single pass without sorting.
+ */
+static GVariant *
+fuzzy_index_merge_build_tables (GPtrArray *inputs)
+{
+  g_autoptr(GHashTable) rows = NULL;
+  GHashTableIter hiter;
+  GVariantDict dict;
+  const gchar *ch;
+  GArray *row;
+  guint i;
+
+  rows = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify)g_array_unref);
+
+  for (i = 0; i < inputs->len; i++)
+    {
+      MergeInput *input = g_ptr_array_index (inputs, i);
+      GVariantIter iter;
+      GVariant *value;
+
+      g_variant_iter_init (&iter, input->tables);
+
+      while (g_variant_iter_loop (&iter, "{&sv}", &ch, &value))
+        {
+          const FuzzyIndexItem *items;
+          gsize n_items = 0;
+          gsize j;
+
+          items = g_variant_get_fixed_array (value, &n_items, sizeof (FuzzyIndexItem));
+
+          if G_UNLIKELY (NULL == (row = g_hash_table_lookup (rows, ch)))
+            {
+              row = g_array_sized_new (FALSE, FALSE, sizeof (FuzzyIndexItem), n_items);
+              g_hash_table_insert (rows, (gchar *)ch, row);
+            }
+
+          for (j = 0; j < n_items; j++)
+            {
+              FuzzyIndexItem item = items [j];
+
+              item.lookaside_id += input->lookaside_offset;
+              g_array_append_val (row, item);
+            }
+        }
+    }
+
+  g_variant_dict_init (&dict, NULL);
+
+  g_hash_table_iter_init (&hiter, rows);
+
+  while (g_hash_table_iter_next (&hiter, (gpointer *)&ch, (gpointer *)&row))
+    g_variant_dict_insert_value (&dict,
+                                 ch,
+                                 g_variant_new_fixed_array ((const GVariantType *)"(uu)",
+                                                            row->data,
+                                                            row->len,
+                                                            sizeof (FuzzyIndexItem)));
+
+  return g_variant_dict_end (&dict);
+}
+
+/*
+ * Only metadata which every input agrees upon still describes the
+ * merged index, such as the indexer version. Things like the mtime
+ * of an individual source are dropped.
+ */
+static GVariant *
+fuzzy_index_merge_build_metadata (GPtrArray *inputs,
+                                  gboolean   case_sensitive)
+{
+  MergeInput *first = g_ptr_array_index (inputs, 0);
+  GVariantDict dict;
+  GVariantIter iter;
+  const gchar *key;
+  GVariant *value;
+
+  g_variant_dict_init (&dict, NULL);
+
+  g_variant_iter_init (&iter, first->metadata);
+
+  while (g_variant_iter_loop (&iter, "{&sv}", &key, &value))
+    {
+      gboolean shared = TRUE;
+      guint i;
+
+      for (i = 1; shared && i < inputs->len; i++)
+        {
+          MergeInput *input = g_ptr_array_index (inputs, i);
+          g_autoptr(GVariant) other = g_variant_lookup_value (input->metadata, key, NULL);
+
+          shared = other != NULL && g_variant_equal (value, other);
+        }
+
+      if (shared)
+        g_variant_dict_insert_value (&dict, key, value);
+    }
+
+  g_variant_dict_insert (&dict, "case-sensitive", "b", case_sensitive);
+
+  return g_variant_dict_end (&dict);
+}
+
+static GVariant *
+fuzzy_index_merge_build (GPtrArray     *inputs,
+                         GCancellable  *cancellable,
+                         GError       **error)
+{
+  g_autoptr(GHashTable) documents_hash = NULL;
+  g_autoptr(GHashTable) key_ids = NULL;
+  g_autoptr(GPtrArray) documents = NULL;
+  g_autoptr(GPtrArray) keys = NULL;
+  g_autoptr(GArray) lookaside = NULL;
+  g_autoptr(GArray) ranks = NULL;
+  const GVariantType *documents_type = NULL;
+  MergeInput *first;
+  GVariantDict dict;
+  gboolean case_sensitive;
+  guint i;
+
+  g_assert (inputs != NULL);
+  g_assert (inputs->len > 0);
+
+  first = g_ptr_array_index (inputs, 0);
+  case_sensitive = first->case_sensitive;
+
+  for (i = 0; i < inputs->len; i++)
+    {
+      MergeInput *input = g_ptr_array_index (inputs, i);
+
+      if (input->case_sensitive != case_sensitive)
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVAL,
+                       "Cannot merge case-sensitive and case-insensitive indexes");
+          return NULL;
+        }
+
+      if (g_variant_n_children (input->documents) == 0)
+        continue;
+
+      if (documents_type == NULL)
+        documents_type = g_variant_get_type (input->documents);
+      else if (!g_variant_type_equal (documents_type, g_variant_get_type (input->documents)))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVAL,
+                       "Cannot merge indexes with documents of different types");
+          return NULL;
+        }
+    }
+
+  documents = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+  documents_hash = g_hash_table_new (fuzzy_g_variant_hash, g_variant_equal);
+  keys = g_ptr_array_new ();
+  key_ids = g_hash_table_new (g_str_hash, g_str_equal);
+  lookaside = g_array_new (FALSE, FALSE, sizeof (LookasideEntry));
+
+  /*
+   * Deduplicate keys and documents across the inputs like the builder
+   * does within a single index, remembering where each one ended up.
+   */
+  for (i = 0; i < inputs->len; i++)
+    {
+      MergeInput *input = g_ptr_array_index (inputs, i);
+      gsize n_documents = g_variant_n_children (input->documents);
+      gsize j;
+
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        return NULL;
+
+      input->key_map = g_new (guint, input->n_keys);
+
+      for (j = 0; j < input->n_keys; j++)
+        {
+          const gchar *key = input->keys_raw [j];
+          gpointer key_id;
+
+          if (!g_hash_table_lookup_extended (key_ids, key, NULL, &key_id))
+            {
+              key_id = GUINT_TO_POINTER (keys->len);
+              g_ptr_array_add (keys, (gchar *)key);
+              g_hash_table_insert (key_ids, (gchar *)key, key_id);
+            }
+
+          input->key_map [j] = GPOINTER_TO_UINT (key_id);
+        }
+
+      input->document_map = g_new (guint, n_documents);
+
+      for (j = 0; j < n_documents; j++)
+        {
+          g_autoptr(GVariant) document = g_variant_get_child_value (input->documents, j);
+          gpointer document_id;
+
+          if (!g_hash_table_lookup_extended (documents_hash, document, NULL, &document_id))
+            {
+              document_id = GUINT_TO_POINTER (documents->len);
+              g_ptr_array_add (documents, g_variant_ref (document));
+              g_hash_table_insert (documents_hash, document, document_id);
+            }
+
+          input->document_map [j] = GPOINTER_TO_UINT (document_id);
+
+          /* A document shared by several inputs keeps its best rank */
+          if (input->ranks_raw != NULL)
+            {
+              guint merged_id = GPOINTER_TO_UINT (document_id);
+              gdouble rank = j < input->ranks_len ? input->ranks_raw [j] : 0.0;
+
+              if (ranks == NULL)
+                ranks = g_array_new (FALSE, TRUE, sizeof (gdouble));
+
+              if (merged_id >= ranks->len)
+                g_array_set_size (ranks, merged_id + 1);
+
+              if (rank > g_array_index (ranks, gdouble, merged_id))
+                g_array_index (ranks, gdouble, merged_id) = rank;
+            }
+        }
+
+      input->lookaside_offset = lookaside->len;
+
+      for (j = 0; j < input->lookaside_len; j++)
+        {
+          LookasideEntry entry = input->lookaside_raw [j];
+
+          entry.key_id = input->key_map [entry.key_id];
+          entry.document_id = input->document_map [entry.document_id];
+          g_array_append_val (lookaside, entry);
+        }
+    }
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return NULL;
+
+  g_variant_dict_init (&dict, NULL);
+
+  g_variant_dict_insert (&dict, "version", "i", FUZZY_INDEX_VERSION);
+  g_variant_dict_insert_value (&dict,
+                               "metadata",
+                               fuzzy_index_merge_build_metadata (inputs, case_sensitive));
+  g_variant_dict_insert_value (&dict,
+                               "keys",
+                               g_variant_new_strv ((const gchar * const *)keys->pdata, keys->len));
+  g_variant_dict_insert_value (&dict,
+                               "lookaside",
+                               g_variant_new_fixed_array ((const GVariantType *)"(uuu)",
+                                                          lookaside->data,
+                                                          lookaside->len,
+                                                          sizeof (LookasideEntry)));
+  g_variant_dict_insert_value (&dict,
+                               "tables",
+                               fuzzy_index_merge_build_tables (inputs));
+  g_variant_dict_insert_value (&dict,
+                               "sorted",
+                               fuzzy_index_merge_build_sorted (inputs, lookaside->len));
+  g_variant_dict_insert_value (&dict,
+                               "deletions",
+                               fuzzy_index_merge_build_deletions (inputs));
+
+  if (ranks != NULL)
+    {
+      if (ranks->len < documents->len)
+        g_array_set_size (ranks, documents->len);
+
+      g_variant_dict_insert_value (&dict,
+                                   "ranks",
+                                   g_variant_new_fixed_array (G_VARIANT_TYPE_DOUBLE,
+                                                              ranks->data,
+                                                              ranks->len,
+                                                              sizeof (gdouble)));
+    }
+
+  g_variant_dict_insert_value (&dict,
+                               "documents",
+                               g_variant_new_array (documents_type ? g_variant_type_element (documents_type)
+                                                                   : G_VARIANT_TYPE_VARIANT,
+                                                    (GVariant * const *)documents->pdata,
+                                                    documents->len));
+
+  return g_variant_ref_sink (g_variant_dict_end (&dict));
+}
+
+static void
+fuzzy_index_merge_worker (GTask        *task,
+                          gpointer      source_object,
+                          gpointer      task_data,
+                          GCancellable *cancellable)
+{
+  g_autoptr(GPtrArray) inputs = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  Merge *merge = task_data;
+  GError *error = NULL;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (merge != NULL);
+  g_assert (merge->inputs->len > 0);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  inputs = g_ptr_array_new_with_free_func (merge_input_free);
+
+  for (i = 0; i < merge->inputs->len; i++)
+    {
+      MergeInput *input;
+
+      if (NULL == (input = merge_input_load (g_ptr_array_index (merge->inputs, i), cancellable, &error)))
+        {
+          g_task_return_error (task, error);
+          return;
+        }
+
+      g_ptr_array_add (inputs, input);
+    }
+
+  if (NULL == (variant = fuzzy_index_merge_build (inputs, cancellable, &error)) ||
+      !_fuzzy_index_write_variant (merge->output, variant, cancellable, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+static GTask *
+fuzzy_index_merge_task_new (GFile * const        *inputs,
+                            guint                 n_inputs,
+                            GFile                *output,
+                            gint                  io_priority,
+                            GCancellable         *cancellable,
+                            GAsyncReadyCallback   callback,
+                            gpointer              user_data)
+{
+  GTask *task;
+  Merge *merge;
+  guint i;
+
+  merge = g_slice_new0 (Merge);
+  merge->inputs = g_ptr_array_new_with_free_func (g_object_unref);
+  merge->output = g_object_ref (output);
+
+  for (i = 0; i < n_inputs; i++)
+    g_ptr_array_add (merge->inputs, g_object_ref (inputs [i]));
+
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_priority (task, io_priority);
+  g_task_set_task_data (task, merge, merge_free);
+
+  return task;
+}
+
+/**
+ * fuzzy_index_merge_async:
+ * @inputs: (array length=n_inputs): The index files to merge
+ * @n_inputs: The number of elements in @inputs
+ * @output: A #GFile to write the merged index to
+ * @io_priority: The priority for IO operations
+ * @cancellable: (nullable): An optional #GCancellable or %NULL
+ * @callback: A callback for completion or %NULL
+ * @user_data: User data for @callback
+ *
+ * Combines the indexes found in @inputs into a single index that is
+ * written to @output, without the documents having to be indexed again.
+ *
+ * Keys and documents are deduplicated across the inputs and their ids
+ * remapped, while the character tables and sorted keys of the inputs
+ * are merged as they are, which is much cheaper than building the
+ * combined index from scratch. Metadata is only kept when all of the
+ * inputs agree on its value.
+ */
+void
+fuzzy_index_merge_async (GFile * const        *inputs,
+                         guint                 n_inputs,
+                         GFile                *output,
+                         gint                  io_priority,
+                         GCancellable         *cancellable,
+                         GAsyncReadyCallback   callback,
+                         gpointer              user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (inputs != NULL);
+  g_return_if_fail (n_inputs > 0);
+  g_return_if_fail (G_IS_FILE (output));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = fuzzy_index_merge_task_new (inputs, n_inputs, output, io_priority,
+                                     cancellable, callback, user_data);
+  g_task_set_source_tag (task, fuzzy_index_merge_async);
+  g_task_run_in_thread (task, fuzzy_index_merge_worker);
+}
+
+gboolean
+fuzzy_index_merge_finish (GAsyncResult  *result,
+                          GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+gboolean
+fuzzy_index_merge (GFile * const  *inputs,
+                   guint           n_inputs,
+                   GFile          *output,
+                   GCancellable   *cancellable,
+                   GError        **error)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_val_if_fail (inputs != NULL, FALSE);
+  g_return_val_if_fail (n_inputs > 0, FALSE);
+  g_return_val_if_fail (G_IS_FILE (output), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  task = fuzzy_index_merge_task_new (inputs, n_inputs, output, G_PRIORITY_DEFAULT,
+                                     cancellable, NULL, NULL);
+  g_task_set_source_tag (task, fuzzy_index_merge);
+
+  fuzzy_index_merge_worker (task, NULL, g_task_get_task_data (task), cancellable);
+
+  return g_task_propagate_boolean (task, error);
+}
@@ -0,0 +1,43 @@
+/* fuzzy-index-merge.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUZZY_INDEX_MERGE_H
+#define FUZZY_INDEX_MERGE_H
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+gboolean fuzzy_index_merge        (GFile * const        *inputs,
+                                   guint                 n_inputs,
+                                   GFile                *output,
+                                   GCancellable         *cancellable,
+                                   GError              **error);
+void     fuzzy_index_merge_async  (GFile * const        *inputs,
+                                   guint                 n_inputs,
+                                   GFile                *output,
+                                   gint                  io_priority,
+                                   GCancellable         *cancellable,
+                                   GAsyncReadyCallback   callback,
+                                   gpointer              user_data);
+gboolean fuzzy_index_merge_finish (GAsyncResult         *result,
+                                   GError              **error);
+
+G_END_DECLS
+
+#endif /* FUZZY_INDEX_MERGE_H */
@@ -23,12 +23,91 @@
 
 G_BEGIN_DECLS
 
+/*
+ * The version of the index format, which is bumped whenever the layout
+ * of the tables changes in an incompatible way.
+ */
+#define FUZZY_INDEX_VERSION 3
+
+/*
+ * Index files start with a fixed size header, followed by the GVariant
+ * payload. Loading only checks the header, and GVariant checks the
+ * parts of the payload that are accessed, so that an index can be used
+ * without reading all of it. The checksum of the payload is verified by
+ * _fuzzy_index_verify() when all of it is read anyway. The header size
+ * keeps the payload 8-byte aligned within the mapped file.
+ *
+ * All integers are little-endian.
+ */
+#define FUZZY_INDEX_MAGIC        "FUZZYIDX"
+#define FUZZY_INDEX_MAGIC_LEN    8
+#define FUZZY_INDEX_CHECKSUM_LEN 32
+
+typedef struct
+{
+  gchar   magic [FUZZY_INDEX_MAGIC_LEN];
+  guint32 version;
+  guint32 flags;
+  guint64 payload_length;
+  guint8  checksum [FUZZY_INDEX_CHECKSUM_LEN];
+  guint8  reserved [8];
+} FuzzyIndexHeader;
+
+G_STATIC_ASSERT (sizeof (FuzzyIndexHeader) == 64);
+
+/* The layout of each "(uuu)" element of the "lookaside" table */
+typedef struct
+{
+  guint key_id;
+  guint document_id;
+  guint priority;
+} LookasideEntry;
+
+/*
+ * Bounds of the typo fallback. Queries shorter than FUZZY_TYPO_MIN_CHARS
+ * would match nearly everything once a character is dropped. Only the
+ * deletions of the first FUZZY_TYPO_MAX_CHARS characters of each key are
+ * indexed, and longer queries are not corrected.
+ */
+#define FUZZY_TYPO_MIN_CHARS 4
+#define FUZZY_TYPO_MAX_CHARS 32
+
+/*
+ * The layout of each "(uu)" element of the "deletions" table. @offset is
+ * the byte offset of a character within the (casefolded) key, and the
+ * table is sorted by the key with that character removed.
+ */
+typedef struct
+{
+  guint lookaside_id;
+  guint offset;
+} DeletionEntry;
+
+gboolean     _fuzzy_index_load_built      (FuzzyIndex    *self,
+                                           GVariant      *variant,
+                                           GError       **error);
+gboolean     _fuzzy_index_verify          (FuzzyIndex    *self,
+                                           GError       **error);
+gboolean     _fuzzy_index_write_variant   (GFile         *file,
+                                           GVariant      *variant,
+                                           GCancellable  *cancellable,
+                                           GError       **error);
 GVariant    *_fuzzy_index_lookup_document (FuzzyIndex *self,
                                            guint       document_id);
+GVariant    *_fuzzy_index_get_variant     (FuzzyIndex   *self);
 gboolean     _fuzzy_index_resolve         (FuzzyIndex   *self,
                                            guint         lookaside_id,
                                            guint        *document_id,
-                                           const gchar **key);
+                                           const gchar **key,
+                                           guint        *priority);
+const guint *_fuzzy_index_get_sorted      (FuzzyIndex   *self,
+                                           gsize        *n_sorted);
+gdouble      _fuzzy_index_get_rank        (FuzzyIndex   *self,
+                                           guint         document_id);
+gdouble      _fuzzy_index_get_max_rank    (FuzzyIndex   *self);
+const DeletionEntry *
+             _fuzzy_index_get_deletions   (FuzzyIndex   *self,
+                                           gsize        *n_deletions);
 
 G_END_DECLS
 
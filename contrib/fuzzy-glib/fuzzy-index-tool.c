@@ -0,0 +1,664 @@
+/* fuzzy-index-tool.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzzy-glib.h"
+#include "fuzzy-index-private.h"
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *usage;
+  gint       (*func) (gint    argc,
+                      gchar **argv);
+} Command;
+
+typedef struct
+{
+  guint position;
+  guint lookaside_id;
+} FuzzyIndexItem;
+
+typedef struct
+{
+  const gchar *name;
+  gsize        n_items;
+} RowInfo;
+
+typedef struct
+{
+  GMainLoop  *main_loop;
+  GListModel *results;
+  GError     *error;
+} BenchState;
+
+static FuzzyIndex *
+load_index (const gchar *path)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GError) error = NULL;
+
+  file = g_file_new_for_commandline_arg (path);
+  index = fuzzy_index_new ();
+
+  /* Every command reads most of the index, so check all of it */
+  if (!fuzzy_index_load_file (index, file, NULL, &error) ||
+      !_fuzzy_index_verify (index, &error))
+    {
+      g_printerr ("%s: %s\n", path, error->message);
+      return NULL;
+    }
+
+  return g_steal_pointer (&index);
+}
+
+static GVariant *
+lookup_table (FuzzyIndex         *index,
+              const gchar        *name,
+              const GVariantType *type)
+{
+  return g_variant_lookup_value (_fuzzy_index_get_variant (index), name, type);
+}
+
+static gint
+compare_uint (gconstpointer a,
+              gconstpointer b)
+{
+  guint ua = *(const guint *)a;
+  guint ub = *(const guint *)b;
+
+  return (ua > ub) - (ua < ub);
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble da = *(const gdouble *)a;
+  gdouble db = *(const gdouble *)b;
+
+  return (da > db) - (da < db);
+}
+
+static gint
+compare_row_size (gconstpointer a,
+                  gconstpointer b)
+{
+  const RowInfo *ra = a;
+  const RowInfo *rb = b;
+
+  return (rb->n_items > ra->n_items) - (rb->n_items < ra->n_items);
+}
+
+/*
+ * Gets the value at @pct (0..100) of an already sorted array.
+ */
+static gdouble
+percentile (const gdouble *sorted,
+            guint          len,
+            gdouble        pct)
+{
+  guint pos;
+
+  if (len == 0)
+    return 0.0;
+
+  pos = (guint)ceil (pct / 100.0 * len);
+  pos = CLAMP (pos, 1, len);
+
+  return sorted [pos - 1];
+}
+
+static gint
+command_stats (gint    argc,
+               gchar **argv)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GVariant) keys = NULL;
+  g_autoptr(GVariant) tables = NULL;
+  g_autoptr(GArray) lengths = NULL;
+  g_autoptr(GArray) rows = NULL;
+  g_autofree const gchar **keys_raw = NULL;
+  GVariant *variant;
+  GVariantIter iter;
+  const gchar *name;
+  GVariant *value;
+  gsize n_keys = 0;
+  guint64 total = 0;
+  guint buckets [9] = { 0 };
+  guint i;
+
+  if (argc != 1)
+    return -1;
+
+  if (NULL == (index = load_index (argv[0])))
+    return EXIT_FAILURE;
+
+  variant = _fuzzy_index_get_variant (index);
+
+  g_print ("%-16s %12s %8s\n", "Table", "Bytes", "Share");
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &value))
+    g_print ("%-16s %12"G_GSIZE_FORMAT" %7.1lf%%\n",
+             name,
+             g_variant_get_size (value),
+             100.0 * g_variant_get_size (value) / MAX (1, g_variant_get_size (variant)));
+
+  g_print ("%-16s %12"G_GSIZE_FORMAT"\n\n", "Total", g_variant_get_size (variant));
+
+  /* The key length distribution, in characters */
+  keys = lookup_table (index, "keys", G_VARIANT_TYPE_STRING_ARRAY);
+  keys_raw = g_variant_get_strv (keys, &n_keys);
+  lengths = g_array_sized_new (FALSE, FALSE, sizeof (guint), n_keys);
+
+  for (i = 0; i < n_keys; i++)
+    {
+      guint len = g_utf8_strlen (keys_raw [i], -1);
+
+      g_array_append_val (lengths, len);
+      total += len;
+      buckets [MIN (len / 8, G_N_ELEMENTS (buckets) - 1)]++;
+    }
+
+  g_array_sort (lengths, compare_uint);
+
+  g_print ("Keys: %"G_GSIZE_FORMAT"\n", n_keys);
+
+  if (n_keys > 0)
+    {
+      g_print ("Key length: min %u, median %u, p90 %u, max %u, mean %.1lf\n",
+               g_array_index (lengths, guint, 0),
+               g_array_index (lengths, guint, n_keys / 2),
+               g_array_index (lengths, guint, MIN (n_keys - 1, n_keys * 9 / 10)),
+               g_array_index (lengths, guint, n_keys - 1),
+               (gdouble)total / n_keys);
+
+      for (i = 0; i < G_N_ELEMENTS (buckets); i++)
+        {
+          if (i + 1 < G_N_ELEMENTS (buckets))
+            g_print ("  %3u-%-3u %8u\n", i * 8, i * 8 + 7, buckets [i]);
+          else
+            g_print ("  %3u+    %8u\n", i * 8, buckets [i]);
+        }
+    }
+
+  /* The character rows which the cursor has to walk the most */
+  tables = lookup_table (index, "tables", G_VARIANT_TYPE_VARDICT);
+  rows = g_array_new (FALSE, FALSE, sizeof (RowInfo));
+
+  g_variant_iter_init (&iter, tables);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &value))
+    {
+      RowInfo info = { name, g_variant_n_children (value) };
+
+      g_array_append_val (rows, info);
+    }
+
+  g_array_sort (rows, compare_row_size);
+
+  g_print ("\nCharacter rows: %u\n", rows->len);
+
+  for (i = 0; i < MIN (rows->len, 10); i++)
+    {
+      const RowInfo *info = &g_array_index (rows, RowInfo, i);
+
+      g_print ("  '%s' %8"G_GSIZE_FORMAT" entries\n", info->name, info->n_items);
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static gint
+command_merge (gint    argc,
+               gchar **argv)
+{
+  g_autoptr(GPtrArray) inputs = NULL;
+  g_autoptr(GFile) output = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 begin;
+  gint i;
+
+  if (argc < 3)
+    return -1;
+
+  output = g_file_new_for_commandline_arg (argv[0]);
+  inputs = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (i = 1; i < argc; i++)
+    g_ptr_array_add (inputs, g_file_new_for_commandline_arg (argv[i]));
+
+  begin = g_get_monotonic_time ();
+
+  if (!fuzzy_index_merge ((GFile * const *)inputs->pdata, inputs->len, output, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("Merged %u indexes in %.3lf seconds\n",
+           inputs->len,
+           (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC);
+
+  return EXIT_SUCCESS;
+}
+
+static gint
+command_dump (gint    argc,
+              gchar **argv)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GVariant) keys = NULL;
+  g_autoptr(GVariant) lookaside = NULL;
+  g_autoptr(GVariant) documents = NULL;
+  g_autoptr(GPtrArray) doc_keys = NULL;
+  g_autofree const gchar **keys_raw = NULL;
+  const LookasideEntry *entries;
+  gsize n_entries = 0;
+  gsize n_keys = 0;
+  gsize n_documents;
+  gsize i;
+
+  if (argc != 1)
+    return -1;
+
+  if (NULL == (index = load_index (argv[0])))
+    return EXIT_FAILURE;
+
+  keys = lookup_table (index, "keys", G_VARIANT_TYPE_STRING_ARRAY);
+  lookaside = lookup_table (index, "lookaside", (const GVariantType *)"a(uuu)");
+  documents = lookup_table (index, "documents", G_VARIANT_TYPE_ARRAY);
+
+  keys_raw = g_variant_get_strv (keys, &n_keys);
+  entries = g_variant_get_fixed_array (lookaside, &n_entries, sizeof (LookasideEntry));
+  n_documents = g_variant_n_children (documents);
+
+  /* Group the keys by the document they point to */
+  doc_keys = g_ptr_array_new_full (n_documents, (GDestroyNotify)g_ptr_array_unref);
+  for (i = 0; i < n_documents; i++)
+    g_ptr_array_add (doc_keys, g_ptr_array_new ());
+
+  for (i = 0; i < n_entries; i++)
+    {
+      if (entries [i].document_id < n_documents && entries [i].key_id < n_keys)
+        g_ptr_array_add (g_ptr_array_index (doc_keys, entries [i].document_id),
+                         (gpointer)&entries [i]);
+    }
+
+  for (i = 0; i < n_documents; i++)
+    {
+      g_autoptr(GVariant) document = g_variant_get_child_value (documents, i);
+      g_autofree gchar *str = g_variant_print (document, TRUE);
+      GPtrArray *ar = g_ptr_array_index (doc_keys, i);
+      guint j;
+
+      g_print ("%"G_GSIZE_FORMAT" %s (rank %.4lf)\n", i, str, _fuzzy_index_get_rank (index, i));
+
+      for (j = 0; j < ar->len; j++)
+        {
+          const LookasideEntry *entry = g_ptr_array_index (ar, j);
+
+          g_print ("    %s (priority %u)\n", keys_raw [entry->key_id], entry->priority);
+        }
+    }
+
+  return EXIT_SUCCESS;
+}
+
+static gint
+command_verify (gint    argc,
+                gchar **argv)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GVariant) keys = NULL;
+  g_autoptr(GVariant) lookaside = NULL;
+  g_autoptr(GVariant) documents = NULL;
+  g_autoptr(GVariant) sorted = NULL;
+  g_autoptr(GVariant) ranks = NULL;
+  g_autoptr(GVariant) tables = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  g_autofree const gchar **keys_raw = NULL;
+  g_autofree guint *key_lengths = NULL;
+  g_auto(GStrv) folded = NULL;
+  g_autofree guint8 *seen = NULL;
+  const LookasideEntry *entries;
+  const guint *sorted_raw = NULL;
+  GVariantIter iter;
+  const gchar *name;
+  GVariant *value;
+  gboolean case_sensitive = FALSE;
+  guint64 expected_items = 0;
+  guint64 n_items = 0;
+  gsize n_entries = 0;
+  gsize n_sorted = 0;
+  gsize n_keys = 0;
+  gsize n_documents;
+  gsize i;
+  guint errors = 0;
+
+#define FAIL(...) G_STMT_START { g_printerr (__VA_ARGS__); g_printerr ("\n"); errors++; } G_STMT_END
+
+  if (argc != 1)
+    return -1;
+
+  /* Loading verifies the header and checksum of the payload */
+  if (NULL == (index = load_index (argv[0])))
+    return EXIT_FAILURE;
+
+  keys = lookup_table (index, "keys", G_VARIANT_TYPE_STRING_ARRAY);
+  lookaside = lookup_table (index, "lookaside", (const GVariantType *)"a(uuu)");
+  documents = lookup_table (index, "documents", G_VARIANT_TYPE_ARRAY);
+  sorted = lookup_table (index, "sorted", (const GVariantType *)"au");
+  ranks = lookup_table (index, "ranks", (const GVariantType *)"ad");
+  tables = lookup_table (index, "tables", G_VARIANT_TYPE_VARDICT);
+  metadata = lookup_table (index, "metadata", G_VARIANT_TYPE_VARDICT);
+
+  g_variant_lookup (metadata, "case-sensitive", "b", &case_sensitive);
+
+  keys_raw = g_variant_get_strv (keys, &n_keys);
+  entries = g_variant_get_fixed_array (lookaside, &n_entries, sizeof (LookasideEntry));
+  n_documents = g_variant_n_children (documents);
+
+  /* Keys are compared in the form the cursor sees them */
+  folded = g_new0 (gchar *, n_keys + 1);
+  key_lengths = g_new0 (guint, n_keys);
+  for (i = 0; i < n_keys; i++)
+    {
+      folded [i] = case_sensitive ? g_strdup (keys_raw [i]) : g_utf8_casefold (keys_raw [i], -1);
+      key_lengths [i] = g_utf8_strlen (folded [i], -1);
+    }
+
+  for (i = 0; i < n_entries; i++)
+    {
+      if (entries [i].key_id >= n_keys)
+        FAIL ("lookaside %"G_GSIZE_FORMAT": key %u out of range", i, entries [i].key_id);
+      else
+        expected_items += key_lengths [entries [i].key_id];
+
+      if (entries [i].document_id >= n_documents)
+        FAIL ("lookaside %"G_GSIZE_FORMAT": document %u out of range", i, entries [i].document_id);
+    }
+
+  if (sorted == NULL)
+    FAIL ("missing sorted table");
+  else
+    sorted_raw = g_variant_get_fixed_array (sorted, &n_sorted, sizeof (guint));
+
+  if (sorted != NULL && n_sorted != n_entries)
+    FAIL ("sorted table has %"G_GSIZE_FORMAT" entries, expected %"G_GSIZE_FORMAT,
+          n_sorted, n_entries);
+
+  /* The sorted table must be a permutation of the lookaside ids, ordered by key */
+  seen = g_new0 (guint8, n_entries);
+  for (i = 0; i < n_sorted; i++)
+    {
+      guint id = sorted_raw [i];
+
+      if (id >= n_entries)
+        {
+          FAIL ("sorted %"G_GSIZE_FORMAT": lookaside %u out of range", i, id);
+          continue;
+        }
+
+      if (seen [id]++)
+        FAIL ("sorted %"G_GSIZE_FORMAT": lookaside %u is listed twice", i, id);
+
+      if (i > 0 && sorted_raw [i - 1] < n_entries &&
+          entries [id].key_id < n_keys &&
+          entries [sorted_raw [i - 1]].key_id < n_keys)
+        {
+          gint cmp = strcmp (folded [entries [sorted_raw [i - 1]].key_id],
+                             folded [entries [id].key_id]);
+
+          if (cmp > 0 || (cmp == 0 && sorted_raw [i - 1] > id))
+            FAIL ("sorted %"G_GSIZE_FORMAT": out of order", i);
+        }
+    }
+
+  if (ranks != NULL)
+    {
+      gsize n_ranks = 0;
+      const gdouble *ranks_raw = g_variant_get_fixed_array (ranks, &n_ranks, sizeof (gdouble));
+
+      if (n_ranks != n_documents)
+        FAIL ("ranks table has %"G_GSIZE_FORMAT" entries, expected %"G_GSIZE_FORMAT,
+              n_ranks, n_documents);
+
+      for (i = 0; i < n_ranks; i++)
+        {
+          if (!isfinite (ranks_raw [i]))
+            FAIL ("rank %"G_GSIZE_FORMAT" is not finite", i);
+        }
+    }
+
+  /*
+   * Each row must be ordered by (lookaside_id, position) for the cursor
+   * to walk them in step, and every character of every key must be found
+   * in exactly one row.
+   */
+  g_variant_iter_init (&iter, tables);
+  while (g_variant_iter_loop (&iter, "{&sv}", &name, &value))
+    {
+      const FuzzyIndexItem *items;
+      gsize n = 0;
+      gsize j;
+
+      if (!g_variant_is_of_type (value, (const GVariantType *)"a(uu)"))
+        {
+          FAIL ("row '%s' has type %s", name, g_variant_get_type_string (value));
+          continue;
+        }
+
+      items = g_variant_get_fixed_array (value, &n, sizeof (FuzzyIndexItem));
+      n_items += n;
+
+      for (j = 0; j < n; j++)
+        {
+          if (items [j].lookaside_id >= n_entries)
+            FAIL ("row '%s' %"G_GSIZE_FORMAT": lookaside %u out of range",
+                  name, j, items [j].lookaside_id);
+          else if (entries [items [j].lookaside_id].key_id < n_keys &&
+                   items [j].position >= key_lengths [entries [items [j].lookaside_id].key_id])
+            FAIL ("row '%s' %"G_GSIZE_FORMAT": position %u past the end of the key",
+                  name, j, items [j].position);
+
+          if (j > 0 &&
+              (items [j - 1].lookaside_id > items [j].lookaside_id ||
+               (items [j - 1].lookaside_id == items [j].lookaside_id &&
+                items [j - 1].position >= items [j].position)))
+            FAIL ("row '%s' %"G_GSIZE_FORMAT": out of order", name, j);
+        }
+    }
+
+  if (n_items != expected_items)
+    FAIL ("tables contain %"G_GUINT64_FORMAT" entries, expected %"G_GUINT64_FORMAT,
+          n_items, expected_items);
+
+#undef FAIL
+
+  if (errors > 0)
+    {
+      g_printerr ("%s: %u errors\n", argv[0], errors);
+      return EXIT_FAILURE;
+    }
+
+  g_print ("%s: OK (%"G_GSIZE_FORMAT" keys, %"G_GSIZE_FORMAT" documents)\n",
+           argv[0], n_keys, n_documents);
+
+  return EXIT_SUCCESS;
+}
+
+static void
+bench_query_cb (GObject      *object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  BenchState *state = user_data;
+
+  state->results = fuzzy_index_query_finish (FUZZY_INDEX (object), result, &state->error);
+  g_main_loop_quit (state->main_loop);
+}
+
+static gint
+command_bench (gint    argc,
+               gchar **argv)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GMainLoop) main_loop = NULL;
+  g_autoptr(GArray) timings = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  gdouble total = 0.0;
+  guint max_matches = 25;
+  guint iterations = 1;
+  guint n_results = 0;
+  guint i;
+  guint j;
+
+  if (argc < 2 || argc > 4)
+    return -1;
+
+  if (argc > 2)
+    max_matches = MAX (1, g_ascii_strtoull (argv[2], NULL, 10));
+
+  if (argc > 3)
+    iterations = MAX (1, g_ascii_strtoull (argv[3], NULL, 10));
+
+  if (NULL == (index = load_index (argv[0])))
+    return EXIT_FAILURE;
+
+  if (!g_file_get_contents (argv[1], &contents, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  lines = g_strsplit (contents, "\n", 0);
+  main_loop = g_main_loop_new (NULL, FALSE);
+  timings = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+  for (i = 0; i < iterations; i++)
+    {
+      for (j = 0; lines [j] != NULL; j++)
+        {
+          BenchState state = { main_loop };
+          const gchar *query = g_strstrip (lines [j]);
+          gint64 begin;
+          gdouble msec;
+
+          if (*query == '\0' || *query == '#')
+            continue;
+
+          begin = g_get_monotonic_time ();
+          fuzzy_index_query_async (index, query, max_matches, NULL, bench_query_cb, &state);
+          g_main_loop_run (main_loop);
+          msec = (g_get_monotonic_time () - begin) / 1000.0;
+
+          if (state.error != NULL)
+            {
+              g_printerr ("%s: %s\n", query, state.error->message);
+              g_clear_error (&state.error);
+              continue;
+            }
+
+          n_results += g_list_model_get_n_items (state.results);
+          g_clear_object (&state.results);
+
+          g_array_append_val (timings, msec);
+          total += msec;
+        }
+    }
+
+  if (timings->len == 0)
+    {
+      g_printerr ("No queries found in %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+
+  g_array_sort (timings, compare_double);
+
+  g_print ("%u queries, %.1lf results per query\n",
+           timings->len, (gdouble)n_results / timings->len);
+  g_print ("min %.3lf  p50 %.3lf  p90 %.3lf  p99 %.3lf  max %.3lf  mean %.3lf (msec)\n",
+           g_array_index (timings, gdouble, 0),
+           percentile ((gdouble *)(gpointer)timings->data, timings->len, 50),
+           percentile ((gdouble *)(gpointer)timings->data, timings->len, 90),
+           percentile ((gdouble *)(gpointer)timings->data, timings->len, 99),
+           g_array_index (timings, gdouble, timings->len - 1),
+           total / timings->len);
+
+  return EXIT_SUCCESS;
+}
+
+static const Command commands[] = {
+  { "stats",  "INDEX",                            command_stats },
+  { "dump",   "INDEX",                            command_dump },
+  { "verify", "INDEX",                            command_verify },
+  { "bench",  "INDEX QUERIES [MAX [ITERATIONS]]", command_bench },
+  { "merge",  "OUTPUT INPUT INPUT...",            command_merge },
+};
+
+static void
+print_usage (const gchar *prgname)
+{
+  guint i;
+
+  g_printerr ("usage:\n");
+
+  for (i = 0; i < G_N_ELEMENTS (commands); i++)
+    g_printerr ("  %s %s %s\n", prgname, commands[i].name, commands[i].usage);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  guint i;
+
+  if (argc < 2)
+    {
+      print_usage (argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (commands); i++)
+    {
+      if (g_strcmp0 (commands[i].name, argv[1]) == 0)
+        {
+          gint ret = commands[i].func (argc - 2, argv + 2);
+
+          if (ret < 0)
+            {
+              g_printerr ("usage: %s %s %s\n", argv[0], commands[i].name, commands[i].usage);
+              return EXIT_FAILURE;
+            }
+
+          return ret;
+        }
+    }
+
+  g_printerr ("Unknown command \"%s\"\n", argv[1]);
+  print_usage (argv[0]);
+
+  return EXIT_FAILURE;
+}
@@ -18,16 +18,16 @@
 
 #define G_LOG_DOMAIN "fuzzy-index"
 
+#include <string.h>
+#ifdef G_OS_UNIX
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
 #include "fuzzy-index.h"
 #include "fuzzy-index-cursor.h"
 #include "fuzzy-index-private.h"
 
-typedef struct
-{
-  guint key_id;
-  guint document_id;
-} LookasideEntry;
-
 struct _FuzzyIndex
 {
   GObject       object;
@@ -37,6 +37,14 @@ struct _FuzzyIndex
 
   GMappedFile  *mapped_file;
 
+  /*
+   * The header of the file the index was loaded from, within
+   * @mapped_file or the bytes given to fuzzy_index_load_bytes(), so that
+   * _fuzzy_index_verify() can check the payload against its checksum.
+   * This is %NULL for indexes that were never written.
+   */
+  const FuzzyIndexHeader *header;
+
   /*
    * Toplevel variant for the whole document. This is loaded from the entire
    * contents of @mapped_file. It contains a dictionary of "a{sv}"
@@ -60,9 +68,10 @@ struct _FuzzyIndex
   /*
    * The lookaside array is used to disambiguate between multiple keys
    * pointing to the same document. Each element in the array is of type
-   * "(uu)" with the first field being the "key_id" and the second field
+   * "(uuu)" with the first field being the "key_id" and the second field
    * being the "document_id". Each of these are indexes into the
-   * corresponding @documents and @keys arrays.
+   * corresponding @documents and @keys arrays. The third field is the
+   * priority the key was inserted with.
    *
    * This is a fixed array type and therefore can have the raw data
    * accessed with g_variant_get_fixed_array() to save on lookup
@@ -76,6 +85,35 @@ struct _FuzzyIndex
   const LookasideEntry *lookaside_raw;
   gsize lookaside_len;
 
+  /*
+   * The "sorted" array contains every lookaside_id ordered by the
+   * (casefolded when case-insensitive) key. The cursor uses this to
+   * binary search for exact and prefix matches. Indexes written by older
+   * builders do not contain it, in which case this is %NULL.
+   */
+  GVariant *sorted;
+  const guint *sorted_raw;
+  gsize sorted_len;
+
+  /*
+   * The "ranks" array contains the static rank of each document, indexed
+   * by document_id, which the cursor adds to the score of each match.
+   * This is optional and %NULL when no document was given a rank.
+   */
+  GVariant *ranks;
+  const gdouble *ranks_raw;
+  gsize ranks_len;
+  gdouble max_rank;
+
+  /*
+   * The "deletions" array is the deletion neighbourhood of the keys,
+   * which the cursor searches to correct a single typo in the query.
+   * This is %NULL for indexes written without it.
+   */
+  GVariant *deletions;
+  const DeletionEntry *deletions_raw;
+  gsize deletions_len;
+
   /*
    * This vardict is used to get the fixed array containing the
    * (offset, lookaside_id) for each unicode character in the index.
@@ -85,6 +123,12 @@ struct _FuzzyIndex
    */
   GVariantDict *tables;
 
+  /*
+   * The "tables" field as a variant, which unlike @tables can be iterated.
+   * This is used to prefetch the character tables when warming up.
+   */
+  GVariant *tables_variant;
+
   /*
    * The metadata located within the search index. This contains
    * metadata set with fuzzy_index_builder_set_metadata() or one
@@ -105,7 +149,11 @@ fuzzy_index_finalize (GObject *object)
   g_clear_pointer (&self->documents, g_variant_unref);
   g_clear_pointer (&self->keys, g_variant_unref);
   g_clear_pointer (&self->tables, g_variant_dict_unref);
+  g_clear_pointer (&self->tables_variant, g_variant_unref);
   g_clear_pointer (&self->lookaside, g_variant_unref);
+  g_clear_pointer (&self->sorted, g_variant_unref);
+  g_clear_pointer (&self->ranks, g_variant_unref);
+  g_clear_pointer (&self->deletions, g_variant_unref);
 
   G_OBJECT_CLASS (fuzzy_index_parent_class)->finalize (object);
 }
@@ -129,6 +177,204 @@ fuzzy_index_new (void)
   return g_object_new (FUZZY_TYPE_INDEX, NULL);
 }
 
+/*
+ * Checks the header of an index file. The payload is not read here, so
+ * that loading an index does not fault in every page of it. GVariant
+ * checks each value of the (untrusted) payload as it is accessed, and
+ * _fuzzy_index_verify() checks the payload against the checksum for
+ * those that read all of it anyway.
+ *
+ * Returns: A pointer to the payload, or %NULL and @error is set.
+ */
+static gconstpointer
+fuzzy_index_validate_header (const gchar  *contents,
+                             gsize         length,
+                             gsize        *payload_length,
+                             GError      **error)
+{
+  const FuzzyIndexHeader *header;
+  guint64 declared;
+
+  g_assert (payload_length != NULL);
+
+  if (contents == NULL || length < sizeof *header)
+    goto invalid;
+
+  header = (const FuzzyIndexHeader *)(gconstpointer)contents;
+  declared = GUINT64_FROM_LE (header->payload_length);
+
+  if (memcmp (header->magic, FUZZY_INDEX_MAGIC, FUZZY_INDEX_MAGIC_LEN) != 0)
+    goto invalid;
+
+  if (GUINT32_FROM_LE (header->version) != FUZZY_INDEX_VERSION)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Version mismatch in index header. Got %u, expected %d",
+                   GUINT32_FROM_LE (header->version), FUZZY_INDEX_VERSION);
+      return NULL;
+    }
+
+  if (declared != length - sizeof *header)
+    goto invalid;
+
+  *payload_length = declared;
+
+  return contents + sizeof *header;
+
+invalid:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "Not a valid index file");
+  return NULL;
+}
+
+/**
+ * _fuzzy_index_verify:
+ * @self: A #FuzzyIndex
+ * @error: A location for a #GError, or %NULL
+ *
+ * Verifies the checksum of the whole payload of the file @self was
+ * loaded from. This reads every page of it, so it is only worth it for
+ * tools which are about to read all of the index anyway.
+ *
+ * Returns: %TRUE if the payload is intact, or the index was never written.
+ */
+gboolean
+_fuzzy_index_verify (FuzzyIndex  *self,
+                     GError     **error)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  guint8 digest [FUZZY_INDEX_CHECKSUM_LEN];
+  gsize digest_len = sizeof digest;
+
+  g_assert (FUZZY_IS_INDEX (self));
+
+  if (self->header == NULL)
+    return TRUE;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum,
+                     (const guchar *)(self->header + 1),
+                     GUINT64_FROM_LE (self->header->payload_length));
+  g_checksum_get_digest (checksum, digest, &digest_len);
+
+  if (memcmp (digest, self->header->checksum, sizeof digest) != 0)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "Checksum mismatch in index, the file is corrupt");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Sets up the index from the toplevel vardict of an index, which was
+ * either just built or mapped from an index file.
+ */
+static gboolean
+fuzzy_index_load_variant (FuzzyIndex  *self,
+                          GVariant    *variant,
+                          GError     **error)
+{
+  g_autoptr(GVariant) documents = NULL;
+  g_autoptr(GVariant) lookaside = NULL;
+  g_autoptr(GVariant) keys = NULL;
+  g_autoptr(GVariant) tables = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  g_autoptr(GVariant) sorted = NULL;
+  g_autoptr(GVariant) ranks = NULL;
+  g_autoptr(GVariant) deletions = NULL;
+  GVariantDict dict;
+  gint version = 0;
+  gboolean case_sensitive = FALSE;
+  gsize i;
+
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (variant != NULL);
+
+  g_variant_dict_init (&dict, variant);
+
+  if (!g_variant_dict_lookup (&dict, "version", "i", &version) || version != FUZZY_INDEX_VERSION)
+    {
+      g_variant_dict_clear (&dict);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Version mismatch in gvariant. Got %d, expected %d",
+                   version, FUZZY_INDEX_VERSION);
+      return FALSE;
+    }
+
+  documents = g_variant_dict_lookup_value (&dict, "documents", G_VARIANT_TYPE_ARRAY);
+  keys = g_variant_dict_lookup_value (&dict, "keys", G_VARIANT_TYPE_STRING_ARRAY);
+  lookaside = g_variant_dict_lookup_value (&dict, "lookaside", (const GVariantType *)"a(uuu)");
+  tables = g_variant_dict_lookup_value (&dict, "tables", G_VARIANT_TYPE_VARDICT);
+  metadata = g_variant_dict_lookup_value (&dict, "metadata", G_VARIANT_TYPE_VARDICT);
+  sorted = g_variant_dict_lookup_value (&dict, "sorted", (const GVariantType *)"au");
+  ranks = g_variant_dict_lookup_value (&dict, "ranks", (const GVariantType *)"ad");
+  deletions = g_variant_dict_lookup_value (&dict, "deletions", (const GVariantType *)"a(uu)");
+  g_variant_dict_clear (&dict);
+
+  if (keys == NULL || documents == NULL || lookaside == NULL || tables == NULL || metadata == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Invalid gvariant index");
+      return FALSE;
+    }
+
+  self->variant = g_variant_ref_sink (variant);
+  self->documents = g_steal_pointer (&documents);
+  self->lookaside = g_steal_pointer (&lookaside);
+  self->keys = g_steal_pointer (&keys);
+  self->tables = g_variant_dict_new (tables);
+  self->tables_variant = g_steal_pointer (&tables);
+  self->metadata = g_variant_dict_new (metadata);
+
+  self->lookaside_raw = g_variant_get_fixed_array (self->lookaside,
+                                                   &self->lookaside_len,
+                                                   sizeof (LookasideEntry));
+
+  if (sorted != NULL)
+    {
+      self->sorted = g_steal_pointer (&sorted);
+      self->sorted_raw = g_variant_get_fixed_array (self->sorted,
+                                                    &self->sorted_len,
+                                                    sizeof (guint));
+    }
+
+  if (ranks != NULL)
+    {
+      self->ranks = g_steal_pointer (&ranks);
+      self->ranks_raw = g_variant_get_fixed_array (self->ranks,
+                                                   &self->ranks_len,
+                                                   sizeof (gdouble));
+
+      for (i = 0; i < self->ranks_len; i++)
+        self->max_rank = MAX (self->max_rank, self->ranks_raw [i]);
+    }
+
+  if (deletions != NULL)
+    {
+      self->deletions = g_steal_pointer (&deletions);
+      self->deletions_raw = g_variant_get_fixed_array (self->deletions,
+                                                       &self->deletions_len,
+                                                       sizeof (DeletionEntry));
+    }
+
+  if (g_variant_dict_lookup (self->metadata, "case-sensitive", "b", &case_sensitive))
+    self->case_sensitive = !!case_sensitive;
+
+  return TRUE;
+}
+
 static void
 fuzzy_index_load_file_worker (GTask        *task,
                               gpointer      source_object,
@@ -138,17 +384,11 @@ fuzzy_index_load_file_worker (GTask        *task,
   g_autofree gchar *path = NULL;
   g_autoptr(GMappedFile) mapped_file = NULL;
   g_autoptr(GVariant) variant = NULL;
-  g_autoptr(GVariant) documents = NULL;
-  g_autoptr(GVariant) lookaside = NULL;
-  g_autoptr(GVariant) keys = NULL;
-  g_autoptr(GVariant) tables = NULL;
-  g_autoptr(GVariant) metadata = NULL;
   FuzzyIndex *self = source_object;
+  gconstpointer payload;
+  gsize payload_length = 0;
   GFile *file = task_data;
-  GVariantDict dict;
   GError *error = NULL;
-  gint version = 0;
-  gboolean case_sensitive = FALSE;
 
   g_assert (FUZZY_IS_INDEX (self));
   g_assert (G_IS_FILE (file));
@@ -180,65 +420,33 @@ fuzzy_index_load_file_worker (GTask        *task,
       return;
     }
 
-  variant = g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
-                                     g_mapped_file_get_contents (mapped_file),
-                                     g_mapped_file_get_length (mapped_file),
-                                     FALSE, NULL, NULL);
-
-  if (variant == NULL)
-    {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVAL,
-                               "Failed to parse GVariant");
-      return;
-    }
-
-  g_variant_ref_sink (variant);
-
-  g_variant_dict_init (&dict, variant);
-
-  if (!g_variant_dict_lookup (&dict, "version", "i", &version) || version != 1)
+  if (NULL == (payload = fuzzy_index_validate_header (g_mapped_file_get_contents (mapped_file),
+                                                      g_mapped_file_get_length (mapped_file),
+                                                      &payload_length,
+                                                      &error)))
     {
-      g_variant_dict_clear (&dict);
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVAL,
-                               "Version mismatch in gvariant. Got %d, expected 1",
-                               version);
+      g_task_return_error (task, error);
       return;
     }
 
-  documents = g_variant_dict_lookup_value (&dict, "documents", G_VARIANT_TYPE_ARRAY);
-  keys = g_variant_dict_lookup_value (&dict, "keys", G_VARIANT_TYPE_STRING_ARRAY);
-  lookaside = g_variant_dict_lookup_value (&dict, "lookaside", G_VARIANT_TYPE_ARRAY);
-  tables = g_variant_dict_lookup_value (&dict, "tables", G_VARIANT_TYPE_VARDICT);
-  metadata = g_variant_dict_lookup_value (&dict, "metadata", G_VARIANT_TYPE_VARDICT);
-  g_variant_dict_clear (&dict);
+  /*
+   * The payload is not trusted, so GVariant checks what we access as we go
+   * rather than all of it up front. The tables we read most are fixed
+   * arrays which are accessed through raw pointers after that.
+   */
+  variant = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
+                                                         payload,
+                                                         payload_length,
+                                                         FALSE, NULL, NULL));
 
-  if (keys == NULL || documents == NULL || tables == NULL || metadata == NULL)
+  if (!fuzzy_index_load_variant (self, variant, &error))
     {
-      g_task_return_new_error (task,
-                               G_IO_ERROR,
-                               G_IO_ERROR_INVAL,
-                               "Invalid gvariant index");
+      g_task_return_error (task, error);
       return;
     }
 
   self->mapped_file = g_steal_pointer (&mapped_file);
-  self->variant = g_steal_pointer (&variant);
-  self->documents = g_steal_pointer (&documents);
-  self->lookaside = g_steal_pointer (&lookaside);
-  self->keys = g_steal_pointer (&keys);
-  self->tables = g_variant_dict_new (tables);
-  self->metadata = g_variant_dict_new (metadata);
-
-  self->lookaside_raw = g_variant_get_fixed_array (self->lookaside,
-                                                   &self->lookaside_len,
-                                                   sizeof (LookasideEntry));
-
-  if (g_variant_dict_lookup (self->metadata, "case-sensitive", "b", &case_sensitive))
-    self->case_sensitive = !!case_sensitive;
+  self->header = (gconstpointer)g_mapped_file_get_contents (self->mapped_file);
 
   g_task_return_boolean (task, TRUE);
 }
@@ -296,6 +504,219 @@ fuzzy_index_load_file (FuzzyIndex    *self,
   return g_task_propagate_boolean (task, error);
 }
 
+/**
+ * fuzzy_index_load_bytes:
+ * @self: A #FuzzyIndex
+ * @bytes: The contents of an index file
+ * @error: A location for a #GError, or %NULL
+ *
+ * Loads the index from @bytes, which contains an index as written by
+ * fuzzy_index_builder_write(). This is useful when the index is not
+ * available as a local file, such as when it is stored in a #GResource.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+fuzzy_index_load_bytes (FuzzyIndex  *self,
+                        GBytes      *bytes,
+                        GError     **error)
+{
+  g_autoptr(GBytes) payload_bytes = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  gconstpointer contents;
+  gconstpointer payload;
+  gsize payload_length = 0;
+  gsize length = 0;
+
+  g_return_val_if_fail (FUZZY_IS_INDEX (self), FALSE);
+  g_return_val_if_fail (bytes != NULL, FALSE);
+
+  if (self->loaded)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Cannot load index multiple times");
+      return FALSE;
+    }
+
+  self->loaded = TRUE;
+
+  contents = g_bytes_get_data (bytes, &length);
+
+  if (NULL == (payload = fuzzy_index_validate_header (contents, length, &payload_length, error)))
+    return FALSE;
+
+  payload_bytes = g_bytes_new_from_bytes (bytes,
+                                          (const gchar *)payload - (const gchar *)contents,
+                                          payload_length);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT,
+                                                          payload_bytes,
+                                                          FALSE));
+
+  if (!fuzzy_index_load_variant (self, variant, error))
+    return FALSE;
+
+  /* @variant keeps @bytes, and with them the header, alive */
+  self->header = contents;
+
+  return TRUE;
+}
+
+/*
+ * Loads the index from a variant that was just built by a
+ * #FuzzyIndexBuilder, without it ever being written to disk.
+ */
+gboolean
+_fuzzy_index_load_built (FuzzyIndex  *self,
+                         GVariant    *variant,
+                         GError     **error)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (variant != NULL);
+  g_assert (!self->loaded);
+
+  self->loaded = TRUE;
+
+  return fuzzy_index_load_variant (self, variant, error);
+}
+
+/*
+ * Writes @variant to @file, preceded by a FuzzyIndexHeader containing
+ * the checksum of the serialized variant.
+ */
+gboolean
+_fuzzy_index_write_variant (GFile         *file,
+                            GVariant      *variant,
+                            GCancellable  *cancellable,
+                            GError       **error)
+{
+  g_autoptr(GFileOutputStream) stream = NULL;
+  g_autoptr(GChecksum) checksum = NULL;
+  FuzzyIndexHeader header = { { 0 } };
+  gconstpointer data;
+  gsize checksum_len = sizeof header.checksum;
+  gsize size;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (variant != NULL);
+
+  data = g_variant_get_data (variant);
+  size = g_variant_get_size (variant);
+
+  memcpy (header.magic, FUZZY_INDEX_MAGIC, FUZZY_INDEX_MAGIC_LEN);
+  header.version = GUINT32_TO_LE (FUZZY_INDEX_VERSION);
+  header.flags = 0;
+  header.payload_length = GUINT64_TO_LE (size);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, data, size);
+  g_checksum_get_digest (checksum, header.checksum, &checksum_len);
+
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, error);
+
+  if (stream == NULL)
+    return FALSE;
+
+  return g_output_stream_write_all (G_OUTPUT_STREAM (stream), &header, sizeof header, NULL, cancellable, error) &&
+         g_output_stream_write_all (G_OUTPUT_STREAM (stream), data, size, NULL, cancellable, error) &&
+         g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, error);
+}
+
+static void
+fuzzy_index_write_worker (GTask        *task,
+                          gpointer      source_object,
+                          gpointer      task_data,
+                          GCancellable *cancellable)
+{
+  FuzzyIndex *self = source_object;
+  GFile *file = task_data;
+  GError *error = NULL;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (G_IS_FILE (file));
+
+  if (self->variant == NULL)
+    g_task_return_new_error (task,
+                             G_IO_ERROR,
+                             G_IO_ERROR_NOT_INITIALIZED,
+                             "The index has not been loaded");
+  else if (!_fuzzy_index_write_variant (file, self->variant, cancellable, &error))
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * fuzzy_index_write_async:
+ * @self: A #FuzzyIndex
+ * @file: A #GFile to write the index to
+ * @io_priority: The priority for IO operations
+ * @cancellable: (nullable): An optional #GCancellable or %NULL
+ * @callback: A callback for completion or %NULL
+ * @user_data: User data for @callback
+ *
+ * Writes a loaded index to @file so that it can later be loaded with
+ * fuzzy_index_load_file(). This allows an index created with
+ * fuzzy_index_builder_build_index() to be queried right away, while it
+ * is saved in the background.
+ */
+void
+fuzzy_index_write_async (FuzzyIndex          *self,
+                         GFile               *file,
+                         gint                 io_priority,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (FUZZY_IS_INDEX (self));
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fuzzy_index_write_async);
+  g_task_set_priority (task, io_priority);
+  g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+  g_task_run_in_thread (task, fuzzy_index_write_worker);
+}
+
+gboolean
+fuzzy_index_write_finish (FuzzyIndex    *self,
+                          GAsyncResult  *result,
+                          GError       **error)
+{
+  g_return_val_if_fail (FUZZY_IS_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+gboolean
+fuzzy_index_write (FuzzyIndex    *self,
+                   GFile         *file,
+                   gint           io_priority,
+                   GCancellable  *cancellable,
+                   GError       **error)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_val_if_fail (FUZZY_IS_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  task = g_task_new (self, cancellable, NULL, NULL);
+  g_task_set_source_tag (task, fuzzy_index_write);
+  g_task_set_priority (task, io_priority);
+  g_task_set_task_data (task, g_object_ref (file), g_object_unref);
+
+  fuzzy_index_write_worker (task, self, file, cancellable);
+
+  return g_task_propagate_boolean (task, error);
+}
+
 static void
 fuzzy_index_query_cb (GObject      *object,
                       GAsyncResult *result,
@@ -315,26 +736,28 @@ fuzzy_index_query_cb (GObject      *object,
     g_task_return_pointer (task, g_object_ref (cursor), g_object_unref);
 }
 
-void
-fuzzy_index_query_async (FuzzyIndex          *self,
-                         const gchar         *query,
-                         guint                max_matches,
-                         GCancellable        *cancellable,
-                         GAsyncReadyCallback  callback,
-                         gpointer             user_data)
+static FuzzyIndexCursor *
+fuzzy_index_query_internal (FuzzyIndex          *self,
+                            const gchar         *query,
+                            guint                max_matches,
+                            gboolean             incremental,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
 {
   g_autoptr(GTask) task = NULL;
-  g_autoptr(FuzzyIndexCursor) cursor = NULL;
+  FuzzyIndexCursor *cursor;
 
-  g_return_if_fail (FUZZY_IS_INDEX (self));
-  g_return_if_fail (query != NULL);
-  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (query != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_source_tag (task, fuzzy_index_query_async);
 
   cursor = g_object_new (FUZZY_TYPE_INDEX_CURSOR,
                          "case-sensitive", self->case_sensitive,
+                         "incremental", incremental,
                          "index", self,
                          "query", query,
                          "max-matches", max_matches,
@@ -346,6 +769,62 @@ fuzzy_index_query_async (FuzzyIndex          *self,
                                cancellable,
                                fuzzy_index_query_cb,
                                g_object_ref (task));
+
+  return cursor;
+}
+
+void
+fuzzy_index_query_async (FuzzyIndex          *self,
+                         const gchar         *query,
+                         guint                max_matches,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_return_if_fail (FUZZY_IS_INDEX (self));
+  g_return_if_fail (query != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  /* The cursor is kept alive by the query until it completes */
+  g_object_unref (fuzzy_index_query_internal (self, query, max_matches, FALSE,
+                                              cancellable, callback, user_data));
+}
+
+/**
+ * fuzzy_index_query_begin:
+ * @self: A #FuzzyIndex
+ * @query: The query to search for
+ * @max_matches: The max number of matches, or 0 for unlimited
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute once the query has completed
+ * @user_data: User data for @callback
+ *
+ * This is like fuzzy_index_query_async() except that the #GListModel of
+ * results is returned immediately, while the query is running.
+ *
+ * Provisional results, such as exact and prefix matches, are published
+ * to the model as they are found using #GListModel::items-changed, so
+ * that they can be displayed before the query has completed. The model
+ * contains the final results once @callback is executed, which should
+ * call fuzzy_index_query_finish() to complete the request.
+ *
+ * Returns: (transfer full): A #GListModel that is updated as the query
+ *   progresses.
+ */
+GListModel *
+fuzzy_index_query_begin (FuzzyIndex          *self,
+                         const gchar         *query,
+                         guint                max_matches,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_return_val_if_fail (FUZZY_IS_INDEX (self), NULL);
+  g_return_val_if_fail (query != NULL, NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
+
+  return G_LIST_MODEL (fuzzy_index_query_internal (self, query, max_matches, TRUE,
+                                                   cancellable, callback, user_data));
 }
 
 /**
@@ -452,14 +931,30 @@ _fuzzy_index_lookup_document (FuzzyIndex *self,
 {
   g_assert (FUZZY_IS_INDEX (self));
 
+  if G_UNLIKELY (document_id >= g_variant_n_children (self->documents))
+    return NULL;
+
   return g_variant_get_child_value (self->documents, document_id);
 }
 
+/*
+ * Gets the toplevel vardict of the index, so that tools like the merger
+ * can walk the tables directly. The index must be loaded.
+ */
+GVariant *
+_fuzzy_index_get_variant (FuzzyIndex *self)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+
+  return self->variant;
+}
+
 gboolean
 _fuzzy_index_resolve (FuzzyIndex   *self,
                       guint         lookaside_id,
                       guint        *document_id,
-                      const gchar **key)
+                      const gchar **key,
+                      guint        *priority)
 {
   const LookasideEntry *entry;
 
@@ -473,6 +968,9 @@ _fuzzy_index_resolve (FuzzyIndex   *self,
 
   *document_id = entry->document_id;
 
+  if (priority != NULL)
+    *priority = entry->priority;
+
   if (key != NULL)
     {
       if G_UNLIKELY (entry->key_id >= g_variant_n_children (self->keys))
@@ -483,3 +981,301 @@ _fuzzy_index_resolve (FuzzyIndex   *self,
 
   return TRUE;
 }
+
+/**
+ * _fuzzy_index_get_sorted:
+ * @self: A #FuzzyIndex
+ * @n_sorted: (out): A location for the number of elements
+ *
+ * Gets the array of lookaside identifiers sorted by key. Keys are
+ * casefolded before sorting unless the index is case-sensitive.
+ *
+ * Returns: (transfer none) (nullable): The sorted lookaside ids, or %NULL
+ *   if the index was written without them.
+ */
+const guint *
+_fuzzy_index_get_sorted (FuzzyIndex *self,
+                         gsize      *n_sorted)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (n_sorted != NULL);
+
+  *n_sorted = self->sorted_len;
+
+  return self->sorted_raw;
+}
+
+/**
+ * _fuzzy_index_get_deletions:
+ * @self: A #FuzzyIndex
+ * @n_deletions: (out): A location for the number of elements
+ *
+ * Gets the deletion neighbourhood of the keys, sorted by each key with
+ * the character at #DeletionEntry.offset removed.
+ *
+ * Returns: (transfer none) (nullable): The deletions, or %NULL if the
+ *   index was written without them.
+ */
+const DeletionEntry *
+_fuzzy_index_get_deletions (FuzzyIndex *self,
+                            gsize      *n_deletions)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+  g_assert (n_deletions != NULL);
+
+  *n_deletions = self->deletions_len;
+
+  return self->deletions_raw;
+}
+
+/**
+ * _fuzzy_index_get_rank:
+ * @self: A #FuzzyIndex
+ * @document_id: The identifier of the document
+ *
+ * Gets the static rank that was set for @document_id with
+ * fuzzy_index_builder_set_document_rank().
+ *
+ * Returns: The rank of the document, or 0.0 if it has none.
+ */
+gdouble
+_fuzzy_index_get_rank (FuzzyIndex *self,
+                       guint       document_id)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+
+  if (document_id < self->ranks_len)
+    return self->ranks_raw [document_id];
+
+  return 0.0;
+}
+
+/**
+ * _fuzzy_index_get_max_rank:
+ * @self: A #FuzzyIndex
+ *
+ * Gets an upper bound of the static rank of every document, which the
+ * cursor uses to tell whether a match could still outscore another.
+ *
+ * Returns: The highest rank of any document, and at least 0.0.
+ */
+gdouble
+_fuzzy_index_get_max_rank (FuzzyIndex *self)
+{
+  g_assert (FUZZY_IS_INDEX (self));
+
+  return self->max_rank;
+}
+
+static gsize
+fuzzy_index_get_page_size (void)
+{
+#ifdef G_OS_UNIX
+  return sysconf (_SC_PAGESIZE);
+#else
+  return 4096;
+#endif
+}
+
+/*
+ * Hints to the kernel that the pages backing @variant will be needed
+ * soon, and then touches each of them so that they are faulted in now
+ * rather than while a query is running.
+ */
+static void
+fuzzy_index_prefetch (GVariant *variant)
+{
+  const guint8 *data;
+  guintptr begin;
+  guintptr end;
+  guintptr addr;
+  gsize page_size;
+  gsize size;
+  guint8 sum = 0;
+
+  g_assert (variant != NULL);
+
+  if (0 == (size = g_variant_get_size (variant)))
+    return;
+
+  data = g_variant_get_data (variant);
+  page_size = fuzzy_index_get_page_size ();
+  begin = (guintptr)data & ~(guintptr)(page_size - 1);
+  end = (guintptr)data + size;
+
+#ifdef G_OS_UNIX
+  madvise ((gpointer)begin, end - begin, MADV_WILLNEED);
+#endif
+
+  for (addr = begin; addr < end; addr += page_size)
+    sum += *(volatile const guint8 *)(addr < (guintptr)data ? (guintptr)data : addr);
+
+  (void)sum;
+}
+
+static gint
+compare_by_size (gconstpointer a,
+                 gconstpointer b)
+{
+  gsize size_a = g_variant_get_size (*(GVariant * const *)a);
+  gsize size_b = g_variant_get_size (*(GVariant * const *)b);
+
+  return (size_a < size_b) - (size_a > size_b);
+}
+
+static void
+fuzzy_index_warmup_worker (GTask        *task,
+                           gpointer      source_object,
+                           gpointer      task_data,
+                           GCancellable *cancellable)
+{
+  FuzzyIndex *self = source_object;
+  g_autoptr(GPtrArray) tables = NULL;
+  GVariantIter iter;
+  GVariant *value;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (FUZZY_IS_INDEX (self));
+
+  if (self->variant == NULL)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_NOT_INITIALIZED,
+                               "The index has not been loaded");
+      return;
+    }
+
+  /* Every query resolves its matches through these */
+  fuzzy_index_prefetch (self->lookaside);
+  fuzzy_index_prefetch (self->keys);
+  if (self->sorted != NULL)
+    fuzzy_index_prefetch (self->sorted);
+  if (self->ranks != NULL)
+    fuzzy_index_prefetch (self->ranks);
+
+  /*
+   * The largest character tables belong to the characters found in the
+   * most keys, which are also the ones most queries will walk. Fault
+   * those in first so that cancelling early still helps.
+   */
+  tables = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+  g_variant_iter_init (&iter, self->tables_variant);
+  while (g_variant_iter_next (&iter, "{&sv}", NULL, &value))
+    g_ptr_array_add (tables, value);
+
+  g_ptr_array_sort (tables, compare_by_size);
+
+  for (i = 0; i < tables->len; i++)
+    {
+      if (g_task_return_error_if_cancelled (task))
+        return;
+
+      fuzzy_index_prefetch (g_ptr_array_index (tables, i));
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * fuzzy_index_warmup_async:
+ * @self: A #FuzzyIndex
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: User data for @callback
+ *
+ * Faults in the pages of the index from a background thread, so that the
+ * first query does not have to wait for them to be read from disk. The
+ * tables used by every query are loaded first, followed by the character
+ * tables from largest to smallest.
+ *
+ * This is only useful after the index has been loaded.
+ */
+void
+fuzzy_index_warmup_async (FuzzyIndex          *self,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_return_if_fail (FUZZY_IS_INDEX (self));
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, fuzzy_index_warmup_async);
+  g_task_set_priority (task, G_PRIORITY_LOW);
+  g_task_run_in_thread (task, fuzzy_index_warmup_worker);
+}
+
+gboolean
+fuzzy_index_warmup_finish (FuzzyIndex    *self,
+                           GAsyncResult  *result,
+                           GError       **error)
+{
+  g_return_val_if_fail (FUZZY_IS_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_TASK (result), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * fuzzy_index_get_residency:
+ * @self: A #FuzzyIndex
+ * @resident_bytes: (out) (optional): A location for the resident size
+ * @mapped_bytes: (out) (optional): A location for the mapped size
+ *
+ * Gets how much of the mapped index is currently in memory, which can be
+ * used to tell whether the first query will need to wait on disk.
+ *
+ * If the residency cannot be determined on this platform, the whole
+ * mapping is reported as resident.
+ */
+void
+fuzzy_index_get_residency (FuzzyIndex *self,
+                           gsize      *resident_bytes,
+                           gsize      *mapped_bytes)
+{
+  gsize resident = 0;
+  gsize mapped = 0;
+
+  g_return_if_fail (FUZZY_IS_INDEX (self));
+
+  if (self->mapped_file != NULL)
+    {
+      mapped = resident = g_mapped_file_get_length (self->mapped_file);
+
+#ifdef G_OS_UNIX
+      if (mapped > 0)
+        {
+          gpointer contents = g_mapped_file_get_contents (self->mapped_file);
+          gsize page_size = fuzzy_index_get_page_size ();
+          gsize n_pages = (mapped + page_size - 1) / page_size;
+          g_autofree guchar *vec = g_malloc (n_pages);
+
+          if (mincore (contents, mapped, (gpointer)vec) == 0)
+            {
+              gsize i;
+
+              resident = 0;
+
+              for (i = 0; i < n_pages; i++)
+                {
+                  if (vec [i] & 1)
+                    resident += page_size;
+                }
+
+              resident = MIN (resident, mapped);
+            }
+        }
+#endif
+    }
+
+  if (resident_bytes != NULL)
+    *resident_bytes = resident;
+
+  if (mapped_bytes != NULL)
+    *mapped_bytes = mapped;
+}
@@ -40,15 +40,48 @@ void         fuzzy_index_load_file_async     (FuzzyIndex           *self,
 gboolean     fuzzy_index_load_file_finish    (FuzzyIndex           *self,
                                               GAsyncResult         *result,
                                               GError              **error);
+gboolean     fuzzy_index_load_bytes          (FuzzyIndex           *self,
+                                              GBytes               *bytes,
+                                              GError              **error);
+gboolean     fuzzy_index_write               (FuzzyIndex           *self,
+                                              GFile                *file,
+                                              gint                  io_priority,
+                                              GCancellable         *cancellable,
+                                              GError              **error);
+void         fuzzy_index_write_async         (FuzzyIndex           *self,
+                                              GFile                *file,
+                                              gint                  io_priority,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
+gboolean     fuzzy_index_write_finish        (FuzzyIndex           *self,
+                                              GAsyncResult         *result,
+                                              GError              **error);
 void         fuzzy_index_query_async         (FuzzyIndex           *self,
                                               const gchar          *query,
                                               guint                 max_matches,
                                               GCancellable         *cancellable,
                                               GAsyncReadyCallback   callback,
                                               gpointer              user_data);
+GListModel  *fuzzy_index_query_begin         (FuzzyIndex           *self,
+                                              const gchar          *query,
+                                              guint                 max_matches,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
 GListModel  *fuzzy_index_query_finish        (FuzzyIndex           *self,
                                               GAsyncResult         *result,
                                               GError              **error);
+void         fuzzy_index_warmup_async        (FuzzyIndex           *self,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
+gboolean     fuzzy_index_warmup_finish       (FuzzyIndex           *self,
+                                              GAsyncResult         *result,
+                                              GError              **error);
+void         fuzzy_index_get_residency       (FuzzyIndex           *self,
+                                              gsize                *resident_bytes,
+                                              gsize                *mapped_bytes);
 GVariant    *fuzzy_index_get_metadata        (FuzzyIndex           *self,
                                               const gchar          *key);
 guint32      fuzzy_index_get_metadata_uint32 (FuzzyIndex           *self,
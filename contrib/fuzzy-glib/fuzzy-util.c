@@ -41,3 +41,50 @@ fuzzy_g_variant_hash (gconstpointer data)
 
   return ret;
 }
+
+/**
+ * fuzzy_deletion_compare:
+ * @a: A UTF-8 encoded string
+ * @a_skip: The byte offset of a character to leave out of @a, or -1
+ * @b: A UTF-8 encoded string
+ * @b_skip: The byte offset of a character to leave out of @b, or -1
+ * @n: The maximum number of bytes to compare
+ *
+ * Compares at most @n bytes of @a and @b like strncmp(), as if the
+ * character at @a_skip had been removed from @a and the one at @b_skip
+ * from @b. This allows comparing the deletion neighbourhood of a string
+ * without making a copy for each of its characters.
+ *
+ * Returns: less than, equal to, or greater than zero if @a is found to be
+ *   less than, to match, or be greater than @b.
+ */
+gint
+fuzzy_deletion_compare (const gchar *a,
+                        gssize       a_skip,
+                        const gchar *b,
+                        gssize       b_skip,
+                        gsize        n)
+{
+  const gchar *a_at = a_skip >= 0 ? a + a_skip : NULL;
+  const gchar *b_at = b_skip >= 0 ? b + b_skip : NULL;
+
+  g_return_val_if_fail (a != NULL, 0);
+  g_return_val_if_fail (b != NULL, 0);
+
+  for (; n > 0; n--, a++, b++)
+    {
+      if (a == a_at)
+        a = g_utf8_next_char (a);
+
+      if (b == b_at)
+        b = g_utf8_next_char (b);
+
+      if (*a != *b)
+        return (guchar)*a - (guchar)*b;
+
+      if (*a == '\0')
+        break;
+    }
+
+  return 0;
+}
@@ -23,7 +23,12 @@
 
 G_BEGIN_DECLS
 
-guint fuzzy_g_variant_hash (gconstpointer data);
+guint fuzzy_g_variant_hash    (gconstpointer  data);
+gint  fuzzy_deletion_compare  (const gchar   *a,
+                               gssize         a_skip,
+                               const gchar   *b,
+                               gssize         b_skip,
+                               gsize          n);
 
 G_END_DECLS
 
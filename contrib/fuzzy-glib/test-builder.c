@@ -16,7 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+
 #include "fuzzy-glib.h"
+#include "fuzzy-index-private.h"
 
 static GMainLoop *main_loop;
 
@@ -39,6 +42,8 @@ test_index_builder_basic (void)
 {
   FuzzyIndexBuilder *builder;
   gchar *contents = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GBytes) payload = NULL;
   g_autoptr(GVariant) variant = NULL;
   GVariantDict dict;
   GVariant *v;
@@ -55,11 +60,11 @@ test_index_builder_basic (void)
   builder = fuzzy_index_builder_new ();
   g_object_add_weak_pointer (G_OBJECT (builder), (gpointer *)&builder);
 
-  fuzzy_index_builder_insert (builder, "foo", g_variant_new_int32 (1));
-  fuzzy_index_builder_insert (builder, "FOO", g_variant_new_int32 (2));
-  fuzzy_index_builder_insert (builder, "Foo", g_variant_new_int32 (3));
-  fuzzy_index_builder_insert (builder, "bar", g_variant_new_int32 (4));
-  fuzzy_index_builder_insert (builder, "baz", g_variant_new_int32 (5));
+  fuzzy_index_builder_insert (builder, "foo", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "FOO", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "Foo", g_variant_new_int32 (3), 0);
+  fuzzy_index_builder_insert (builder, "bar", g_variant_new_int32 (4), 0);
+  fuzzy_index_builder_insert (builder, "baz", g_variant_new_int32 (5), 0);
 
   fuzzy_index_builder_write_async (builder,
                                    file,
@@ -75,12 +80,14 @@ test_index_builder_basic (void)
   g_assert_no_error (error);
   g_assert (r);
 
-  variant = g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
-                                     contents,
-                                     len,
-                                     FALSE,
-                                     g_free,
-                                     contents);
+  /* The payload follows a 64 byte header starting with the magic */
+  g_assert_cmpint (len, >, 64);
+  g_assert (memcmp (contents, "FUZZYIDX", 8) == 0);
+
+  bytes = g_bytes_new_take (contents, len);
+  payload = g_bytes_new_from_bytes (bytes, 64, len - 64);
+
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, payload, FALSE);
   g_assert (variant != NULL);
   g_variant_ref_sink (variant);
 
@@ -110,6 +117,11 @@ test_index_builder_basic (void)
   g_assert (v != NULL);
   g_variant_unref (v);
 
+  v = g_variant_dict_lookup_value (&dict, "sorted", G_VARIANT_TYPE ("au"));
+  g_assert (v != NULL);
+  g_assert_cmpint (g_variant_n_children (v), ==, 5);
+  g_variant_unref (v);
+
   g_variant_dict_clear (&dict);
 
   g_object_unref (builder);
@@ -236,13 +248,13 @@ test_index_basic (void)
    * We want to ensure we only get the highest scoring item for a
    * document (which are deduplicated in the index).
    */
-  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1));
-  fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (1));
-  fuzzy_index_builder_insert (builder, "gtk_widget_hide", g_variant_new_int32 (2));
-  fuzzy_index_builder_insert (builder, "gtk_widget_hide_all", g_variant_new_int32 (2));
-  fuzzy_index_builder_insert (builder, "gtk_widget_get_parent", g_variant_new_int32 (3));
-  fuzzy_index_builder_insert (builder, "gtk_widget_get_name", g_variant_new_int32 (4));
-  fuzzy_index_builder_insert (builder, "gtk_widget_set_name", g_variant_new_int32 (5));
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_hide", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_hide_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_get_parent", g_variant_new_int32 (3), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_get_name", g_variant_new_int32 (4), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_set_name", g_variant_new_int32 (5), 0);
 
   fuzzy_index_builder_write_async (builder,
                                    file,
@@ -265,6 +277,617 @@ test_index_basic (void)
   g_assert (file == NULL);
 }
 
+static void
+test_index_prefix_query_cb (GObject      *object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GListModel) matches = NULL;
+  g_autoptr(FuzzyIndexMatch) match = NULL;
+  GError *error = NULL;
+
+  matches = fuzzy_index_query_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (matches != NULL);
+
+  /* The exact match fills the only slot, and must be the best score */
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 1);
+  match = g_list_model_get_item (matches, 0);
+  g_assert_cmpstr (fuzzy_index_match_get_key (match), ==, "gtk_widget_show");
+  g_assert_cmpint (g_variant_get_int32 (fuzzy_index_match_get_document (match)), ==, 1);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_prefix (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-prefix.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_hide", g_variant_new_int32 (3), 0);
+  fuzzy_index_builder_insert (builder, "gtk_window_show", g_variant_new_int32 (4), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_query_async (index,
+                           "GTK_Widget_Show",
+                           1,
+                           NULL,
+                           test_index_prefix_query_cb,
+                           NULL);
+
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_typo_query_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GListModel) matches = NULL;
+  g_autoptr(FuzzyIndexMatch) match = NULL;
+  GError *error = NULL;
+
+  matches = fuzzy_index_query_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (matches != NULL);
+
+  g_assert_cmpint (g_list_model_get_n_items (matches), >=, 1);
+  match = g_list_model_get_item (matches, 0);
+  g_assert_cmpstr (fuzzy_index_match_get_key (match), ==, user_data);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_typo (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-typo.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "g_variant_new", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "g_variant_ref", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "g_value_init", g_variant_new_int32 (3), 0);
+  fuzzy_index_builder_insert (builder, "g_variant_new_fixed_array", g_variant_new_int32 (4), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  /* Swapped letters, which the in-order walk alone cannot match */
+  fuzzy_index_query_async (index,
+                           "g_varaint_new",
+                           5,
+                           NULL,
+                           test_index_typo_query_cb,
+                           (gpointer)"g_variant_new");
+
+  g_main_loop_run (main_loop);
+
+  /* Substituted letter which no key contains, so there is no table for it */
+  fuzzy_index_query_async (index,
+                           "g_variznt_new",
+                           5,
+                           NULL,
+                           test_index_typo_query_cb,
+                           (gpointer)"g_variant_new");
+
+  g_main_loop_run (main_loop);
+
+  /* Typos are found anywhere within the first FUZZY_TYPO_MAX_CHARS */
+  fuzzy_index_query_async (index,
+                           "g_variant_new_fixed_arrzy",
+                           5,
+                           NULL,
+                           test_index_typo_query_cb,
+                           (gpointer)"g_variant_new_fixed_array");
+
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_priority_query_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GListModel) matches = NULL;
+  g_autoptr(FuzzyIndexMatch) first = NULL;
+  g_autoptr(FuzzyIndexMatch) second = NULL;
+  GError *error = NULL;
+
+  matches = fuzzy_index_query_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (matches != NULL);
+
+  /* Both keys are equally good matches, so priority decides */
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 2);
+  first = g_list_model_get_item (matches, 0);
+  second = g_list_model_get_item (matches, 1);
+  g_assert_cmpstr (fuzzy_index_match_get_key (first), ==, "show_all");
+  g_assert_cmpstr (fuzzy_index_match_get_key (second), ==, "show_now");
+  g_assert_cmpfloat (fuzzy_index_match_get_score (first), >, fuzzy_index_match_get_score (second));
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_priority (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-priority.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "show_now", g_variant_new_int32 (1), 1);
+  fuzzy_index_builder_insert (builder, "show_all", g_variant_new_int32 (2), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_query_async (index,
+                           "shw",
+                           0,
+                           NULL,
+                           test_index_priority_query_cb,
+                           NULL);
+
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_rank_query_cb (GObject      *object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GListModel) matches = NULL;
+  g_autoptr(FuzzyIndexMatch) match = NULL;
+  GError *error = NULL;
+
+  matches = fuzzy_index_query_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (matches != NULL);
+
+  /* The ranked document wins the only slot over the closer match */
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 1);
+  match = g_list_model_get_item (matches, 0);
+  g_assert_cmpstr (fuzzy_index_match_get_key (match), ==, "gtk_widget_show_all");
+  g_assert_cmpfloat (fuzzy_index_match_get_score (match), >, 1.0);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_rank (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  guint64 document_id;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-rank.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  document_id = fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_set_document_rank (builder, document_id, 1.0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_query_async (index,
+                           "gtk_widget_show",
+                           1,
+                           NULL,
+                           test_index_rank_query_cb,
+                           NULL);
+
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_incremental_changed_cb (GListModel *model,
+                                   guint       position,
+                                   guint       removed,
+                                   guint       added,
+                                   gpointer    user_data)
+{
+  guint *n_changed = user_data;
+
+  g_assert (G_IS_LIST_MODEL (model));
+  g_assert_cmpint (position, ==, 0);
+  g_assert_cmpint (added, ==, g_list_model_get_n_items (model));
+
+  (*n_changed)++;
+}
+
+static void
+test_index_incremental_query_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GListModel) matches = NULL;
+  g_autoptr(FuzzyIndexMatch) match = NULL;
+  GError *error = NULL;
+
+  matches = fuzzy_index_query_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (matches != NULL);
+
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 2);
+  match = g_list_model_get_item (matches, 0);
+  g_assert_cmpstr (fuzzy_index_match_get_key (match), ==, "gtk_widget_show");
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_incremental (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GListModel) model = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  guint n_changed = 0;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-incremental.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "gdk_window_show", g_variant_new_int32 (3), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  /* The model is available before the query completes */
+  model = fuzzy_index_query_begin (index,
+                                   "gtk_widget_show",
+                                   3,
+                                   NULL,
+                                   test_index_incremental_query_cb,
+                                   NULL);
+  g_assert (G_IS_LIST_MODEL (model));
+  g_assert_cmpint (g_list_model_get_n_items (model), ==, 0);
+
+  g_signal_connect (model,
+                    "items-changed",
+                    G_CALLBACK (test_index_incremental_changed_cb),
+                    &n_changed);
+
+  g_main_loop_run (main_loop);
+
+  /* Provisional results may be coalesced into the final ones */
+  g_assert_cmpint (n_changed, >=, 1);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_checksum (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree gchar *contents = NULL;
+  GError *error = NULL;
+  gchar *key;
+  gboolean r;
+  gsize len;
+
+  file = g_file_new_for_path ("index-checksum.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "foo", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "bar", g_variant_new_int32 (2), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  /* Change a key within the payload */
+  r = g_file_load_contents (file, NULL, &contents, &len, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+  g_assert_cmpint (len, >, 64);
+  for (key = contents + 64; key + 4 <= contents + len; key++)
+    {
+      if (memcmp (key, "bar", 4) == 0)
+        break;
+    }
+  g_assert (key + 4 <= contents + len);
+  key [2] = 'z';
+  r = g_file_replace_contents (file, contents, len, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  /* Loading only checks the header, the checksum is verified on demand */
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  r = _fuzzy_index_verify (index, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert (!r);
+  g_clear_error (&error);
+
+  /* A damaged header still fails to load */
+  contents [0] ^= 0xff;
+  r = g_file_replace_contents (file, contents, len, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  g_clear_object (&index);
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_assert (!r);
+  g_clear_error (&error);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_warmup_cb (GObject      *object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  GError *error = NULL;
+  gsize resident = 0;
+  gsize mapped = 0;
+  gboolean r;
+
+  r = fuzzy_index_warmup_finish (index, result, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_get_residency (index, &resident, &mapped);
+  g_assert_cmpint (mapped, >, 0);
+  g_assert_cmpint (resident, <=, mapped);
+  g_assert_cmpint (resident, >, 0);
+
+  g_main_loop_quit (main_loop);
+}
+
+static void
+test_index_warmup (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-warmup.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_hide", g_variant_new_int32 (2), 0);
+
+  r = fuzzy_index_builder_write (builder, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_warmup_async (index, NULL, test_index_warmup_cb, NULL);
+
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_memory (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(FuzzyIndex) loaded = NULL;
+  g_autoptr(GFile) file = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("index-memory.gvariant");
+
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_insert (builder, "gtk_widget_show_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  fuzzy_index_builder_insert (builder, "gtk_widget_hide", g_variant_new_int32 (3), 0);
+
+  /* Query the index without it ever touching the disk */
+  index = fuzzy_index_builder_build_index (builder);
+  g_assert (FUZZY_IS_INDEX (index));
+
+  fuzzy_index_query_async (index, "gtk_widget_show", 1, NULL, test_index_prefix_query_cb, NULL);
+  g_main_loop_run (main_loop);
+
+  /* Now save it, and make sure it loads back the same */
+  r = fuzzy_index_write (index, file, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  loaded = fuzzy_index_new ();
+  r = fuzzy_index_load_file (loaded, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  fuzzy_index_query_async (loaded, "gtk_widget_show", 1, NULL, test_index_prefix_query_cb, NULL);
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
+static void
+test_index_merge (void)
+{
+  g_autoptr(FuzzyIndexBuilder) builder1 = NULL;
+  g_autoptr(FuzzyIndexBuilder) builder2 = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GVariant) mtime = NULL;
+  GFile *inputs[2];
+  g_autoptr(GFile) file1 = NULL;
+  g_autoptr(GFile) file2 = NULL;
+  g_autoptr(GFile) merged = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file1 = g_file_new_for_path ("index-merge-1.gvariant");
+  file2 = g_file_new_for_path ("index-merge-2.gvariant");
+  merged = g_file_new_for_path ("index-merge.gvariant");
+
+  builder1 = fuzzy_index_builder_new ();
+  fuzzy_index_builder_set_metadata_uint32 (builder1, "version", 1);
+  fuzzy_index_builder_set_metadata_uint64 (builder1, "mtime", 1);
+  fuzzy_index_builder_insert (builder1, "gtk_widget_hide", g_variant_new_int32 (3), 0);
+  fuzzy_index_builder_insert (builder1, "gtk_widget_show", g_variant_new_int32 (1), 0);
+  r = fuzzy_index_builder_write (builder1, file1, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  builder2 = fuzzy_index_builder_new ();
+  fuzzy_index_builder_set_metadata_uint32 (builder2, "version", 1);
+  fuzzy_index_builder_set_metadata_uint64 (builder2, "mtime", 2);
+  fuzzy_index_builder_insert (builder2, "gtk_widget_show_all", g_variant_new_int32 (2), 0);
+  fuzzy_index_builder_insert (builder2, "gtk_window_show", g_variant_new_int32 (4), 0);
+  r = fuzzy_index_builder_write (builder2, file2, G_PRIORITY_DEFAULT, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  inputs[0] = file2;
+  inputs[1] = file1;
+  r = fuzzy_index_merge (inputs, G_N_ELEMENTS (inputs), merged, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  index = fuzzy_index_new ();
+  r = fuzzy_index_load_file (index, merged, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  /* Only metadata shared by all inputs is kept */
+  g_assert_cmpint (fuzzy_index_get_metadata_uint32 (index, "version"), ==, 1);
+  mtime = fuzzy_index_get_metadata (index, "mtime");
+  g_assert (mtime == NULL);
+
+  /* The exact match must be found even though it came from the second input */
+  fuzzy_index_query_async (index, "GTK_Widget_Show", 1, NULL, test_index_prefix_query_cb, NULL);
+  g_main_loop_run (main_loop);
+
+  r = g_file_delete (file1, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  r = g_file_delete (file2, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  r = g_file_delete (merged, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -272,5 +895,14 @@ main (gint   argc,
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Fuzzy/IndexBuilder/basic", test_index_builder_basic);
   g_test_add_func ("/Fuzzy/Index/basic", test_index_basic);
+  g_test_add_func ("/Fuzzy/Index/prefix", test_index_prefix);
+  g_test_add_func ("/Fuzzy/Index/typo", test_index_typo);
+  g_test_add_func ("/Fuzzy/Index/priority", test_index_priority);
+  g_test_add_func ("/Fuzzy/Index/rank", test_index_rank);
+  g_test_add_func ("/Fuzzy/Index/incremental", test_index_incremental);
+  g_test_add_func ("/Fuzzy/Index/checksum", test_index_checksum);
+  g_test_add_func ("/Fuzzy/Index/warmup", test_index_warmup);
+  g_test_add_func ("/Fuzzy/Index/memory", test_index_memory);
+  g_test_add_func ("/Fuzzy/Index/merge", test_index_merge);
   return g_test_run ();
 }
@@ -38,11 +38,35 @@ test_variant_hash (void)
   g_assert_cmpint (g_variant_equal (v1, v2), ==, TRUE);
 }
 
+static void
+test_deletion_compare (void)
+{
+  /* "variant" without the second 'a' is "varint" */
+  g_assert_cmpint (fuzzy_deletion_compare ("variant", 4, "varint", -1, G_MAXSIZE), ==, 0);
+  g_assert_cmpint (fuzzy_deletion_compare ("varint", -1, "variant", 4, G_MAXSIZE), ==, 0);
+
+  /* Both sides may drop a character, as for swapped letters */
+  g_assert_cmpint (fuzzy_deletion_compare ("varaint", 3, "variant", 4, G_MAXSIZE), ==, 0);
+
+  /* Ordering is that of the strings with the characters removed */
+  g_assert_cmpint (fuzzy_deletion_compare ("variant", 0, "b", -1, G_MAXSIZE), <, 0);
+  g_assert_cmpint (fuzzy_deletion_compare ("variant", 1, "b", -1, G_MAXSIZE), >, 0);
+  g_assert_cmpint (fuzzy_deletion_compare ("ab", 1, "ab", -1, G_MAXSIZE), <, 0);
+
+  /* Limited to n bytes, which makes it a prefix test */
+  g_assert_cmpint (fuzzy_deletion_compare ("g_variant_new", 4, "g_vaiant", -1, 8), ==, 0);
+  g_assert_cmpint (fuzzy_deletion_compare ("g_variant_new", 4, "g_vaiant", -1, G_MAXSIZE), >, 0);
+
+  /* Multi-byte characters are skipped whole */
+  g_assert_cmpint (fuzzy_deletion_compare ("caf\xc3\xa9s", 3, "cafs", -1, G_MAXSIZE), ==, 0);
+}
+
 gint
 main (gint argc,
       gchar *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Util/GVariant/hash", test_variant_hash);
+  g_test_add_func ("/Util/deletion-compare", test_deletion_compare);
   return g_test_run ();
 }
@@ -0,0 +1,562 @@
+/* bench-gir.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks the stages of indexing and searching a .gir file, using a
+ * synthetic document so that results do not depend on what happens to be
+ * installed. Results are printed as tab separated "metric value unit"
+ * lines, like bench-fuzzy in contrib/fuzzy-glib.
+ */
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef G_OS_UNIX
+# include <sys/resource.h>
+#endif
+
+#include "bench-counters.h"
+#include "rtfm-gir-file.h"
+#include "rtfm-gir-parser.h"
+
+/* Roughly the size of Gtk-3.0.gir, which --scale is relative to */
+#define GTK3_GIR_SIZE (7 * 1024 * 1024)
+
+static gdouble scale = 1.0;
+static gint    seed = 1234;
+static gchar  *keep;
+
+static GOptionEntry entries[] = {
+  { "scale", 's', 0, G_OPTION_ARG_DOUBLE, &scale, "Size of the document relative to Gtk-3.0.gir", "SCALE" },
+  { "seed", 0, 0, G_OPTION_ARG_INT, &seed, "Seed for the generator", "N" },
+  { "keep", 'k', 0, G_OPTION_ARG_FILENAME, &keep, "Keep the generated .gir at PATH", "PATH" },
+  { NULL }
+};
+
+static const gchar *verbs[] = {
+  "get", "set", "add", "remove", "insert", "find", "lookup", "update",
+  "begin", "end", "show", "hide", "queue", "connect", "reset", "load",
+};
+
+static const gchar *nouns[] = {
+  "child", "label", "title", "value", "state", "size", "name", "item",
+  "window", "buffer", "model", "cursor", "style", "action", "range", "icon",
+};
+
+static const gchar *lorem[] = {
+  "the", "widget", "returns", "a", "new", "reference", "to", "which",
+  "should", "be", "freed", "when", "no", "longer", "needed", "this",
+  "function", "is", "called", "for", "each", "child", "of", "container",
+  "allocation", "is", "updated", "after", "size", "negotiation", "see",
+  "also", "signal", "emitted", "property", "changes", "default", "handler",
+};
+
+/*
+ * Queries run against the written indexes, using words the generator is
+ * known to produce, like the search entry does as the user types.
+ */
+static const gchar *name_queries[] = {
+  "get", "set_ti", "window", "lab", "insert_child", "cursor_up",
+};
+
+static const gchar *doc_queries[] = {
+  "widget", "refer", "size negotiation", "signal emitted", "container al",
+};
+
+typedef struct
+{
+  GMainLoop  *main_loop;
+  GListModel *results;
+} SearchState;
+
+static void
+name_query_cb (GObject      *object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  SearchState *state = user_data;
+
+  state->results = fuzzy_index_query_finish (FUZZY_INDEX (object), result, NULL);
+  g_main_loop_quit (state->main_loop);
+}
+
+static void
+doc_query_cb (GObject      *object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  SearchState *state = user_data;
+
+  state->results = rtfm_gir_doc_index_query_finish (RTFM_GIR_DOC_INDEX (object), result, NULL);
+  g_main_loop_quit (state->main_loop);
+}
+
+static guint
+run_search (FuzzyIndex      *index,
+            RtfmGirDocIndex *doc_index)
+{
+  g_autoptr(GMainLoop) main_loop = g_main_loop_new (NULL, FALSE);
+  guint n_results = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (name_queries); i++)
+    {
+      SearchState state = { main_loop, NULL };
+
+      fuzzy_index_query_async (index, name_queries [i], 25, NULL, name_query_cb, &state);
+      g_main_loop_run (main_loop);
+
+      if (state.results != NULL)
+        n_results += g_list_model_get_n_items (state.results);
+      g_clear_object (&state.results);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (doc_queries); i++)
+    {
+      SearchState state = { main_loop, NULL };
+
+      rtfm_gir_doc_index_query_async (doc_index, doc_queries [i], 25, NULL, doc_query_cb, &state);
+      g_main_loop_run (main_loop);
+
+      if (state.results != NULL)
+        n_results += g_list_model_get_n_items (state.results);
+      g_clear_object (&state.results);
+    }
+
+  return n_results;
+}
+
+static void
+report (const gchar *metric,
+        gdouble      value,
+        const gchar *unit)
+{
+  g_print ("%s\t%.3lf\t%s\n", metric, value, unit);
+}
+
+/*
+ * Resets the peak resident set size of the process so that each stage
+ * can report its own peak. This is only possible on Linux, elsewhere
+ * the peak is that of the whole run so far.
+ */
+static void
+reset_peak_rss (void)
+{
+#ifdef __linux__
+  FILE *fp;
+
+  if (NULL != (fp = fopen ("/proc/self/clear_refs", "w")))
+    {
+      fputs ("5", fp);
+      fclose (fp);
+    }
+#endif
+}
+
+static gdouble
+get_peak_rss_mb (void)
+{
+#ifdef __linux__
+  g_autofree gchar *contents = NULL;
+  const gchar *line;
+
+  if (g_file_get_contents ("/proc/self/status", &contents, NULL, NULL) &&
+      NULL != (line = strstr (contents, "VmHWM:")))
+    return g_ascii_strtoull (line + strlen ("VmHWM:"), NULL, 10) / 1024.0;
+#endif
+
+#ifdef G_OS_UNIX
+  {
+    struct rusage usage;
+
+    /* ru_maxrss is in kilobytes on Linux and the BSDs */
+    if (getrusage (RUSAGE_SELF, &usage) == 0)
+      return usage.ru_maxrss / 1024.0;
+  }
+#endif
+
+  return 0.0;
+}
+
+static void
+append_doc (GString *str,
+            GRand   *rand,
+            gint     depth)
+{
+  gint n_words = g_rand_int_range (rand, 8, 40);
+  gint i;
+
+  for (i = 0; i < depth; i++)
+    g_string_append (str, "  ");
+
+  g_string_append (str, "<doc xml:space=\"preserve\">");
+
+  for (i = 0; i < n_words; i++)
+    {
+      if (i > 0)
+        g_string_append_c (str, ' ');
+      g_string_append (str, lorem [g_rand_int_range (rand, 0, G_N_ELEMENTS (lorem))]);
+    }
+
+  g_string_append (str, ".</doc>\n");
+}
+
+static void
+append_type (GString     *str,
+             const gchar *element,
+             const gchar *name,
+             const gchar *c_type)
+{
+  g_string_append_printf (str,
+                          "<%s transfer-ownership=\"none\"><type name=\"%s\" c:type=\"%s\"/></%s>\n",
+                          element, name, c_type, element);
+}
+
+static void
+append_class (GString *str,
+              GRand   *rand,
+              guint    id)
+{
+  g_autofree gchar *type_name = g_strdup_printf ("Widget%u", id);
+  g_autofree gchar *c_type = g_strdup_printf ("BenchWidget%u", id);
+  g_autofree gchar *c_ptr_type = g_strdup_printf ("BenchWidget%u*", id);
+  gint n_methods = g_rand_int_range (rand, 8, 40);
+  gint i;
+
+  g_string_append_printf (str,
+                          "    <class name=\"%s\" c:type=\"%s\" parent=\"GObject.Object\" "
+                          "glib:type-name=\"%s\" glib:get-type=\"bench_widget%u_get_type\" "
+                          "c:symbol-prefix=\"widget%u\"%s>\n",
+                          type_name, c_type, c_type, id, id,
+                          g_rand_int_range (rand, 0, 20) == 0 ? " deprecated=\"1\"" : "");
+  append_doc (str, rand, 3);
+
+  g_string_append_printf (str,
+                          "      <constructor name=\"new\" c:identifier=\"bench_widget%u_new\">\n",
+                          id);
+  append_doc (str, rand, 4);
+  g_string_append (str, "        ");
+  append_type (str, "return-value", type_name, c_ptr_type);
+  g_string_append (str, "      </constructor>\n");
+
+  for (i = 0; i < n_methods; i++)
+    {
+      const gchar *verb = verbs [g_rand_int_range (rand, 0, G_N_ELEMENTS (verbs))];
+      const gchar *noun = nouns [g_rand_int_range (rand, 0, G_N_ELEMENTS (nouns))];
+
+      g_string_append_printf (str,
+                              "      <method name=\"%s_%s_%d\" c:identifier=\"bench_widget%u_%s_%s_%d\">\n",
+                              verb, noun, i, id, verb, noun, i);
+      append_doc (str, rand, 4);
+      g_string_append (str, "        ");
+      append_type (str, "return-value", "gboolean", "gboolean");
+      g_string_append (str, "        <parameters>\n          ");
+      append_type (str, "instance-parameter", type_name, c_ptr_type);
+      g_string_append (str, "          ");
+      append_type (str, "parameter", "gint", "gint");
+      g_string_append (str, "        </parameters>\n      </method>\n");
+    }
+
+  for (i = 0; i < 3; i++)
+    {
+      g_string_append_printf (str,
+                              "      <property name=\"%s-%d\" writable=\"1\" transfer-ownership=\"none\">\n",
+                              nouns [g_rand_int_range (rand, 0, G_N_ELEMENTS (nouns))], i);
+      append_doc (str, rand, 4);
+      g_string_append (str, "        <type name=\"gint\" c:type=\"gint\"/>\n      </property>\n");
+    }
+
+  g_string_append (str, "      <glib:signal name=\"changed\" when=\"last\">\n");
+  append_doc (str, rand, 4);
+  g_string_append (str, "        ");
+  append_type (str, "return-value", "none", "void");
+  g_string_append (str, "      </glib:signal>\n    </class>\n");
+
+  g_string_append_printf (str,
+                          "    <record name=\"%sClass\" c:type=\"%sClass\" glib:is-gtype-struct-for=\"%s\">\n"
+                          "      <field name=\"parent_class\"><type name=\"GObject.ObjectClass\" c:type=\"GObjectClass\"/></field>\n"
+                          "    </record>\n",
+                          type_name, c_type, type_name);
+
+  g_string_append_printf (str,
+                          "    <function name=\"widget%u_helper\" c:identifier=\"bench_widget%u_helper\">\n",
+                          id, id);
+  append_doc (str, rand, 3);
+  g_string_append (str, "      ");
+  append_type (str, "return-value", "none", "void");
+  g_string_append (str, "    </function>\n");
+
+  g_string_append_printf (str, "    <enumeration name=\"Mode%u\" c:type=\"BenchMode%u\">\n", id, id);
+  for (i = 0; i < 4; i++)
+    g_string_append_printf (str,
+                            "      <member name=\"%s\" value=\"%d\" c:identifier=\"BENCH_MODE%u_%s\"/>\n",
+                            nouns [i], i, id, nouns [i]);
+  g_string_append (str, "    </enumeration>\n");
+}
+
+static GString *
+generate_gir (gsize target)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  GString *str;
+  guint id;
+
+  str = g_string_sized_new (target + 4096);
+
+  g_string_append (str,
+                   "<?xml version=\"1.0\"?>\n"
+                   "<repository version=\"1.2\"\n"
+                   "            xmlns=\"http://www.gtk.org/introspection/core/1.0\"\n"
+                   "            xmlns:c=\"http://www.gtk.org/introspection/c/1.0\"\n"
+                   "            xmlns:glib=\"http://www.gtk.org/introspection/glib/1.0\">\n"
+                   "  <include name=\"GObject\" version=\"2.0\"/>\n"
+                   "  <package name=\"bench-1.0\"/>\n"
+                   "  <c:include name=\"bench/bench.h\"/>\n"
+                   "  <namespace name=\"Bench\" version=\"1.0\" shared-library=\"libbench-1.0.so\"\n"
+                   "             c:identifier-prefixes=\"Bench\" c:symbol-prefixes=\"bench\">\n");
+
+  for (id = 0; str->len < target; id++)
+    append_class (str, rand, id);
+
+  g_string_append (str, "  </namespace>\n</repository>\n");
+
+  return str;
+}
+
+static guint
+count_objects (RtfmGirParserObject *object)
+{
+  GPtrArray *children;
+  guint count = 1;
+  guint i;
+
+  if (NULL != (children = rtfm_gir_parser_object_get_children (object)))
+    {
+      for (i = 0; i < children->len; i++)
+        count += count_objects (g_ptr_array_index (children, i));
+    }
+
+  return count;
+}
+
+static gsize
+get_file_size (GFile *file)
+{
+  g_autoptr(GFileInfo) info = NULL;
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, 0, NULL, NULL);
+
+  return info ? g_file_info_get_size (info) : 0;
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(RtfmGirParser) parser = NULL;
+  g_autoptr(RtfmGirRepository) repository = NULL;
+  g_autoptr(RtfmGirFile) gir_file = NULL;
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(RtfmGirDocIndexBuilder) doc_builder = NULL;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(RtfmGirDocIndex) doc_index = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFile) index_file = NULL;
+  g_autoptr(GFile) doc_index_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *index_path = NULL;
+  g_autofree gchar *doc_index_path = NULL;
+  BenchCounters *counters;
+  GString *gir;
+  gdouble mb;
+  gdouble elapsed;
+  gint64 begin;
+  gsize gir_len;
+  gsize written;
+  guint n_objects;
+  guint n_results;
+  gint ret = EXIT_FAILURE;
+
+  context = g_option_context_new ("- benchmark indexing of a synthetic .gir");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (scale <= 0.0)
+    {
+      g_printerr ("--scale must be positive\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Generate */
+  begin = g_get_monotonic_time ();
+  gir = generate_gir (GTK3_GIR_SIZE * scale);
+  gir_len = gir->len;
+  mb = gir_len / (1024.0 * 1024.0);
+  report ("generate", (g_get_monotonic_time () - begin) / 1000.0, "msec");
+  report ("generate.size", mb, "MB");
+
+  path = keep ? g_strdup (keep) : g_build_filename (g_get_tmp_dir (), "bench-gir-XXXXXX.gir", NULL);
+  if (keep == NULL)
+    {
+      gint fd = g_mkstemp (path);
+
+      if (fd == -1)
+        {
+          g_printerr ("Failed to create %s\n", path);
+          return EXIT_FAILURE;
+        }
+      close (fd);
+    }
+
+  if (!g_file_set_contents (path, gir->str, gir->len, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  g_string_free (gir, TRUE);
+
+  file = g_file_new_for_path (path);
+  index_path = g_strdup_printf ("%s.gvariant", path);
+  doc_index_path = g_strdup_printf ("%s.docs.gvariant", path);
+  index_file = g_file_new_for_path (index_path);
+  doc_index_file = g_file_new_for_path (doc_index_path);
+
+  parser = rtfm_gir_parser_new ();
+
+  /* The outline that is parsed when a namespace is first opened */
+  reset_peak_rss ();
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  repository = rtfm_gir_parser_parse_skeleton (parser, file, NULL, &error);
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "skeleton");
+
+  if (repository == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      goto cleanup;
+    }
+
+  report ("skeleton", elapsed * 1000.0, "msec");
+  report ("skeleton.throughput", mb / MAX (elapsed, 1e-9), "MB/sec");
+  report ("skeleton.peak-rss", get_peak_rss_mb (), "MB");
+
+  g_clear_object (&repository);
+
+  /* Parse, which includes reading the file */
+  reset_peak_rss ();
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  repository = rtfm_gir_parser_parse_file (parser, file, NULL, &error);
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "parse");
+
+  if (repository == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      goto cleanup;
+    }
+
+  n_objects = count_objects (RTFM_GIR_PARSER_OBJECT (repository));
+
+  report ("parse", elapsed * 1000.0, "msec");
+  report ("parse.throughput", mb / MAX (elapsed, 1e-9), "MB/sec");
+  report ("parse.objects", n_objects, "objects");
+  report ("parse.objects.rate", n_objects / MAX (elapsed, 1e-9), "objects/sec");
+  report ("parse.peak-rss", get_peak_rss_mb (), "MB");
+
+  /* Run the indexers */
+  reset_peak_rss ();
+  gir_file = rtfm_gir_file_new (file);
+  builder = fuzzy_index_builder_new ();
+  doc_builder = rtfm_gir_doc_index_builder_new ();
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  rtfm_gir_file_build_indexes (gir_file, repository, builder, doc_builder);
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "index");
+
+  report ("index", elapsed * 1000.0, "msec");
+  report ("index.throughput", mb / MAX (elapsed, 1e-9), "MB/sec");
+  report ("index.objects.rate", n_objects / MAX (elapsed, 1e-9), "objects/sec");
+  report ("index.peak-rss", get_peak_rss_mb (), "MB");
+
+  /* Write both indexes */
+  reset_peak_rss ();
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  if (!fuzzy_index_builder_write (builder, index_file, G_PRIORITY_DEFAULT, NULL, &error) ||
+      !rtfm_gir_doc_index_builder_write (doc_builder, doc_index_file, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      goto cleanup;
+    }
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "write");
+  written = get_file_size (index_file) + get_file_size (doc_index_file);
+
+  report ("write", elapsed * 1000.0, "msec");
+  report ("write.size", written / (1024.0 * 1024.0), "MB");
+  report ("write.throughput", mb / MAX (elapsed, 1e-9), "MB/sec");
+  report ("write.objects.rate", n_objects / MAX (elapsed, 1e-9), "objects/sec");
+  report ("write.peak-rss", get_peak_rss_mb (), "MB");
+
+  /* Search the indexes as written, which is what a session starts with */
+  index = fuzzy_index_new ();
+  doc_index = rtfm_gir_doc_index_new ();
+
+  if (!fuzzy_index_load_file (index, index_file, NULL, &error) ||
+      !rtfm_gir_doc_index_load_file (doc_index, doc_index_file, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      goto cleanup;
+    }
+
+  /* Warm up the worker threads so that every query is counted alike */
+  run_search (index, doc_index);
+
+  counters = bench_counters_begin ();
+  begin = g_get_monotonic_time ();
+  n_results = run_search (index, doc_index);
+  elapsed = (g_get_monotonic_time () - begin) / (gdouble)G_USEC_PER_SEC;
+  bench_counters_end (counters, "search");
+
+  report ("search", elapsed * 1000.0, "msec");
+  report ("search.results", n_results, "matches");
+
+  ret = EXIT_SUCCESS;
+
+cleanup:
+  g_unlink (index_path);
+  g_unlink (doc_index_path);
+  if (keep == NULL)
+    g_unlink (path);
+
+  return ret;
+}
@@ -0,0 +1,580 @@
+/* rtfm-gir-binary.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "rtfm-gir-binary"
+
+#include <string.h>
+
+#include "rtfm-gir-binary.h"
+#include "rtfm-gir-doc.h"
+
+/*
+ * The binary repository is a parsed .gir file laid out so that it can be
+ * mapped and used in place. It is a header followed by three tables:
+ *
+ *   Node    nodes [n_nodes];
+ *   Attr    attrs [n_attrs];
+ *   gchar   strings [strings_len];
+ *
+ * Node 0 is the <repository>. The children of each node are stored next
+ * to each other, in document order, so a node only records the range of
+ * its children. Attributes are the string properties of the parser
+ * objects, and all strings are offsets into the NUL separated string
+ * table. Everything is little endian and 4 byte aligned.
+ *
+ * Nothing is created when loading other than the repository. The other
+ * objects are created a level at a time, when their parent is first
+ * asked for its children.
+ */
+
+#define BINARY_MAGIC     "RTFMGIR\0"
+#define BINARY_MAGIC_LEN 8
+#define BINARY_VERSION   1
+#define NO_STRING        G_MAXUINT32
+
+typedef struct
+{
+  gchar   magic [BINARY_MAGIC_LEN];
+  guint32 version;
+  guint32 n_nodes;
+  guint64 mtime;
+  guint32 n_attrs;
+  guint32 strings_len;
+} Header;
+
+typedef struct
+{
+  guint32 type;
+  guint32 text;
+  guint32 first_attr;
+  guint32 n_attrs;
+  guint32 first_child;
+  guint32 n_children;
+} Node;
+
+typedef struct
+{
+  guint32 name;
+  guint32 value;
+} Attr;
+
+G_STATIC_ASSERT (sizeof (Header) == 32);
+G_STATIC_ASSERT (sizeof (Node) == 24);
+G_STATIC_ASSERT (sizeof (Attr) == 8);
+
+/*
+ * The node types, by their index in the file. New types must be added
+ * at the end, and BINARY_VERSION bumped if any are removed.
+ */
+static GType (*node_types []) (void) = {
+  rtfm_gir_alias_get_type,
+  rtfm_gir_annotation_get_type,
+  rtfm_gir_array_get_type,
+  rtfm_gir_bitfield_get_type,
+  rtfm_gir_c_include_get_type,
+  rtfm_gir_callback_get_type,
+  rtfm_gir_class_get_type,
+  rtfm_gir_constant_get_type,
+  rtfm_gir_constructor_get_type,
+  rtfm_gir_doc_get_type,
+  rtfm_gir_doc_deprecated_get_type,
+  rtfm_gir_doc_stability_get_type,
+  rtfm_gir_doc_version_get_type,
+  rtfm_gir_enumeration_get_type,
+  rtfm_gir_field_get_type,
+  rtfm_gir_function_get_type,
+  rtfm_gir_glib_boxed_get_type,
+  rtfm_gir_glib_signal_get_type,
+  rtfm_gir_implements_get_type,
+  rtfm_gir_include_get_type,
+  rtfm_gir_instance_parameter_get_type,
+  rtfm_gir_interface_get_type,
+  rtfm_gir_member_get_type,
+  rtfm_gir_method_get_type,
+  rtfm_gir_namespace_get_type,
+  rtfm_gir_package_get_type,
+  rtfm_gir_parameter_get_type,
+  rtfm_gir_parameters_get_type,
+  rtfm_gir_prerequisite_get_type,
+  rtfm_gir_property_get_type,
+  rtfm_gir_record_get_type,
+  rtfm_gir_repository_get_type,
+  rtfm_gir_return_value_get_type,
+  rtfm_gir_type_get_type,
+  rtfm_gir_union_get_type,
+  rtfm_gir_varargs_get_type,
+  rtfm_gir_virtual_method_get_type,
+};
+
+/* A mapped binary repository, shared by the objects still to be created */
+typedef struct
+{
+  volatile gint  ref_count;
+  GMappedFile   *mapped_file;
+  const Node    *nodes;
+  const Attr    *attrs;
+  const gchar   *strings;
+} Binary;
+
+typedef struct
+{
+  Binary  *binary;
+  guint32  node;
+} Pending;
+
+static Binary *
+binary_ref (Binary *binary)
+{
+  g_atomic_int_inc (&binary->ref_count);
+  return binary;
+}
+
+static void
+binary_unref (Binary *binary)
+{
+  if (g_atomic_int_dec_and_test (&binary->ref_count))
+    {
+      g_mapped_file_unref (binary->mapped_file);
+      g_slice_free (Binary, binary);
+    }
+}
+
+static void
+pending_free (gpointer data)
+{
+  Pending *pending = data;
+
+  binary_unref (pending->binary);
+  g_slice_free (Pending, pending);
+}
+
+static GType
+get_node_type (guint32 type)
+{
+  g_assert (type < G_N_ELEMENTS (node_types));
+
+  return node_types [type] ();
+}
+
+static void materialize (RtfmGirParserObject *self,
+                         GPtrArray           *children,
+                         gpointer             user_data);
+
+static void
+defer_children (RtfmGirParserObject *object,
+                Binary              *binary,
+                guint32              node)
+{
+  Pending *pending;
+
+  if (binary->nodes [node].n_children == 0)
+    return;
+
+  pending = g_slice_new (Pending);
+  pending->binary = binary_ref (binary);
+  pending->node = node;
+
+  _rtfm_gir_parser_object_set_materialize (object, materialize, pending, pending_free);
+}
+
+static void
+materialize (RtfmGirParserObject *self,
+             GPtrArray           *children,
+             gpointer             user_data)
+{
+  RtfmGirParserContext *parser_context;
+  Pending *pending = user_data;
+  Binary *binary = pending->binary;
+  const Node *node = &binary->nodes [pending->node];
+  guint32 i;
+
+  g_assert (RTFM_GIR_IS_PARSER_OBJECT (self));
+  g_assert (children != NULL);
+
+  parser_context = rtfm_gir_parser_object_get_parser_context (self);
+
+  for (i = 0; i < node->n_children; i++)
+    {
+      guint32 child_id = GUINT32_FROM_LE (node->first_child) + i;
+      const Node *child_node = &binary->nodes [child_id];
+      RtfmGirParserObject *child;
+      guint32 first_attr = GUINT32_FROM_LE (child_node->first_attr);
+      guint32 n_attrs = GUINT32_FROM_LE (child_node->n_attrs);
+      guint32 text = GUINT32_FROM_LE (child_node->text);
+      guint32 j;
+
+      child = g_object_new (get_node_type (GUINT32_FROM_LE (child_node->type)),
+                            "parser-context", parser_context,
+                            NULL);
+
+      for (j = 0; j < n_attrs; j++)
+        {
+          const Attr *attr = &binary->attrs [first_attr + j];
+
+          g_object_set (child,
+                        &binary->strings [GUINT32_FROM_LE (attr->name)],
+                        &binary->strings [GUINT32_FROM_LE (attr->value)],
+                        NULL);
+        }
+
+      if (text != NO_STRING && RTFM_GIR_IS_DOC (child))
+        _rtfm_gir_doc_set_text (RTFM_GIR_DOC (child), &binary->strings [text]);
+
+      _rtfm_gir_parser_object_set_parent (child, self);
+      defer_children (child, binary, child_id);
+
+      g_ptr_array_add (children, child);
+    }
+}
+
+/*
+ * Checks every offset in the file once, so that creating the objects
+ * can trust it. Children must come after their parent, which also rules
+ * out cycles.
+ */
+static gboolean
+binary_validate (const Header  *header,
+                 gsize          len,
+                 const Node    *nodes,
+                 const Attr    *attrs,
+                 const gchar   *strings,
+                 GError       **error)
+{
+  guint32 n_nodes = GUINT32_FROM_LE (header->n_nodes);
+  guint32 n_attrs = GUINT32_FROM_LE (header->n_attrs);
+  guint32 strings_len = GUINT32_FROM_LE (header->strings_len);
+  guint32 i;
+
+  if ((guint64)sizeof (Header) +
+      (guint64)n_nodes * sizeof (Node) +
+      (guint64)n_attrs * sizeof (Attr) +
+      (guint64)strings_len != len ||
+      n_nodes == 0 ||
+      strings_len == 0 ||
+      strings [strings_len - 1] != '\0')
+    goto corrupt;
+
+  for (i = 0; i < n_attrs; i++)
+    {
+      if (GUINT32_FROM_LE (attrs [i].name) >= strings_len ||
+          GUINT32_FROM_LE (attrs [i].value) >= strings_len)
+        goto corrupt;
+    }
+
+  for (i = 0; i < n_nodes; i++)
+    {
+      const Node *node = &nodes [i];
+      guint32 text = GUINT32_FROM_LE (node->text);
+      guint32 first_attr = GUINT32_FROM_LE (node->first_attr);
+      guint32 first_child = GUINT32_FROM_LE (node->first_child);
+      guint32 n_children = GUINT32_FROM_LE (node->n_children);
+
+      if (GUINT32_FROM_LE (node->type) >= G_N_ELEMENTS (node_types) ||
+          (text != NO_STRING && text >= strings_len) ||
+          first_attr > n_attrs ||
+          GUINT32_FROM_LE (node->n_attrs) > n_attrs - first_attr ||
+          (n_children > 0 && (first_child <= i ||
+                              first_child > n_nodes ||
+                              n_children > n_nodes - first_child)))
+        goto corrupt;
+    }
+
+  if (get_node_type (GUINT32_FROM_LE (nodes [0].type)) != RTFM_GIR_TYPE_REPOSITORY)
+    goto corrupt;
+
+  return TRUE;
+
+corrupt:
+  g_set_error (error,
+               G_IO_ERROR,
+               G_IO_ERROR_INVALID_DATA,
+               "The binary repository is corrupt");
+
+  return FALSE;
+}
+
+/**
+ * rtfm_gir_binary_load:
+ * @path: The binary repository to map
+ * @mtime: The mtime of the .gir file it must have been written for
+ * @error: A location for a #GError or %NULL
+ *
+ * Maps a binary repository written by rtfm_gir_binary_write(). Only the
+ * repository itself is created, its descendants are created as they are
+ * navigated to and keep the file mapped until then.
+ *
+ * Returns: (transfer full): An #RtfmGirRepository or %NULL if the file
+ *   is missing, corrupt, or was written for another version of the .gir.
+ */
+RtfmGirRepository *
+rtfm_gir_binary_load (const gchar  *path,
+                      guint64       mtime,
+                      GError      **error)
+{
+  g_autoptr(GMappedFile) mapped_file = NULL;
+  g_autoptr(RtfmGirParserContext) parser_context = NULL;
+  RtfmGirRepository *repository;
+  const Header *header;
+  const gchar *data;
+  Binary *binary;
+  gsize len;
+  guint32 n_nodes;
+  guint32 n_attrs;
+  guint32 i;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (NULL == (mapped_file = g_mapped_file_new (path, FALSE, error)))
+    return NULL;
+
+  data = g_mapped_file_get_contents (mapped_file);
+  len = g_mapped_file_get_length (mapped_file);
+  header = (const Header *)(gconstpointer)data;
+
+  if (len < sizeof (Header) ||
+      memcmp (header->magic, BINARY_MAGIC, BINARY_MAGIC_LEN) != 0 ||
+      GUINT32_FROM_LE (header->version) != BINARY_VERSION)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_DATA,
+                   "%s is not a binary repository of version %u",
+                   path, BINARY_VERSION);
+      return NULL;
+    }
+
+  if (GUINT64_FROM_LE (header->mtime) != mtime)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_WRONG_ETAG,
+                   "mtime from binary repository is too old, requires rebuild");
+      return NULL;
+    }
+
+  n_nodes = GUINT32_FROM_LE (header->n_nodes);
+  n_attrs = GUINT32_FROM_LE (header->n_attrs);
+
+  binary = g_slice_new0 (Binary);
+  binary->ref_count = 1;
+  binary->mapped_file = g_steal_pointer (&mapped_file);
+  binary->nodes = (const Node *)(gconstpointer)(data + sizeof (Header));
+  binary->attrs = (const Attr *)(gconstpointer)(data + sizeof (Header) + n_nodes * sizeof (Node));
+  binary->strings = data + sizeof (Header) + n_nodes * sizeof (Node) + n_attrs * sizeof (Attr);
+
+  if (!binary_validate (header, len, binary->nodes, binary->attrs, binary->strings, error))
+    {
+      binary_unref (binary);
+      return NULL;
+    }
+
+  parser_context = rtfm_gir_parser_context_new ();
+  repository = rtfm_gir_repository_new (parser_context);
+
+  for (i = 0; i < GUINT32_FROM_LE (binary->nodes [0].n_attrs); i++)
+    {
+      const Attr *attr = &binary->attrs [GUINT32_FROM_LE (binary->nodes [0].first_attr) + i];
+
+      g_object_set (repository,
+                    &binary->strings [GUINT32_FROM_LE (attr->name)],
+                    &binary->strings [GUINT32_FROM_LE (attr->value)],
+                    NULL);
+    }
+
+  defer_children (RTFM_GIR_PARSER_OBJECT (repository), binary, 0);
+  binary_unref (binary);
+
+  return repository;
+}
+
+typedef struct
+{
+  GArray     *nodes;
+  GArray     *attrs;
+  GString    *strings;
+  GHashTable *offsets;
+} Writer;
+
+static guint32
+writer_add_string (Writer      *writer,
+                   const gchar *str)
+{
+  gpointer value;
+  guint32 offset;
+
+  if (str == NULL)
+    return NO_STRING;
+
+  if (g_hash_table_lookup_extended (writer->offsets, str, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  offset = writer->strings->len;
+  g_string_append_len (writer->strings, str, strlen (str) + 1);
+  g_hash_table_insert (writer->offsets, g_strdup (str), GUINT_TO_POINTER (offset));
+
+  return offset;
+}
+
+static guint32
+lookup_node_type (GType type)
+{
+  guint32 i;
+
+  for (i = 0; i < G_N_ELEMENTS (node_types); i++)
+    {
+      if (node_types [i] () == type)
+        return i;
+    }
+
+  g_assert_not_reached ();
+
+  return 0;
+}
+
+static void
+writer_fill_node (Writer              *writer,
+                  guint32              node_id,
+                  RtfmGirParserObject *object)
+{
+  g_autofree GParamSpec **pspecs = NULL;
+  Node *node = &g_array_index (writer->nodes, Node, node_id);
+  const gchar *text = NULL;
+  guint n_pspecs = 0;
+  guint32 first_attr = writer->attrs->len;
+  guint i;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (object), &n_pspecs);
+
+  for (i = 0; i < n_pspecs; i++)
+    {
+      g_autofree gchar *value = NULL;
+      Attr attr;
+
+      if (pspecs [i]->value_type != G_TYPE_STRING ||
+          pspecs [i]->owner_type == RTFM_GIR_TYPE_PARSER_OBJECT)
+        continue;
+
+      g_object_get (object, pspecs [i]->name, &value, NULL);
+
+      if (value == NULL)
+        continue;
+
+      attr.name = GUINT32_TO_LE (writer_add_string (writer, pspecs [i]->name));
+      attr.value = GUINT32_TO_LE (writer_add_string (writer, value));
+      g_array_append_val (writer->attrs, attr);
+    }
+
+  if (RTFM_GIR_IS_DOC (object))
+    text = rtfm_gir_doc_get_text (RTFM_GIR_DOC (object));
+
+  /* The node may have moved as strings were added, so look it up again */
+  node = &g_array_index (writer->nodes, Node, node_id);
+  node->type = GUINT32_TO_LE (lookup_node_type (G_OBJECT_TYPE (object)));
+  node->text = GUINT32_TO_LE (writer_add_string (writer, text));
+  node->first_attr = GUINT32_TO_LE (first_attr);
+  node->n_attrs = GUINT32_TO_LE (writer->attrs->len - first_attr);
+}
+
+/**
+ * rtfm_gir_binary_write:
+ * @repository: A parsed #RtfmGirRepository
+ * @mtime: The mtime of the .gir file @repository was parsed from
+ * @path: Where to write the binary repository
+ * @error: A location for a #GError or %NULL
+ *
+ * Writes @repository so that rtfm_gir_binary_load() can map it instead
+ * of parsing the .gir file again. The file is replaced atomically.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_binary_write (RtfmGirRepository  *repository,
+                       guint64             mtime,
+                       const gchar        *path,
+                       GError            **error)
+{
+  g_autoptr(GPtrArray) queue = NULL;
+  g_autoptr(GByteArray) bytes = NULL;
+  Writer writer;
+  Header header = { { 0 } };
+  gboolean ret;
+  guint32 i;
+
+  g_return_val_if_fail (RTFM_GIR_IS_REPOSITORY (repository), FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  writer.nodes = g_array_new (FALSE, TRUE, sizeof (Node));
+  writer.attrs = g_array_new (FALSE, TRUE, sizeof (Attr));
+  writer.strings = g_string_new (NULL);
+  writer.offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  /*
+   * Breadth first, so that the children of each node are next to each
+   * other. The queue holds the object for each node id.
+   */
+  queue = g_ptr_array_new ();
+  g_ptr_array_add (queue, repository);
+  g_array_set_size (writer.nodes, 1);
+
+  for (i = 0; i < queue->len; i++)
+    {
+      RtfmGirParserObject *object = g_ptr_array_index (queue, i);
+      GPtrArray *children = rtfm_gir_parser_object_get_children (object);
+      Node *node;
+      guint32 first_child = queue->len;
+      guint32 n_children = children ? children->len : 0;
+      guint32 j;
+
+      writer_fill_node (&writer, i, object);
+
+      for (j = 0; j < n_children; j++)
+        g_ptr_array_add (queue, g_ptr_array_index (children, j));
+
+      g_array_set_size (writer.nodes, queue->len);
+
+      node = &g_array_index (writer.nodes, Node, i);
+      node->first_child = GUINT32_TO_LE (n_children ? first_child : 0);
+      node->n_children = GUINT32_TO_LE (n_children);
+    }
+
+  /* Keeps the tables that follow aligned */
+  while (writer.strings->len == 0 || writer.strings->len % 4 != 0)
+    g_string_append_c (writer.strings, '\0');
+
+  memcpy (header.magic, BINARY_MAGIC, BINARY_MAGIC_LEN);
+  header.version = GUINT32_TO_LE (BINARY_VERSION);
+  header.n_nodes = GUINT32_TO_LE (writer.nodes->len);
+  header.mtime = GUINT64_TO_LE (mtime);
+  header.n_attrs = GUINT32_TO_LE (writer.attrs->len);
+  header.strings_len = GUINT32_TO_LE (writer.strings->len);
+
+  bytes = g_byte_array_new ();
+  g_byte_array_append (bytes, (const guint8 *)&header, sizeof header);
+  g_byte_array_append (bytes, (const guint8 *)writer.nodes->data, writer.nodes->len * sizeof (Node));
+  g_byte_array_append (bytes, (const guint8 *)writer.attrs->data, writer.attrs->len * sizeof (Attr));
+  g_byte_array_append (bytes, (const guint8 *)writer.strings->str, writer.strings->len);
+
+  ret = g_file_set_contents (path, (const gchar *)bytes->data, bytes->len, error);
+
+  g_array_unref (writer.nodes);
+  g_array_unref (writer.attrs);
+  g_string_free (writer.strings, TRUE);
+  g_hash_table_unref (writer.offsets);
+
+  return ret;
+}
@@ -499,6 +499,10 @@ rtfm_gir_class_ingest (RtfmGirParserObject *object,
   self->abstract = rtfm_gir_parser_context_intern_string (parser_context, abstract);
   self->glib_fundamental = rtfm_gir_parser_context_intern_string (parser_context, glib_fundamental);
 
+  /* Members are parsed when the node is first browsed */
+  if (_rtfm_gir_parser_object_defer (RTFM_GIR_PARSER_OBJECT (self), context, element_name))
+    return TRUE;
+
   g_markup_parse_context_push (context, &markup_parser, self);
 
   return TRUE;
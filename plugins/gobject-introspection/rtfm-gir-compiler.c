@@ -16,181 +16,159 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+/*
+ * Compiles the search indexes for .gir files ahead of time, so that
+ * distributions can ship them next to the .gir files and nobody has to
+ * wait for them to be built on first use. The indexes are the same
+ * memory-mappable files that rtfm keeps in its cache, and are looked up
+ * in $(datadir)/rtfm/gobject-introspection by default. The parsed tree
+ * is written there too, so that browsing does not need the .gir parsed.
+ *
+ * Each file is compiled on its own, so --jobs does not change the
+ * output, which only depends on the contents and mtime of the .gir file.
+ */
+
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
 
 #include <glib/gi18n.h>
-#include <libxml/xmlreader.h>
-#include <rtfm.h>
 #include <stdlib.h>
 
-#include "rtfm-gir-repository.h"
-
-static void
-error_handler (void                    *arg,
-               const char              *msg,
-               xmlParserSeverities      severity,
-               xmlTextReaderLocatorPtr  locator)
-{
-  gchar **target = arg;
-  guint line;
-
-  g_free (*target);
-
-  line = xmlTextReaderLocatorLineNumber (locator);
-  *target = g_strdup_printf ("Line %d: %s", line, msg);
-}
+#include "rtfm-gir-file.h"
+#include "rtfm-gir-util.h"
 
-static inline gboolean
-is_element_named (xmlTextReaderPtr  reader,
-                  const gchar      *name)
+typedef struct
 {
-  g_assert (reader != NULL);
-  g_assert (name != NULL);
-
-  if (xmlTextReaderNodeType (reader) == XML_ELEMENT_NODE)
-    return (0 == g_strcmp0 (name, (gchar *)xmlTextReaderConstName (reader)));
-
-  return FALSE;
-}
+  GFile  *output;
+  GMutex  mutex;
+  guint   n_failed;
+} Compiler;
+
+static gint jobs;
+static gchar *output_dir;
+static gboolean verbose;
+
+static GOptionEntry entries[] = {
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs,
+    N_("The number of files to compile at once"),
+    N_("N") },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_dir,
+    N_("The directory to write compiled indexes to"),
+    N_("DIRECTORY") },
+  { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose,
+    N_("Print the name of each file as it is compiled") },
+  { NULL }
+};
 
 static void
-set_error_string (gchar       **dest,
-                  const gchar  *message)
+compile_worker (gpointer data,
+                gpointer user_data)
 {
-  g_free (*dest);
-  *dest = g_strdup (message);
-}
-
-static RtfmGirRepository *
-rtfm_gir_compiler_parse (xmlTextReaderPtr   reader,
-                         GError           **error)
-{
-  g_autoptr(RtfmGirRepository) repository = NULL;
-  gchar *error_string = NULL;
-  int r;
-
-  g_assert (reader != NULL);
-  g_assert (error != NULL);
-
-  xmlTextReaderSetErrorHandler (reader, error_handler, &error_string);
+  g_autoptr(GFile) file = data;
+  g_autoptr(RtfmGirFile) gir_file = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *path = NULL;
+  Compiler *compiler = user_data;
 
-skip_node:
-  r = xmlTextReaderNext (reader);
-  if (r <= 0)
-    goto return_new_error;
+  g_assert (G_IS_FILE (file));
+  g_assert (compiler != NULL);
 
-  if (xmlTextReaderNodeType (reader) == XML_COMMENT_NODE)
-    goto skip_node;
+  path = g_file_get_path (file);
+  gir_file = rtfm_gir_file_new (file);
 
-  if (!is_element_named (reader, "repository"))
+  if (!rtfm_gir_file_compile (gir_file, compiler->output, NULL, &error))
     {
-      set_error_string (&error_string, "Failed to locate repository node");
-      goto return_new_error;
+      g_mutex_lock (&compiler->mutex);
+      g_printerr ("%s: %s\n", path, error->message);
+      compiler->n_failed++;
+      g_mutex_unlock (&compiler->mutex);
+      return;
     }
 
-  repository = g_object_new (RTFM_TYPE_GIR_REPOSITORY, NULL);
-
-  if (!rtfm_gir_repository_ingest (repository, reader, error))
-    return FALSE;
-
-  return g_steal_pointer (&repository);
-
-return_new_error:
-  if (*error == NULL)
+  if (verbose)
     {
-      if (error_string)
-        g_set_error (error,
-                     G_FILE_ERROR,
-                     G_FILE_ERROR_FAILED,
-                     "%s", error_string);
-      else
-        g_set_error (error,
-                     G_FILE_ERROR,
-                     G_FILE_ERROR_FAILED,
-                     "An unknown error occurred");
+      g_mutex_lock (&compiler->mutex);
+      g_print ("%s\n", path);
+      g_mutex_unlock (&compiler->mutex);
     }
+}
 
-  return NULL;
+static gint
+compare_files (gconstpointer a,
+               gconstpointer b)
+{
+  g_autofree gchar *path_a = g_file_get_path (*(GFile * const *)a);
+  g_autofree gchar *path_b = g_file_get_path (*(GFile * const *)b);
+
+  return g_strcmp0 (path_a, path_b);
 }
 
+/*
+ * Adds @file, or the .gir files within it when it is a directory.
+ */
 static gboolean
-rtfm_gir_compiler_compile (GFile   *in_file,
-                           GFile   *out_file,
-                           GError **error)
+collect_files (GPtrArray  *files,
+               GFile      *file,
+               GError    **error)
 {
-  g_autoptr(RtfmGirRepository) repository = NULL;
-  g_autofree gchar *contents = NULL;
-  xmlTextReaderPtr reader;
-  gsize len;
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  gpointer infoptr;
 
-  g_assert (G_IS_FILE (in_file));
-  g_assert (G_IS_FILE (out_file));
-  g_assert (error != NULL);
+  if (g_file_query_file_type (file, G_FILE_QUERY_INFO_NONE, NULL) != G_FILE_TYPE_DIRECTORY)
+    {
+      g_autofree gchar *name = g_file_get_basename (file);
 
-  if (!g_file_load_contents (in_file, NULL, &contents, &len, NULL, error))
-    return FALSE;
+      if (!g_str_has_suffix (name, ".gir"))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_ARGUMENT,
+                       "\"%s\" does not look like a .gir file.",
+                       name);
+          return FALSE;
+        }
 
-  reader = xmlReaderForMemory (contents,
-                               len,
-                               NULL,
-                               NULL,
-                               (XML_PARSE_NOENT |
-                                XML_PARSE_NONET |
-                                XML_PARSE_NSCLEAN |
-                                XML_PARSE_COMPACT));
+      g_ptr_array_add (files, g_object_ref (file));
 
-  if (reader == NULL)
-    {
-      g_set_error (error,
-                   G_FILE_ERROR,
-                   G_FILE_ERROR_FAILED,
-                   "Failed to create XmlTextReader");
-      return FALSE;
+      return TRUE;
     }
 
-  repository = rtfm_gir_compiler_parse (reader, error);
+  enumerator = g_file_enumerate_children (file,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                          G_FILE_QUERY_INFO_NONE,
+                                          NULL,
+                                          error);
 
-  if (repository == NULL)
+  if (enumerator == NULL)
     return FALSE;
 
-  return TRUE;
-
-#if 0
-  return g_file_replace_contents (out_file,
-                                  g_variant_get_data (variant),
-                                  g_variant_get_size (variant),
-                                  NULL,
-                                  FALSE,
-                                  G_FILE_CREATE_REPLACE_DESTINATION,
-                                  NULL,
-                                  NULL,
-                                  error);
-#endif
+  while (NULL != (infoptr = g_file_enumerator_next_file (enumerator, NULL, error)))
+    {
+      g_autoptr(GFileInfo) info = infoptr;
+      const gchar *name = g_file_info_get_name (info);
+
+      if (g_str_has_suffix (name, ".gir") &&
+          g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR)
+        g_ptr_array_add (files, g_file_get_child (file, name));
+    }
+
+  return error == NULL || *error == NULL;
 }
 
 gint
 main (gint   argc,
       gchar *argv[])
 {
-  g_autofree gchar *library_version = NULL;
-  GOptionEntry entries[] = {
-    { "library-version", 0, 0, G_OPTION_ARG_STRING, &library_version,
-      N_("The version of the library or program .gir"),
-      N_("VERSION") },
-    { NULL }
-  };
-
   g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GPtrArray) files = NULL;
   g_autoptr(GError) error = NULL;
-  g_autoptr(GFile) file = NULL;
-  g_autoptr(GFile) parent = NULL;
-  g_autoptr(GFile) outfile = NULL;
-  g_autofree gchar *basename = NULL;
-  g_autofree gchar *outbasename = NULL;
+  GThreadPool *pool;
+  Compiler compiler = { 0 };
+  guint i;
 
-  context = g_option_context_new (_("GIR_FILE - generate documentation for a .gir file"));
+  context = g_option_context_new (_("PATH… - compile the search indexes of .gir files"));
   g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
 
   if (!g_option_context_parse (context, &argc, &argv, &error))
@@ -199,39 +177,57 @@ main (gint   argc,
       return EXIT_FAILURE;
     }
 
-  if (argc != 2)
+  if (argc < 2)
     {
       g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
       g_printerr ("%s\n", help);
       return EXIT_FAILURE;
     }
 
-  if (!g_str_has_suffix (argv[1], ".gir"))
-    {
-      g_printerr ("\"%s\" does not look like a .gir file.\n", argv[1]);
-      return EXIT_FAILURE;
-    }
+  if (jobs <= 0)
+    jobs = g_get_num_processors ();
+
+  /* The static ranks must not depend on who runs the compiler */
+  rtfm_gir_disable_popularity ();
 
-  file = g_file_new_for_commandline_arg (argv[1]);
+  files = g_ptr_array_new_with_free_func (g_object_unref);
 
-  if (!g_file_query_exists (file, NULL) ||
-      g_file_query_file_type (file, 0, NULL) != G_FILE_TYPE_REGULAR)
+  for (i = 1; i < (guint)argc; i++)
     {
-      g_autofree gchar *filename = g_file_get_path (file);
-      g_printerr ("Invalid file: %s\n", filename);
-      return EXIT_FAILURE;
+      g_autoptr(GFile) file = g_file_new_for_commandline_arg (argv [i]);
+
+      if (!collect_files (files, file, &error))
+        {
+          g_printerr ("%s: %s\n", argv [i], error->message);
+          return EXIT_FAILURE;
+        }
     }
 
-  parent = g_file_get_parent (file);
-  basename = g_file_get_basename (file);
-  outbasename = g_strdup_printf ("%s.rtfm", basename);
-  outfile = g_file_get_child (parent, outbasename);
+  /* Compile in a predictable order, which makes failures easier to follow */
+  g_ptr_array_sort (files, compare_files);
+
+  compiler.output = g_file_new_for_commandline_arg (output_dir ? output_dir : RTFM_GIR_COMPILED_DIR);
+  g_mutex_init (&compiler.mutex);
 
-  if (!rtfm_gir_compiler_compile (file, outfile, &error))
+  if (!g_file_make_directory_with_parents (compiler.output, NULL, &error) &&
+      !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
     {
       g_printerr ("%s\n", error->message);
       return EXIT_FAILURE;
     }
 
-  return EXIT_SUCCESS;
+  g_clear_error (&error);
+
+  pool = g_thread_pool_new (compile_worker, &compiler, jobs, TRUE, NULL);
+
+  for (i = 0; i < files->len; i++)
+    g_thread_pool_push (pool, g_object_ref (g_ptr_array_index (files, i)), NULL);
+
+  /* Waits for every file to be compiled */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  g_clear_object (&compiler.output);
+  g_mutex_clear (&compiler.mutex);
+
+  return compiler.n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,365 @@
+/* rtfm-gir-doc-index-builder.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "rtfm-gir-doc-index-builder"
+
+#include <string.h>
+
+#include "rtfm-gir-doc-index.h"
+#include "rtfm-gir-doc-index-builder.h"
+
+struct _RtfmGirDocIndexBuilder
+{
+  GObject     parent_instance;
+
+  /*
+   * The documents in insertion order. The position within the array is
+   * the document id used by the postings.
+   */
+  GPtrArray  *documents;
+
+  /* The number of tokens found in each document, for BM25 length norms. */
+  GArray     *lengths;
+
+  /*
+   * Maps a casefolded term to a GArray of Posting. Since documents are
+   * inserted in increasing order, the postings are always sorted by
+   * document id, which is what allows us to delta-encode them.
+   */
+  GHashTable *terms;
+
+  /* Total number of tokens across all documents. */
+  guint64     n_tokens;
+
+  GHashTable *metadata;
+};
+
+typedef struct
+{
+  guint document_id;
+  guint frequency;
+} Posting;
+
+G_DEFINE_TYPE (RtfmGirDocIndexBuilder, rtfm_gir_doc_index_builder, G_TYPE_OBJECT)
+
+static void
+rtfm_gir_doc_index_builder_finalize (GObject *object)
+{
+  RtfmGirDocIndexBuilder *self = (RtfmGirDocIndexBuilder *)object;
+
+  g_clear_pointer (&self->documents, g_ptr_array_unref);
+  g_clear_pointer (&self->lengths, g_array_unref);
+  g_clear_pointer (&self->terms, g_hash_table_unref);
+  g_clear_pointer (&self->metadata, g_hash_table_unref);
+
+  G_OBJECT_CLASS (rtfm_gir_doc_index_builder_parent_class)->finalize (object);
+}
+
+static void
+rtfm_gir_doc_index_builder_class_init (RtfmGirDocIndexBuilderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = rtfm_gir_doc_index_builder_finalize;
+}
+
+static void
+rtfm_gir_doc_index_builder_init (RtfmGirDocIndexBuilder *self)
+{
+  self->documents = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+  self->lengths = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->terms = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+  self->metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_variant_unref);
+}
+
+RtfmGirDocIndexBuilder *
+rtfm_gir_doc_index_builder_new (void)
+{
+  return g_object_new (RTFM_GIR_TYPE_DOC_INDEX_BUILDER, NULL);
+}
+
+/**
+ * rtfm_gir_doc_index_builder_insert:
+ * @self: A #RtfmGirDocIndexBuilder
+ * @text: The documentation text to tokenize
+ * @document: The document to return for matches of @text
+ *
+ * Tokenizes @text and adds postings for each term found to @document.
+ *
+ * If @document is floating, it's floating reference will be sunk.
+ */
+void
+rtfm_gir_doc_index_builder_insert (RtfmGirDocIndexBuilder *self,
+                                   const gchar            *text,
+                                   GVariant               *document)
+{
+  g_autoptr(GHashTable) counts = NULL;
+  g_auto(GStrv) tokens = NULL;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint document_id;
+  guint length;
+  guint i;
+
+  g_return_if_fail (RTFM_GIR_IS_DOC_INDEX_BUILDER (self));
+  g_return_if_fail (text != NULL);
+  g_return_if_fail (document != NULL);
+
+  tokens = rtfm_gir_doc_index_tokenize (text);
+  length = g_strv_length (tokens);
+
+  if (length == 0)
+    {
+      g_variant_unref (g_variant_ref_sink (document));
+      return;
+    }
+
+  document_id = self->documents->len;
+  g_ptr_array_add (self->documents, g_variant_ref_sink (document));
+  g_array_append_val (self->lengths, length);
+  self->n_tokens += length;
+
+  counts = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; tokens [i] != NULL; i++)
+    {
+      guint count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, tokens [i]));
+      g_hash_table_insert (counts, tokens [i], GUINT_TO_POINTER (count + 1));
+    }
+
+  g_hash_table_iter_init (&iter, counts);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      Posting posting = { document_id, GPOINTER_TO_UINT (value) };
+      GArray *postings;
+
+      if (NULL == (postings = g_hash_table_lookup (self->terms, key)))
+        {
+          postings = g_array_new (FALSE, FALSE, sizeof (Posting));
+          g_hash_table_insert (self->terms, g_strdup (key), postings);
+        }
+
+      g_array_append_val (postings, posting);
+    }
+}
+
+void
+rtfm_gir_doc_index_builder_set_metadata (RtfmGirDocIndexBuilder *self,
+                                         const gchar            *key,
+                                         GVariant               *value)
+{
+  g_return_if_fail (RTFM_GIR_IS_DOC_INDEX_BUILDER (self));
+  g_return_if_fail (key != NULL);
+
+  if (value != NULL)
+    g_hash_table_insert (self->metadata, g_strdup (key), g_variant_ref_sink (value));
+  else
+    g_hash_table_remove (self->metadata, key);
+}
+
+static void
+append_varint (GByteArray *bytes,
+               guint       value)
+{
+  do
+    {
+      guint8 byte = value & 0x7F;
+
+      value >>= 7;
+
+      if (value != 0)
+        byte |= 0x80;
+
+      g_byte_array_append (bytes, &byte, 1);
+    }
+  while (value != 0);
+}
+
+static gint
+compare_terms (gconstpointer a,
+               gconstpointer b)
+{
+  return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static GVariant *
+rtfm_gir_doc_index_builder_build_metadata (RtfmGirDocIndexBuilder *self)
+{
+  GVariantDict dict;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_assert (RTFM_GIR_IS_DOC_INDEX_BUILDER (self));
+
+  g_variant_dict_init (&dict, NULL);
+
+  g_hash_table_iter_init (&iter, self->metadata);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_variant_dict_insert_value (&dict, key, value);
+
+  return g_variant_dict_end (&dict);
+}
+
+static GVariant *
+rtfm_gir_doc_index_builder_build (RtfmGirDocIndexBuilder *self)
+{
+  g_autoptr(GPtrArray) sorted = NULL;
+  g_autoptr(GArray) doc_freq = NULL;
+  GVariantBuilder postings;
+  GVariantBuilder documents;
+  GVariantDict dict;
+  GHashTableIter iter;
+  gpointer key;
+  gdouble avgdl = 0.0;
+  guint i;
+
+  g_assert (RTFM_GIR_IS_DOC_INDEX_BUILDER (self));
+
+  /* Terms are sorted so that the reader can binary search them */
+  sorted = g_ptr_array_sized_new (g_hash_table_size (self->terms));
+  g_hash_table_iter_init (&iter, self->terms);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_ptr_array_add (sorted, key);
+  g_ptr_array_sort (sorted, compare_terms);
+
+  doc_freq = g_array_sized_new (FALSE, FALSE, sizeof (guint), sorted->len);
+
+  /*
+   * Each posting list is a run of varint encoded (document id delta,
+   * term frequency) pairs. The delta is from the previous document in
+   * the same list, which keeps most entries to a single byte.
+   */
+  g_variant_builder_init (&postings, G_VARIANT_TYPE ("aay"));
+
+  for (i = 0; i < sorted->len; i++)
+    {
+      g_autoptr(GByteArray) bytes = g_byte_array_new ();
+      GArray *list = g_hash_table_lookup (self->terms, g_ptr_array_index (sorted, i));
+      guint last_id = 0;
+      guint j;
+
+      for (j = 0; j < list->len; j++)
+        {
+          const Posting *posting = &g_array_index (list, Posting, j);
+
+          append_varint (bytes, posting->document_id - last_id);
+          append_varint (bytes, posting->frequency);
+          last_id = posting->document_id;
+        }
+
+      g_array_append_val (doc_freq, list->len);
+      g_variant_builder_add_value (&postings,
+                                   g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE,
+                                                              bytes->data,
+                                                              bytes->len,
+                                                              1));
+    }
+
+  g_variant_builder_init (&documents, G_VARIANT_TYPE ("av"));
+  for (i = 0; i < self->documents->len; i++)
+    g_variant_builder_add (&documents, "v", g_ptr_array_index (self->documents, i));
+
+  if (self->documents->len > 0)
+    avgdl = (gdouble)self->n_tokens / (gdouble)self->documents->len;
+
+  g_variant_dict_init (&dict, NULL);
+  g_variant_dict_insert (&dict, "version", "i", 1);
+  g_variant_dict_insert_value (&dict, "metadata", rtfm_gir_doc_index_builder_build_metadata (self));
+  g_variant_dict_insert (&dict, "avgdl", "d", avgdl);
+  g_variant_dict_insert_value (&dict, "terms",
+                               g_variant_new_strv ((const gchar * const *)sorted->pdata, sorted->len));
+  g_variant_dict_insert_value (&dict, "postings", g_variant_builder_end (&postings));
+  g_variant_dict_insert_value (&dict, "doc-freq",
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                          doc_freq->data,
+                                                          doc_freq->len,
+                                                          sizeof (guint)));
+  g_variant_dict_insert_value (&dict, "lengths",
+                               g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                          self->lengths->data,
+                                                          self->lengths->len,
+                                                          sizeof (guint)));
+  g_variant_dict_insert_value (&dict, "documents", g_variant_builder_end (&documents));
+
+  return g_variant_dict_end (&dict);
+}
+
+/**
+ * rtfm_gir_doc_index_builder_write:
+ * @self: A #RtfmGirDocIndexBuilder
+ * @file: A #GFile to write the index to
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Builds the inverted index and writes it to @file so that it may be
+ * loaded with rtfm_gir_doc_index_load_file().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_doc_index_builder_write (RtfmGirDocIndexBuilder  *self,
+                                  GFile                   *file,
+                                  GCancellable            *cancellable,
+                                  GError                 **error)
+{
+  g_autoptr(GVariant) variant = NULL;
+
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX_BUILDER (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  variant = g_variant_ref_sink (rtfm_gir_doc_index_builder_build (self));
+
+  return g_file_replace_contents (file,
+                                  g_variant_get_data (variant),
+                                  g_variant_get_size (variant),
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_NONE,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
+
+/**
+ * rtfm_gir_doc_index_builder_build_index:
+ * @self: A #RtfmGirDocIndexBuilder
+ *
+ * Builds the inverted index in memory so that it may be queried right
+ * away. Use rtfm_gir_doc_index_write() to save it to disk afterwards.
+ *
+ * Returns: (transfer full): A #RtfmGirDocIndex
+ */
+RtfmGirDocIndex *
+rtfm_gir_doc_index_builder_build_index (RtfmGirDocIndexBuilder *self)
+{
+  g_autoptr(RtfmGirDocIndex) index = NULL;
+  g_autoptr(GVariant) variant = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX_BUILDER (self), NULL);
+
+  variant = g_variant_ref_sink (rtfm_gir_doc_index_builder_build (self));
+  index = rtfm_gir_doc_index_new ();
+
+  if (!rtfm_gir_doc_index_load_variant (index, variant, &error))
+    g_critical ("Failed to load built index: %s", error->message);
+
+  return g_steal_pointer (&index);
+}
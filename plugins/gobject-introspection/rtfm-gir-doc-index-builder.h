@@ -0,0 +1,47 @@
+/* rtfm-gir-doc-index-builder.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTFM_GIR_DOC_INDEX_BUILDER_H
+#define RTFM_GIR_DOC_INDEX_BUILDER_H
+
+#include <gio/gio.h>
+
+#include "rtfm-gir-doc-index.h"
+
+G_BEGIN_DECLS
+
+#define RTFM_GIR_TYPE_DOC_INDEX_BUILDER (rtfm_gir_doc_index_builder_get_type())
+
+G_DECLARE_FINAL_TYPE (RtfmGirDocIndexBuilder, rtfm_gir_doc_index_builder, RTFM_GIR, DOC_INDEX_BUILDER, GObject)
+
+RtfmGirDocIndexBuilder *rtfm_gir_doc_index_builder_new          (void);
+void                    rtfm_gir_doc_index_builder_insert       (RtfmGirDocIndexBuilder  *self,
+                                                                 const gchar             *text,
+                                                                 GVariant                *document);
+void                    rtfm_gir_doc_index_builder_set_metadata (RtfmGirDocIndexBuilder  *self,
+                                                                 const gchar             *key,
+                                                                 GVariant                *value);
+RtfmGirDocIndex        *rtfm_gir_doc_index_builder_build_index  (RtfmGirDocIndexBuilder  *self);
+gboolean                rtfm_gir_doc_index_builder_write        (RtfmGirDocIndexBuilder  *self,
+                                                                 GFile                   *file,
+                                                                 GCancellable            *cancellable,
+                                                                 GError                 **error);
+
+G_END_DECLS
+
+#endif /* RTFM_GIR_DOC_INDEX_BUILDER_H */
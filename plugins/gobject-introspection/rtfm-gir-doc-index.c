@@ -0,0 +1,798 @@
+/* rtfm-gir-doc-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define G_LOG_DOMAIN "rtfm-gir-doc-index"
+
+#include <fuzzy-glib.h>
+#include <math.h>
+#include <rtfm.h>
+#include <string.h>
+
+#include "rtfm-gir-doc-index.h"
+
+/* Standard BM25 tuning parameters */
+#define BM25_K1 1.2
+#define BM25_B  0.75
+
+/* Tokens outside of this range are not worth indexing */
+#define MIN_TOKEN_LEN 2
+#define MAX_TOKEN_LEN 64
+
+/*
+ * The last word of the query is treated as a prefix so that results
+ * show up while typing. This bounds how many terms it may expand to.
+ */
+#define MAX_PREFIX_EXPANSION 32
+
+struct _RtfmGirDocIndex
+{
+  GObject        parent_instance;
+
+  guint          loaded : 1;
+
+  GMappedFile   *mapped_file;
+  GVariant      *variant;
+
+  /* Sorted "as" of every term in the index */
+  GVariant      *terms;
+
+  /* "aay" of varint encoded postings, parallel to @terms */
+  GVariant      *postings;
+
+  /* "au" containing the number of documents for each term */
+  GVariant      *doc_freq;
+  const guint   *doc_freq_raw;
+  gsize          n_terms;
+
+  /* "au" containing the number of tokens in each document */
+  GVariant      *lengths;
+  const guint   *lengths_raw;
+  gsize          n_documents;
+
+  /* "av" of documents, indexed by document id */
+  GVariant      *documents;
+
+  GVariantDict  *metadata;
+
+  /* Where queries run, or %NULL for the default scheduler */
+  RtfmScheduler *scheduler;
+
+  gdouble        avgdl;
+};
+
+typedef struct
+{
+  gchar *query;
+  guint  max_matches;
+} QueryState;
+
+typedef struct
+{
+  guint  document_id;
+  gfloat score;
+} DocScore;
+
+G_DEFINE_TYPE (RtfmGirDocIndex, rtfm_gir_doc_index, G_TYPE_OBJECT)
+
+static const gchar *stop_words[] = {
+  "a", "an", "and", "are", "as", "at", "be", "by", "for", "from", "if",
+  "in", "is", "it", "its", "of", "on", "or", "that", "the", "this", "to",
+  "was", "will", "with",
+};
+
+static void
+query_state_free (gpointer data)
+{
+  QueryState *state = data;
+
+  g_free (state->query);
+  g_slice_free (QueryState, state);
+}
+
+static gboolean
+is_stop_word (const gchar *word)
+{
+  static GHashTable *words;
+
+  if (g_once_init_enter (&words))
+    {
+      GHashTable *table = g_hash_table_new (g_str_hash, g_str_equal);
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (stop_words); i++)
+        g_hash_table_add (table, (gchar *)stop_words [i]);
+
+      g_once_init_leave (&words, table);
+    }
+
+  return g_hash_table_contains (words, word);
+}
+
+/**
+ * rtfm_gir_doc_index_tokenize:
+ * @text: The text to tokenize
+ *
+ * Splits @text into casefolded terms. Words are runs of alphanumeric
+ * characters, so identifiers such as "gtk_widget_show" are split into
+ * their parts. Stop words and very short or long words are dropped.
+ *
+ * This is used both when building and when querying the index.
+ *
+ * Returns: (transfer full): A %NULL-terminated array of terms.
+ */
+gchar **
+rtfm_gir_doc_index_tokenize (const gchar *text)
+{
+  GPtrArray *ar;
+  const gchar *begin = NULL;
+  const gchar *iter;
+
+  ar = g_ptr_array_new ();
+
+  if (text == NULL)
+    goto finish;
+
+  for (iter = text; ; iter = g_utf8_next_char (iter))
+    {
+      gunichar ch = g_utf8_get_char (iter);
+
+      if (ch != 0 && g_unichar_isalnum (ch))
+        {
+          if (begin == NULL)
+            begin = iter;
+          continue;
+        }
+
+      if (begin != NULL)
+        {
+          glong len = g_utf8_strlen (begin, iter - begin);
+
+          if (len >= MIN_TOKEN_LEN && len <= MAX_TOKEN_LEN)
+            {
+              gchar *term = g_utf8_casefold (begin, iter - begin);
+
+              if (is_stop_word (term))
+                g_free (term);
+              else
+                g_ptr_array_add (ar, term);
+            }
+
+          begin = NULL;
+        }
+
+      if (ch == 0)
+        break;
+    }
+
+finish:
+  g_ptr_array_add (ar, NULL);
+
+  return (gchar **)g_ptr_array_free (ar, FALSE);
+}
+
+static void
+rtfm_gir_doc_index_finalize (GObject *object)
+{
+  RtfmGirDocIndex *self = (RtfmGirDocIndex *)object;
+
+  g_clear_pointer (&self->terms, g_variant_unref);
+  g_clear_pointer (&self->postings, g_variant_unref);
+  g_clear_pointer (&self->doc_freq, g_variant_unref);
+  g_clear_pointer (&self->lengths, g_variant_unref);
+  g_clear_pointer (&self->documents, g_variant_unref);
+  g_clear_pointer (&self->metadata, g_variant_dict_unref);
+  g_clear_pointer (&self->variant, g_variant_unref);
+  g_clear_pointer (&self->mapped_file, g_mapped_file_unref);
+  g_clear_object (&self->scheduler);
+
+  G_OBJECT_CLASS (rtfm_gir_doc_index_parent_class)->finalize (object);
+}
+
+static void
+rtfm_gir_doc_index_class_init (RtfmGirDocIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = rtfm_gir_doc_index_finalize;
+}
+
+static void
+rtfm_gir_doc_index_init (RtfmGirDocIndex *self)
+{
+}
+
+RtfmGirDocIndex *
+rtfm_gir_doc_index_new (void)
+{
+  return g_object_new (RTFM_GIR_TYPE_DOC_INDEX, NULL);
+}
+
+/**
+ * rtfm_gir_doc_index_set_scheduler:
+ * @self: A #RtfmGirDocIndex
+ * @scheduler: (nullable): A #RtfmScheduler, or %NULL for the default one
+ *
+ * Sets the scheduler that queries of @self run on.
+ */
+void
+rtfm_gir_doc_index_set_scheduler (RtfmGirDocIndex *self,
+                                  RtfmScheduler   *scheduler)
+{
+  g_return_if_fail (RTFM_GIR_IS_DOC_INDEX (self));
+  g_return_if_fail (!scheduler || RTFM_IS_SCHEDULER (scheduler));
+
+  g_set_object (&self->scheduler, scheduler);
+}
+
+static gboolean
+rtfm_gir_doc_index_set_variant (RtfmGirDocIndex  *self,
+                                GVariant         *variant,
+                                GError          **error)
+{
+  g_autoptr(GVariant) terms = NULL;
+  g_autoptr(GVariant) postings = NULL;
+  g_autoptr(GVariant) doc_freq = NULL;
+  g_autoptr(GVariant) lengths = NULL;
+  g_autoptr(GVariant) documents = NULL;
+  g_autoptr(GVariant) metadata = NULL;
+  GVariantDict dict;
+  gdouble avgdl = 0.0;
+  gint version = 0;
+
+  g_assert (RTFM_GIR_IS_DOC_INDEX (self));
+  g_assert (variant != NULL);
+
+  g_variant_dict_init (&dict, variant);
+
+  if (!g_variant_dict_lookup (&dict, "version", "i", &version) || version != 1)
+    {
+      g_variant_dict_clear (&dict);
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Version mismatch in gvariant. Got %d, expected 1",
+                   version);
+      return FALSE;
+    }
+
+  g_variant_dict_lookup (&dict, "avgdl", "d", &avgdl);
+  terms = g_variant_dict_lookup_value (&dict, "terms", G_VARIANT_TYPE_STRING_ARRAY);
+  postings = g_variant_dict_lookup_value (&dict, "postings", G_VARIANT_TYPE ("aay"));
+  doc_freq = g_variant_dict_lookup_value (&dict, "doc-freq", G_VARIANT_TYPE ("au"));
+  lengths = g_variant_dict_lookup_value (&dict, "lengths", G_VARIANT_TYPE ("au"));
+  documents = g_variant_dict_lookup_value (&dict, "documents", G_VARIANT_TYPE ("av"));
+  metadata = g_variant_dict_lookup_value (&dict, "metadata", G_VARIANT_TYPE_VARDICT);
+  g_variant_dict_clear (&dict);
+
+  if (terms == NULL || postings == NULL || doc_freq == NULL ||
+      lengths == NULL || documents == NULL || metadata == NULL ||
+      g_variant_n_children (terms) != g_variant_n_children (postings) ||
+      g_variant_n_children (terms) != g_variant_n_children (doc_freq) ||
+      g_variant_n_children (lengths) != g_variant_n_children (documents))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Invalid gvariant index");
+      return FALSE;
+    }
+
+  self->variant = g_variant_ref_sink (variant);
+  self->terms = g_steal_pointer (&terms);
+  self->postings = g_steal_pointer (&postings);
+  self->doc_freq = g_steal_pointer (&doc_freq);
+  self->lengths = g_steal_pointer (&lengths);
+  self->documents = g_steal_pointer (&documents);
+  self->metadata = g_variant_dict_new (metadata);
+  self->avgdl = avgdl > 0.0 ? avgdl : 1.0;
+
+  self->doc_freq_raw = g_variant_get_fixed_array (self->doc_freq, &self->n_terms, sizeof (guint));
+  self->lengths_raw = g_variant_get_fixed_array (self->lengths, &self->n_documents, sizeof (guint));
+
+  return TRUE;
+}
+
+/**
+ * rtfm_gir_doc_index_load_file:
+ * @self: A #RtfmGirDocIndex
+ * @file: A local #GFile written by rtfm_gir_doc_index_builder_write()
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Maps @file into memory. Postings are decoded directly from the
+ * mapping at query time, so loading does not read the whole index.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_doc_index_load_file (RtfmGirDocIndex  *self,
+                              GFile            *file,
+                              GCancellable     *cancellable,
+                              GError          **error)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr(GMappedFile) mapped_file = NULL;
+  g_autoptr(GVariant) variant = NULL;
+
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  if (self->loaded)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Cannot load index multiple times");
+      return FALSE;
+    }
+
+  self->loaded = TRUE;
+
+  if (!g_file_is_native (file) || NULL == (path = g_file_get_path (file)))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVALID_FILENAME,
+                   "Index must be a local file");
+      return FALSE;
+    }
+
+  if (NULL == (mapped_file = g_mapped_file_new (path, FALSE, error)))
+    return FALSE;
+
+  variant = g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE_VARDICT,
+                                                         g_mapped_file_get_contents (mapped_file),
+                                                         g_mapped_file_get_length (mapped_file),
+                                                         FALSE, NULL, NULL));
+
+  if (!rtfm_gir_doc_index_set_variant (self, variant, error))
+    return FALSE;
+
+  self->mapped_file = g_steal_pointer (&mapped_file);
+
+  return TRUE;
+}
+
+/**
+ * rtfm_gir_doc_index_load_variant:
+ * @self: A #RtfmGirDocIndex
+ * @variant: The index as built by #RtfmGirDocIndexBuilder
+ * @error: A location for a #GError or %NULL
+ *
+ * Loads the index from @variant, which is kept in memory. This is used
+ * by rtfm_gir_doc_index_builder_build_index() so that a freshly built
+ * index can be queried before it has been written to disk.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_doc_index_load_variant (RtfmGirDocIndex  *self,
+                                 GVariant         *variant,
+                                 GError          **error)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX (self), FALSE);
+  g_return_val_if_fail (variant != NULL, FALSE);
+
+  if (self->loaded)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_INVAL,
+                   "Cannot load index multiple times");
+      return FALSE;
+    }
+
+  self->loaded = TRUE;
+
+  return rtfm_gir_doc_index_set_variant (self, variant, error);
+}
+
+/**
+ * rtfm_gir_doc_index_write:
+ * @self: A #RtfmGirDocIndex
+ * @file: A #GFile to write the index to
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Writes a loaded index to @file so that it may later be loaded with
+ * rtfm_gir_doc_index_load_file().
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_doc_index_write (RtfmGirDocIndex  *self,
+                          GFile            *file,
+                          GCancellable     *cancellable,
+                          GError          **error)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (file), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  if (self->variant == NULL)
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_INITIALIZED,
+                   "The index has not been loaded");
+      return FALSE;
+    }
+
+  return g_file_replace_contents (file,
+                                  g_variant_get_data (self->variant),
+                                  g_variant_get_size (self->variant),
+                                  NULL,
+                                  FALSE,
+                                  G_FILE_CREATE_NONE,
+                                  NULL,
+                                  cancellable,
+                                  error);
+}
+
+/**
+ * rtfm_gir_doc_index_get_metadata:
+ *
+ * Looks up the metadata for @key.
+ *
+ * Returns: (transfer full) (nullable): A #GVariant or %NULL.
+ */
+GVariant *
+rtfm_gir_doc_index_get_metadata (RtfmGirDocIndex *self,
+                                 const gchar     *key)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX (self), NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  if (self->metadata != NULL)
+    return g_variant_dict_lookup_value (self->metadata, key, NULL);
+
+  return NULL;
+}
+
+guint32
+rtfm_gir_doc_index_get_metadata_uint32 (RtfmGirDocIndex *self,
+                                        const gchar     *key)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  ret = rtfm_gir_doc_index_get_metadata (self, key);
+
+  if (ret != NULL && g_variant_is_of_type (ret, G_VARIANT_TYPE_UINT32))
+    return g_variant_get_uint32 (ret);
+
+  return 0;
+}
+
+guint64
+rtfm_gir_doc_index_get_metadata_uint64 (RtfmGirDocIndex *self,
+                                        const gchar     *key)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  ret = rtfm_gir_doc_index_get_metadata (self, key);
+
+  if (ret != NULL && g_variant_is_of_type (ret, G_VARIANT_TYPE_UINT64))
+    return g_variant_get_uint64 (ret);
+
+  return 0;
+}
+
+const gchar *
+rtfm_gir_doc_index_get_metadata_string (RtfmGirDocIndex *self,
+                                        const gchar     *key)
+{
+  g_autoptr(GVariant) ret = NULL;
+
+  ret = rtfm_gir_doc_index_get_metadata (self, key);
+
+  /* Safe, as the string points into our mmap()'d region */
+  if (ret != NULL && g_variant_is_of_type (ret, G_VARIANT_TYPE_STRING))
+    return g_variant_get_string (ret, NULL);
+
+  return NULL;
+}
+
+static const gchar *
+rtfm_gir_doc_index_get_term (RtfmGirDocIndex *self,
+                             gsize            term_id)
+{
+  const gchar *term = NULL;
+
+  g_variant_get_child (self->terms, term_id, "&s", &term);
+
+  return term;
+}
+
+/* Returns the position of the first term that is >= @word */
+static gsize
+rtfm_gir_doc_index_lower_bound (RtfmGirDocIndex *self,
+                                const gchar     *word)
+{
+  gsize lo = 0;
+  gsize hi = self->n_terms;
+
+  while (lo < hi)
+    {
+      gsize mid = lo + ((hi - lo) / 2);
+
+      if (strcmp (rtfm_gir_doc_index_get_term (self, mid), word) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static gboolean
+read_varint (const guint8 **data,
+             const guint8  *end,
+             guint         *value)
+{
+  guint shift = 0;
+
+  *value = 0;
+
+  while (*data < end && shift < 32)
+    {
+      guint8 byte = *(*data)++;
+
+      *value |= (guint)(byte & 0x7F) << shift;
+
+      if ((byte & 0x80) == 0)
+        return TRUE;
+
+      shift += 7;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Adds the BM25 contribution of @term_id, multiplied by @weight, to
+ * the score of every document in its posting list.
+ */
+static void
+rtfm_gir_doc_index_score_term (RtfmGirDocIndex *self,
+                               gsize            term_id,
+                               gdouble          weight,
+                               gfloat          *scores)
+{
+  g_autoptr(GVariant) postings = NULL;
+  const guint8 *data;
+  const guint8 *end;
+  gdouble idf;
+  gsize len;
+  guint df;
+  guint document_id = 0;
+
+  g_assert (RTFM_GIR_IS_DOC_INDEX (self));
+  g_assert (term_id < self->n_terms);
+  g_assert (scores != NULL);
+
+  df = self->doc_freq_raw [term_id];
+  idf = log (1.0 + (((gdouble)self->n_documents - df + 0.5) / (df + 0.5)));
+
+  postings = g_variant_get_child_value (self->postings, term_id);
+  data = g_variant_get_fixed_array (postings, &len, 1);
+  end = data + len;
+
+  while (data < end)
+    {
+      guint delta;
+      guint tf;
+      gdouble norm;
+
+      if (!read_varint (&data, end, &delta) || !read_varint (&data, end, &tf))
+        break;
+
+      document_id += delta;
+
+      if G_UNLIKELY (document_id >= self->n_documents)
+        break;
+
+      norm = 1.0 - BM25_B + (BM25_B * self->lengths_raw [document_id] / self->avgdl);
+      scores [document_id] += weight * idf * ((tf * (BM25_K1 + 1.0)) / (tf + (BM25_K1 * norm)));
+    }
+}
+
+static gint
+doc_score_compare (gconstpointer a,
+                   gconstpointer b)
+{
+  const DocScore *da = a;
+  const DocScore *db = b;
+
+  if (da->score < db->score)
+    return 1;
+  else if (da->score > db->score)
+    return -1;
+
+  return (da->document_id > db->document_id) - (da->document_id < db->document_id);
+}
+
+static void
+rtfm_gir_doc_index_query_worker (GTask        *task,
+                                 gpointer      source_object,
+                                 gpointer      task_data,
+                                 GCancellable *cancellable)
+{
+  RtfmGirDocIndex *self = source_object;
+  QueryState *state = task_data;
+  g_autoptr(GListStore) store = NULL;
+  g_autoptr(GArray) ranked = NULL;
+  g_auto(GStrv) words = NULL;
+  g_autofree gfloat *scores = NULL;
+  gboolean last_is_prefix;
+  guint n_words;
+  guint i;
+
+  g_assert (G_IS_TASK (task));
+  g_assert (RTFM_GIR_IS_DOC_INDEX (self));
+  g_assert (state != NULL);
+
+  /* Superseded searches may be cancelled while still queued */
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  store = g_list_store_new (FUZZY_TYPE_INDEX_MATCH);
+
+  words = rtfm_gir_doc_index_tokenize (state->query);
+  n_words = g_strv_length (words);
+
+  if (n_words == 0 || self->n_documents == 0 || self->n_terms == 0)
+    goto finish;
+
+  /* Only expand the last word if the user is still typing it */
+  last_is_prefix = !g_unichar_isspace (g_utf8_get_char (g_utf8_prev_char (state->query + strlen (state->query))));
+
+  scores = g_new0 (gfloat, self->n_documents);
+
+  for (i = 0; i < n_words; i++)
+    {
+      const gchar *word = words [i];
+      gsize pos = rtfm_gir_doc_index_lower_bound (self, word);
+
+      if (i + 1 == n_words && last_is_prefix)
+        {
+          gsize word_len = strlen (word);
+          guint n_expanded = 0;
+
+          for (; pos < self->n_terms && n_expanded < MAX_PREFIX_EXPANSION; pos++, n_expanded++)
+            {
+              const gchar *term = rtfm_gir_doc_index_get_term (self, pos);
+
+              if (strncmp (term, word, word_len) != 0)
+                break;
+
+              /* Favor the exact word over its completions */
+              rtfm_gir_doc_index_score_term (self, pos, term [word_len] == '\0' ? 1.0 : 0.5, scores);
+            }
+        }
+      else if (pos < self->n_terms &&
+               g_str_equal (rtfm_gir_doc_index_get_term (self, pos), word))
+        {
+          rtfm_gir_doc_index_score_term (self, pos, 1.0, scores);
+        }
+
+      if (g_task_return_error_if_cancelled (task))
+        return;
+    }
+
+  ranked = g_array_new (FALSE, FALSE, sizeof (DocScore));
+
+  for (i = 0; i < self->n_documents; i++)
+    {
+      if (scores [i] > 0.0f)
+        {
+          DocScore ds = { i, scores [i] };
+          g_array_append_val (ranked, ds);
+        }
+    }
+
+  g_array_sort (ranked, doc_score_compare);
+
+  if (state->max_matches > 0 && ranked->len > state->max_matches)
+    g_array_set_size (ranked, state->max_matches);
+
+  for (i = 0; i < ranked->len; i++)
+    {
+      const DocScore *ds = &g_array_index (ranked, DocScore, i);
+      g_autoptr(GVariant) child = NULL;
+      g_autoptr(GVariant) document = NULL;
+      g_autoptr(FuzzyIndexMatch) match = NULL;
+
+      child = g_variant_get_child_value (self->documents, ds->document_id);
+      document = g_variant_get_variant (child);
+
+      match = g_object_new (FUZZY_TYPE_INDEX_MATCH,
+                            "document", document,
+                            "key", state->query,
+                            "score", ds->score,
+                            NULL);
+
+      g_list_store_append (store, match);
+    }
+
+finish:
+  g_task_return_pointer (task, g_steal_pointer (&store), g_object_unref);
+}
+
+/**
+ * rtfm_gir_doc_index_query_async:
+ * @self: A #RtfmGirDocIndex
+ * @query: The words to search for
+ * @max_matches: The max number of matches, or 0 for unlimited
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: User data for @callback
+ *
+ * Searches the documentation for @query, ranking the matching
+ * documents using BM25. The last word of @query is matched as a prefix
+ * unless @query ends in whitespace.
+ */
+void
+rtfm_gir_doc_index_query_async (RtfmGirDocIndex     *self,
+                                const gchar         *query,
+                                guint                max_matches,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  QueryState *state;
+
+  g_return_if_fail (RTFM_GIR_IS_DOC_INDEX (self));
+  g_return_if_fail (query != NULL);
+  g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  state = g_slice_new0 (QueryState);
+  state->query = g_strdup (query);
+  state->max_matches = max_matches;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, rtfm_gir_doc_index_query_async);
+  g_task_set_task_data (task, state, query_state_free);
+  g_task_set_check_cancellable (task, FALSE);
+
+  rtfm_scheduler_run_in_thread (self->scheduler ? self->scheduler : rtfm_scheduler_get_default (),
+                                task,
+                                RTFM_SCHEDULER_PRIORITY_INTERACTIVE,
+                                0,
+                                rtfm_gir_doc_index_query_worker);
+}
+
+/**
+ * rtfm_gir_doc_index_query_finish:
+ *
+ * Completes an asynchronous request to rtfm_gir_doc_index_query_async().
+ *
+ * Returns: (transfer full): A #GListModel of #FuzzyIndexMatch, sorted by
+ *   descending BM25 score.
+ */
+GListModel *
+rtfm_gir_doc_index_query_finish (RtfmGirDocIndex  *self,
+                                 GAsyncResult     *result,
+                                 GError          **error)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_DOC_INDEX (self), NULL);
+  g_return_val_if_fail (G_IS_TASK (result), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,66 @@
+/* rtfm-gir-doc-index.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTFM_GIR_DOC_INDEX_H
+#define RTFM_GIR_DOC_INDEX_H
+
+#include <gio/gio.h>
+#include <rtfm.h>
+
+G_BEGIN_DECLS
+
+#define RTFM_GIR_TYPE_DOC_INDEX (rtfm_gir_doc_index_get_type())
+
+G_DECLARE_FINAL_TYPE (RtfmGirDocIndex, rtfm_gir_doc_index, RTFM_GIR, DOC_INDEX, GObject)
+
+RtfmGirDocIndex  *rtfm_gir_doc_index_new                 (void);
+void              rtfm_gir_doc_index_set_scheduler       (RtfmGirDocIndex      *self,
+                                                          RtfmScheduler        *scheduler);
+gboolean          rtfm_gir_doc_index_load_file           (RtfmGirDocIndex      *self,
+                                                          GFile                *file,
+                                                          GCancellable         *cancellable,
+                                                          GError              **error);
+gboolean          rtfm_gir_doc_index_load_variant        (RtfmGirDocIndex      *self,
+                                                          GVariant             *variant,
+                                                          GError              **error);
+gboolean          rtfm_gir_doc_index_write               (RtfmGirDocIndex      *self,
+                                                          GFile                *file,
+                                                          GCancellable         *cancellable,
+                                                          GError              **error);
+GVariant         *rtfm_gir_doc_index_get_metadata        (RtfmGirDocIndex      *self,
+                                                          const gchar          *key);
+guint32           rtfm_gir_doc_index_get_metadata_uint32 (RtfmGirDocIndex      *self,
+                                                          const gchar          *key);
+guint64           rtfm_gir_doc_index_get_metadata_uint64 (RtfmGirDocIndex      *self,
+                                                          const gchar          *key);
+const gchar      *rtfm_gir_doc_index_get_metadata_string (RtfmGirDocIndex      *self,
+                                                          const gchar          *key);
+void              rtfm_gir_doc_index_query_async         (RtfmGirDocIndex      *self,
+                                                          const gchar          *query,
+                                                          guint                 max_matches,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
+GListModel       *rtfm_gir_doc_index_query_finish        (RtfmGirDocIndex      *self,
+                                                          GAsyncResult         *result,
+                                                          GError              **error);
+gchar           **rtfm_gir_doc_index_tokenize            (const gchar          *text);
+
+G_END_DECLS
+
+#endif /* RTFM_GIR_DOC_INDEX_H */
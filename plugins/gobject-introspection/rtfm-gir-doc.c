@@ -240,6 +240,39 @@ rtfm_gir_doc_get_xml_whitespace (RtfmGirDoc *self)
   return self->xml_whitespace;
 }
 
+/**
+ * rtfm_gir_doc_get_text:
+ *
+ * Gets the documentation text collected from the doc element.
+ *
+ * Returns: (nullable): The text, or %NULL if the element was empty.
+ */
+const gchar *
+rtfm_gir_doc_get_text (RtfmGirDoc *self)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_DOC (self), NULL);
+
+  return self->text ? self->text->str : NULL;
+}
+
+void
+_rtfm_gir_doc_set_text (RtfmGirDoc  *self,
+                        const gchar *text)
+{
+  g_return_if_fail (RTFM_GIR_IS_DOC (self));
+
+  if (self->text != NULL)
+    g_string_truncate (self->text, 0);
+
+  if (text == NULL)
+    return;
+
+  if (self->text == NULL)
+    self->text = g_string_new (text);
+  else
+    g_string_append (self->text, text);
+}
+
 RtfmGirDoc *
 rtfm_gir_doc_new (RtfmGirParserContext *parser_context)
 {
@@ -29,6 +29,10 @@ const gchar *rtfm_gir_doc_get_xml_space (RtfmGirDoc *self);
 
 const gchar *rtfm_gir_doc_get_xml_whitespace (RtfmGirDoc *self);
 
+const gchar *rtfm_gir_doc_get_text (RtfmGirDoc *self);
+
+void _rtfm_gir_doc_set_text (RtfmGirDoc *self, const gchar *text) G_GNUC_INTERNAL;
+
 G_END_DECLS
 
 #endif /* RTFM_GIR_DOC */
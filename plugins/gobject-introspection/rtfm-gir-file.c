@@ -18,20 +18,44 @@
 
 #define G_LOG_DOMAIN "rtfm-gir-file"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
 
+#include "rtfm-gir-binary.h"
 #include "rtfm-gir-file.h"
 #include "rtfm-gir-parser.h"
 #include "rtfm-gir-util.h"
 
 #include "rtfm-gir-class.h"
 #include "rtfm-gir-constructor.h"
+#include "rtfm-gir-doc.h"
 #include "rtfm-gir-function.h"
 #include "rtfm-gir-method.h"
 #include "rtfm-gir-namespace.h"
 #include "rtfm-gir-record.h"
 
-#define INDEX_VERSION 2
+#define INDEX_VERSION 4
+
+/* How often, and for how long, to poll for another process' index lock */
+#define LOCK_RETRY_USEC   (G_USEC_PER_SEC / 10)
+#define LOCK_TIMEOUT_USEC (G_USEC_PER_SEC * 30)
+
+/*
+ * Priorities for the keys inserted into the fuzzy index. Lower values
+ * are preferred, so that a match on the C identifier (or C type) of a
+ * node ranks above an equally good match on its GIR name or symbol
+ * prefix. A namespace has no C identifier, so its name is used instead.
+ */
+enum {
+  KEY_PRIORITY_IDENTIFIER   = 0,
+  KEY_PRIORITY_NAME         = 1,
+  KEY_PRIORITY_PREFIX       = 2,
+  KEY_PRIORITY_LIBRARY      = 3,
+};
 
 struct _RtfmGirFile
 {
@@ -40,27 +64,43 @@ struct _RtfmGirFile
   GFile             *file;
   RtfmGirRepository *repository;
   FuzzyIndex        *index;
+  RtfmGirDocIndex   *doc_index;
+
+  /* The scheduler of the library, or %NULL to use the default one */
+  RtfmScheduler     *scheduler;
 
   /*
    * The following is for tracking requests to build the
    * search index for the gir file. If we have an active
    * request, we simply queue the task instead of requesting
-   * dupliated work.
+   * dupliated work. index_priority is the best priority
+   * the build was queued with, and index_running is set
+   * once a worker has picked it up.
    */
   GMutex             mutex;
   GSList            *index_tasks;
+  guint              index_priority : 2;
+  guint              index_running : 1;
 };
 
 enum {
   PROP_0,
   PROP_FILE,
   PROP_REPOSITORY,
+  PROP_SCHEDULER,
   N_PROPS
 };
 
-typedef void (*RtfmGirIndexer) (RtfmGirFile         *self,
-                                FuzzyIndexBuilder   *builder,
-                                RtfmGirParserObject *object);
+/*
+ * Indexers insert the keys for a node into the fuzzy index and return
+ * the document they inserted, so that the same document can be used
+ * for the documentation index. The id of the document is stored in
+ * @document_id so that its static rank can be set.
+ */
+typedef GVariant *(*RtfmGirIndexer) (RtfmGirFile         *self,
+                                     FuzzyIndexBuilder   *builder,
+                                     RtfmGirParserObject *object,
+                                     guint64             *document_id);
 
 static GParamSpec *properties [N_PROPS];
 static GHashTable *indexers;
@@ -70,11 +110,39 @@ static void async_initable_iface_init (GAsyncInitableIface *iface);
 G_DEFINE_TYPE_EXTENDED (RtfmGirFile, rtfm_gir_file, G_TYPE_OBJECT, 0,
                         G_IMPLEMENT_INTERFACE (G_TYPE_ASYNC_INITABLE,
                                                async_initable_iface_init))
+G_DEFINE_QUARK (rtfm-gir-file-parse-group, rtfm_gir_file_parse_group)
+
+/*
+ * The <doc> element comes first when there is one, so this scans the
+ * children rather than sorting every indexed node into buckets.
+ */
+static const gchar *
+get_doc_text (RtfmGirParserObject *object)
+{
+  GPtrArray *children;
+  guint i;
+
+  g_assert (RTFM_GIR_IS_PARSER_OBJECT (object));
+
+  if (NULL != (children = rtfm_gir_parser_object_get_children (object)))
+    {
+      for (i = 0; i < children->len; i++)
+        {
+          RtfmGirParserObject *child = g_ptr_array_index (children, i);
+
+          if (RTFM_GIR_IS_DOC (child))
+            return rtfm_gir_doc_get_text (RTFM_GIR_DOC (child));
+        }
+    }
+
+  return NULL;
+}
 
 static void
-rtfm_gir_file_build_index (RtfmGirFile       *self,
-                           FuzzyIndexBuilder *builder,
-                           gpointer           instance)
+rtfm_gir_file_build_index (RtfmGirFile            *self,
+                           FuzzyIndexBuilder      *builder,
+                           RtfmGirDocIndexBuilder *doc_builder,
+                           gpointer                instance)
 {
   RtfmGirParserObject *object = instance;
   RtfmGirIndexer indexer;
@@ -83,22 +151,68 @@ rtfm_gir_file_build_index (RtfmGirFile       *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (RTFM_GIR_IS_DOC_INDEX_BUILDER (doc_builder));
   g_assert (RTFM_GIR_IS_PARSER_OBJECT (object));
 
   if (NULL != (indexer = g_hash_table_lookup (indexers, GSIZE_TO_POINTER (G_OBJECT_TYPE (object)))))
-    indexer (self, builder, object);
+    {
+      g_autoptr(GVariant) document = NULL;
+      guint64 document_id = G_MAXUINT64;
+      const gchar *text;
+      const gchar *word = NULL;
+
+      document = indexer (self, builder, object, &document_id);
+
+      if (document != NULL && document_id != G_MAXUINT64)
+        {
+          g_variant_lookup (document, "word", "&s", &word);
+          fuzzy_index_builder_set_document_rank (builder,
+                                                 document_id,
+                                                 rtfm_gir_get_static_rank (object, word));
+        }
+
+      if (document != NULL && NULL != (text = get_doc_text (object)))
+        rtfm_gir_doc_index_builder_insert (doc_builder, text, document);
+    }
 
   if (NULL != (children = rtfm_gir_parser_object_get_children (object)))
     {
       for (i = 0; i < children->len; i++)
-        rtfm_gir_file_build_index (self, builder, g_ptr_array_index (children, i));
+        rtfm_gir_file_build_index (self, builder, doc_builder, g_ptr_array_index (children, i));
     }
 }
 
-static void
-namespace_indexer (RtfmGirFile         *self,
-                   FuzzyIndexBuilder   *builder,
-                   RtfmGirNamespace    *namespace)
+/**
+ * rtfm_gir_file_build_indexes:
+ * @self: A #RtfmGirFile
+ * @repository: The parsed repository to index
+ * @builder: The builder for the name index
+ * @doc_builder: The builder for the documentation index
+ *
+ * Runs the indexers over @repository, inserting into @builder and
+ * @doc_builder. This is what rtfm_gir_file_load_index_async() does
+ * when the cached indexes are out of date, and is exposed so that it
+ * can be benchmarked.
+ */
+void
+rtfm_gir_file_build_indexes (RtfmGirFile            *self,
+                             RtfmGirRepository      *repository,
+                             FuzzyIndexBuilder      *builder,
+                             RtfmGirDocIndexBuilder *doc_builder)
+{
+  g_return_if_fail (RTFM_GIR_IS_FILE (self));
+  g_return_if_fail (RTFM_GIR_IS_REPOSITORY (repository));
+  g_return_if_fail (FUZZY_IS_INDEX_BUILDER (builder));
+  g_return_if_fail (RTFM_GIR_IS_DOC_INDEX_BUILDER (doc_builder));
+
+  rtfm_gir_file_build_index (self, builder, doc_builder, repository);
+}
+
+static GVariant *
+namespace_indexer (RtfmGirFile       *self,
+                   FuzzyIndexBuilder *builder,
+                   RtfmGirNamespace  *namespace,
+                   guint64           *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -107,6 +221,7 @@ namespace_indexer (RtfmGirFile         *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_NAMESPACE (namespace));
 
   id = rtfm_gir_generate_id (namespace);
@@ -117,25 +232,28 @@ namespace_indexer (RtfmGirFile         *self,
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                          \
-  G_STMT_START {                                                 \
-    const gchar *tmp = rtfm_gir_namespace_get_##key (namespace); \
-    if (tmp != NULL)                                             \
-      fuzzy_index_builder_insert (builder, tmp, document);       \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_namespace_get_##key (namespace);                    \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (name);
-  INSERT_KEY (c_identifier_prefixes);
-  INSERT_KEY (c_symbol_prefixes);
-  INSERT_KEY (shared_library);
+  INSERT_KEY (name, KEY_PRIORITY_IDENTIFIER);
+  INSERT_KEY (c_identifier_prefixes, KEY_PRIORITY_PREFIX);
+  INSERT_KEY (c_symbol_prefixes, KEY_PRIORITY_PREFIX);
+  INSERT_KEY (shared_library, KEY_PRIORITY_LIBRARY);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
-static void
+static GVariant *
 class_indexer (RtfmGirFile       *self,
                FuzzyIndexBuilder *builder,
-               RtfmGirClass      *klass)
+               RtfmGirClass      *klass,
+               guint64           *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -144,37 +262,41 @@ class_indexer (RtfmGirFile       *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_CLASS (klass));
 
   id = rtfm_gir_generate_id (klass);
   name = rtfm_gir_class_get_c_type (klass);
 
   if (name == NULL)
-    return;
+    return NULL;
 
   g_variant_dict_init (&dict, NULL);
   g_variant_dict_insert (&dict, "id", "s", id);
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                    \
-  G_STMT_START {                                           \
-    const gchar *tmp = rtfm_gir_class_get_##key (klass);   \
-    if (tmp != NULL)                                       \
-      fuzzy_index_builder_insert (builder, tmp, document); \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_class_get_##key (klass);                            \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (name);
-  INSERT_KEY (c_symbol_prefix);
-  INSERT_KEY (c_type);
+  INSERT_KEY (name, KEY_PRIORITY_NAME);
+  INSERT_KEY (c_symbol_prefix, KEY_PRIORITY_PREFIX);
+  INSERT_KEY (c_type, KEY_PRIORITY_IDENTIFIER);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
-static void
+static GVariant *
 record_indexer (RtfmGirFile       *self,
                 FuzzyIndexBuilder *builder,
-                RtfmGirRecord     *record)
+                RtfmGirRecord     *record,
+                guint64           *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -183,37 +305,41 @@ record_indexer (RtfmGirFile       *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_RECORD (record));
 
   id = rtfm_gir_generate_id (record);
   name = rtfm_gir_record_get_c_type (record);
 
   if (name == NULL)
-    return;
+    return NULL;
 
   g_variant_dict_init (&dict, NULL);
   g_variant_dict_insert (&dict, "id", "s", id);
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                    \
-  G_STMT_START {                                           \
-    const gchar *tmp = rtfm_gir_record_get_##key (record);   \
-    if (tmp != NULL)                                       \
-      fuzzy_index_builder_insert (builder, tmp, document); \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_record_get_##key (record);                          \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (c_type);
-  INSERT_KEY (name);
-  INSERT_KEY (c_symbol_prefix);
+  INSERT_KEY (c_type, KEY_PRIORITY_IDENTIFIER);
+  INSERT_KEY (name, KEY_PRIORITY_NAME);
+  INSERT_KEY (c_symbol_prefix, KEY_PRIORITY_PREFIX);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
-static void
+static GVariant *
 function_indexer (RtfmGirFile       *self,
                   FuzzyIndexBuilder *builder,
-                  RtfmGirFunction   *function)
+                  RtfmGirFunction   *function,
+                  guint64           *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -222,36 +348,40 @@ function_indexer (RtfmGirFile       *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_FUNCTION (function));
 
   id = rtfm_gir_generate_id (function);
   name = rtfm_gir_function_get_c_identifier (function);
 
   if (name == NULL)
-    return;
+    return NULL;
 
   g_variant_dict_init (&dict, NULL);
   g_variant_dict_insert (&dict, "id", "s", id);
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                        \
-  G_STMT_START {                                               \
-    const gchar *tmp = rtfm_gir_function_get_##key (function); \
-    if (tmp != NULL)                                           \
-      fuzzy_index_builder_insert (builder, tmp, document);     \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_function_get_##key (function);                      \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (c_identifier);
-  INSERT_KEY (name);
+  INSERT_KEY (c_identifier, KEY_PRIORITY_IDENTIFIER);
+  INSERT_KEY (name, KEY_PRIORITY_NAME);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
-static void
+static GVariant *
 method_indexer (RtfmGirFile       *self,
                 FuzzyIndexBuilder *builder,
-                RtfmGirMethod     *method)
+                RtfmGirMethod     *method,
+                guint64           *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -260,36 +390,40 @@ method_indexer (RtfmGirFile       *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_METHOD (method));
 
   id = rtfm_gir_generate_id (method);
   name = rtfm_gir_method_get_c_identifier (method);
 
   if (name == NULL)
-    return;
+    return NULL;
 
   g_variant_dict_init (&dict, NULL);
   g_variant_dict_insert (&dict, "id", "s", id);
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                    \
-  G_STMT_START {                                           \
-    const gchar *tmp = rtfm_gir_method_get_##key (method); \
-    if (tmp != NULL)                                       \
-      fuzzy_index_builder_insert (builder, tmp, document); \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_method_get_##key (method);                          \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (c_identifier);
-  INSERT_KEY (name);
+  INSERT_KEY (c_identifier, KEY_PRIORITY_IDENTIFIER);
+  INSERT_KEY (name, KEY_PRIORITY_NAME);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
-static void
+static GVariant *
 constructor_indexer (RtfmGirFile        *self,
                      FuzzyIndexBuilder  *builder,
-                     RtfmGirConstructor *constructor)
+                     RtfmGirConstructor *constructor,
+                     guint64            *document_id)
 {
   g_autoptr(GVariant) document = NULL;
   g_autofree gchar *id = NULL;
@@ -298,30 +432,33 @@ constructor_indexer (RtfmGirFile        *self,
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (FUZZY_IS_INDEX_BUILDER (builder));
+  g_assert (document_id != NULL);
   g_assert (RTFM_GIR_IS_CONSTRUCTOR (constructor));
 
   id = rtfm_gir_generate_id (constructor);
   name = rtfm_gir_constructor_get_c_identifier (constructor);
 
   if (name == NULL)
-    return;
+    return NULL;
 
   g_variant_dict_init (&dict, NULL);
   g_variant_dict_insert (&dict, "id", "s", id);
   g_variant_dict_insert (&dict, "word", "s", name);
   document = g_variant_ref_sink (g_variant_dict_end (&dict));
 
-#define INSERT_KEY(key)                                              \
-  G_STMT_START {                                                     \
-    const gchar *tmp = rtfm_gir_constructor_get_##key (constructor); \
-    if (tmp != NULL)                                                 \
-      fuzzy_index_builder_insert (builder, tmp, document);           \
+#define INSERT_KEY(key, priority)                                                   \
+  G_STMT_START {                                                                    \
+    const gchar *tmp = rtfm_gir_constructor_get_##key (constructor);                \
+    if (tmp != NULL)                                                                \
+      *document_id = fuzzy_index_builder_insert (builder, tmp, document, priority); \
   } G_STMT_END
 
-  INSERT_KEY (c_identifier);
-  INSERT_KEY (name);
+  INSERT_KEY (c_identifier, KEY_PRIORITY_IDENTIFIER);
+  INSERT_KEY (name, KEY_PRIORITY_NAME);
 
 #undef INSERT_KEY
+
+  return g_steal_pointer (&document);
 }
 
 static void
@@ -332,6 +469,8 @@ rtfm_gir_file_finalize (GObject *object)
   g_clear_object (&self->file);
   g_clear_object (&self->repository);
   g_clear_object (&self->index);
+  g_clear_object (&self->doc_index);
+  g_clear_object (&self->scheduler);
 
   g_mutex_clear (&self->mutex);
 
@@ -356,6 +495,10 @@ rtfm_gir_file_get_property (GObject    *object,
       g_value_set_object (value, self->repository);
       break;
 
+    case PROP_SCHEDULER:
+      g_value_set_object (value, self->scheduler);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -375,6 +518,10 @@ rtfm_gir_file_set_property (GObject      *object,
       self->file = g_value_dup_object (value);
       break;
 
+    case PROP_SCHEDULER:
+      self->scheduler = g_value_dup_object (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     }
@@ -403,6 +550,13 @@ rtfm_gir_file_class_init (RtfmGirFileClass *klass)
                          RTFM_GIR_TYPE_REPOSITORY,
                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  properties [PROP_SCHEDULER] =
+    g_param_spec_object ("scheduler",
+                         "Scheduler",
+                         "The scheduler to run parsing and indexing on",
+                         RTFM_TYPE_SCHEDULER,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_properties (object_class, N_PROPS, properties);
 
   indexers = g_hash_table_new (NULL, NULL);
@@ -426,6 +580,54 @@ rtfm_gir_file_init (RtfmGirFile *self)
   g_mutex_init (&self->mutex);
 }
 
+static RtfmScheduler *
+rtfm_gir_file_get_scheduler (RtfmGirFile *self)
+{
+  g_assert (RTFM_GIR_IS_FILE (self));
+
+  return self->scheduler ? self->scheduler : rtfm_scheduler_get_default ();
+}
+
+static gchar     *get_search_index_filename (GFile       *file,
+                                             const gchar *suffix);
+static GPtrArray *get_compiled_dirs         (void);
+static gchar     *get_compiled_filename     (const gchar *directory,
+                                             GFile       *file,
+                                             const gchar *suffix);
+
+/*
+ * Maps the binary repository compiled for @file, or the one we cached
+ * the last time it was parsed, so that browsing does not need to parse
+ * the .gir file again.
+ */
+static RtfmGirRepository *
+load_binary_repository (GFile   *file,
+                        guint64  mtime)
+{
+  g_autoptr(GPtrArray) dirs = NULL;
+  g_autofree gchar *path = NULL;
+  guint i;
+
+  g_assert (G_IS_FILE (file));
+
+  dirs = get_compiled_dirs ();
+
+  for (i = 0; i < dirs->len; i++)
+    {
+      g_autofree gchar *compiled_path = NULL;
+      RtfmGirRepository *repository;
+
+      compiled_path = get_compiled_filename (g_ptr_array_index (dirs, i), file, ".repository.rtfm");
+
+      if (NULL != (repository = rtfm_gir_binary_load (compiled_path, mtime, NULL)))
+        return repository;
+    }
+
+  path = get_search_index_filename (file, ".repository");
+
+  return rtfm_gir_binary_load (path, mtime, NULL);
+}
+
 static void
 rtfm_gir_file_init_worker (GTask        *task,
                            gpointer      source_object,
@@ -434,15 +636,39 @@ rtfm_gir_file_init_worker (GTask        *task,
 {
   g_autoptr(RtfmGirParser) parser = NULL;
   g_autoptr(RtfmGirRepository) repository = NULL;
+  g_autoptr(GFileInfo) file_info = NULL;
   GFile *file = task_data;
   GError *error = NULL;
 
   g_assert (G_IS_TASK (task));
   g_assert (G_IS_FILE (file));
 
+  file_info = g_file_query_info (file,
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 cancellable,
+                                 NULL);
+
+  if (file_info != NULL)
+    {
+      guint64 mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+      if (NULL != (repository = load_binary_repository (file, mtime)))
+        {
+          g_task_return_pointer (task, g_steal_pointer (&repository), g_object_unref);
+          return;
+        }
+    }
+
+  /*
+   * Only the outline of the namespace is parsed here. The members of each
+   * class, interface and record are parsed when it is first browsed. The
+   * binary repository is written when the search index is built, since
+   * that has to parse everything anyway.
+   */
   parser = rtfm_gir_parser_new ();
 
-  repository = rtfm_gir_parser_parse_file (parser, file, cancellable, &error);
+  repository = rtfm_gir_parser_parse_skeleton (parser, file, cancellable, &error);
 
   if (repository == NULL)
     {
@@ -476,7 +702,13 @@ rtfm_gir_file_init_async (GAsyncInitable      *initable,
       return;
     }
 
-  g_task_run_in_thread (task, rtfm_gir_file_init_worker);
+  rtfm_scheduler_run_in_thread (rtfm_gir_file_get_scheduler (self),
+                                task,
+                                io_priority > G_PRIORITY_DEFAULT
+                                  ? RTFM_SCHEDULER_PRIORITY_BACKGROUND
+                                  : RTFM_SCHEDULER_PRIORITY_VISIBLE,
+                                RTFM_GIR_FILE_PARSE_GROUP,
+                                rtfm_gir_file_init_worker);
 }
 
 static gboolean
@@ -531,6 +763,26 @@ rtfm_gir_file_get_repository (RtfmGirFile *self)
   return self->repository;
 }
 
+/**
+ * rtfm_gir_file_get_doc_index:
+ *
+ * Gets the documentation index for the file. This is available once
+ * rtfm_gir_file_load_index_async() has completed successfully.
+ *
+ * Returns: (transfer full) (nullable): A #RtfmGirDocIndex or %NULL.
+ */
+RtfmGirDocIndex *
+rtfm_gir_file_get_doc_index (RtfmGirFile *self)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+
+  g_return_val_if_fail (RTFM_GIR_IS_FILE (self), NULL);
+
+  locker = g_mutex_locker_new (&self->mutex);
+
+  return self->doc_index ? g_object_ref (self->doc_index) : NULL;
+}
+
 RtfmGirFile *
 rtfm_gir_file_new (GFile *file)
 {
@@ -541,8 +793,32 @@ rtfm_gir_file_new (GFile *file)
                        NULL);
 }
 
+/**
+ * rtfm_gir_file_new_for_scheduler:
+ * @file: A #GFile of a .gir file
+ * @scheduler: (nullable): The #RtfmScheduler of the library, or %NULL
+ *
+ * Like rtfm_gir_file_new(), but parses and indexes @file on @scheduler,
+ * as does the #RtfmGirDocIndex it loads.
+ *
+ * Returns: (transfer full): A new #RtfmGirFile.
+ */
+RtfmGirFile *
+rtfm_gir_file_new_for_scheduler (GFile         *file,
+                                 RtfmScheduler *scheduler)
+{
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (!scheduler || RTFM_IS_SCHEDULER (scheduler), NULL);
+
+  return g_object_new (RTFM_GIR_TYPE_FILE,
+                       "file", file,
+                       "scheduler", scheduler,
+                       NULL);
+}
+
 static gchar *
-get_search_index_filename (GFile *file)
+get_search_index_filename (GFile       *file,
+                           const gchar *suffix)
 {
   g_autofree gchar *uri = NULL;
   g_autofree gchar *name = NULL;
@@ -555,7 +831,7 @@ get_search_index_filename (GFile *file)
   checksum = g_checksum_new (G_CHECKSUM_SHA1);
   g_checksum_update (checksum, (const guint8 *)uri, strlen (uri));
   digest = g_checksum_get_string (checksum);
-  name = g_strdup_printf ("%s.gvariant", digest);
+  name = g_strdup_printf ("%s%s", digest, suffix);
 
   return g_build_filename (g_get_user_cache_dir (),
                            "rtfm",
@@ -592,37 +868,505 @@ check_index_version (FuzzyIndex  *index,
       return FALSE;
     }
 
+  /* Static ranks depend on the popularity table */
+  if (rtfm_gir_get_popularity_mtime () != fuzzy_index_get_metadata_uint64 (index, "popularity"))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_WRONG_ETAG,
+                   "popularity table has changed, requires index rebuild");
+      return FALSE;
+    }
+
   return TRUE;
 }
 
+static gboolean
+check_doc_index_version (RtfmGirDocIndex  *index,
+                         guint64           mtime,
+                         GError          **error)
+{
+  g_assert (RTFM_GIR_IS_DOC_INDEX (index));
+  g_assert (error != NULL);
+
+  if (INDEX_VERSION != rtfm_gir_doc_index_get_metadata_uint32 (index, "version") ||
+      mtime != rtfm_gir_doc_index_get_metadata_uint64 (index, "mtime"))
+    {
+      g_set_error (error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_WRONG_ETAG,
+                   "documentation index is too old, requires index rebuild");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Loads the indexes at @index_file and @doc_index_file if both exist and
+ * were built from the .gir file as of @mtime.
+ */
+static gboolean
+load_indexes (GFile            *file,
+              guint64           mtime,
+              GFile            *index_file,
+              GFile            *doc_index_file,
+              FuzzyIndex      **index,
+              RtfmGirDocIndex **doc_index,
+              GCancellable     *cancellable)
+{
+  g_autoptr(FuzzyIndex) prev_index = NULL;
+  g_autoptr(RtfmGirDocIndex) prev_doc_index = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE (index_file));
+  g_assert (G_IS_FILE (doc_index_file));
+  g_assert (index != NULL);
+  g_assert (doc_index != NULL);
+
+  /*
+   * The name index and documentation index are built together, so if
+   * either of them is missing or stale we rebuild both.
+   */
+  if (!g_file_query_exists (index_file, cancellable) ||
+      !g_file_query_exists (doc_index_file, cancellable))
+    return FALSE;
+
+  prev_index = fuzzy_index_new ();
+  prev_doc_index = rtfm_gir_doc_index_new ();
+
+  if (!fuzzy_index_load_file (prev_index, index_file, cancellable, &error) ||
+      !check_index_version (prev_index, file, mtime, &error) ||
+      !rtfm_gir_doc_index_load_file (prev_doc_index, doc_index_file, cancellable, &error) ||
+      !check_doc_index_version (prev_doc_index, mtime, &error))
+    {
+      g_message ("%s", error->message);
+      return FALSE;
+    }
+
+  *index = g_steal_pointer (&prev_index);
+  *doc_index = g_steal_pointer (&prev_doc_index);
+
+  return TRUE;
+}
+
+/*
+ * Takes an advisory lock for building the indexes at @index_path, so
+ * that other processes starting with the same stale cache wait for our
+ * indexes instead of building their own. The lock is on a file of its
+ * own, since the indexes are replaced rather than rewritten.
+ *
+ * We poll rather than block so that @cancellable is respected, and give
+ * up after LOCK_TIMEOUT_USEC in case the other process is stuck.
+ *
+ * Returns: a file descriptor to pass to unlock_index(), or -1.
+ */
+static gint
+lock_index (const gchar   *index_path,
+            GCancellable  *cancellable,
+            GError       **error)
+{
+  g_autofree gchar *lock_path = g_strdup_printf ("%s.lock", index_path);
+  gint64 deadline;
+  gint fd;
+
+  g_assert (index_path != NULL);
+
+  fd = g_open (lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+
+  if (fd == -1)
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to open %s: %s",
+                   lock_path, g_strerror (errsv));
+      return -1;
+    }
+
+  deadline = g_get_monotonic_time () + LOCK_TIMEOUT_USEC;
+
+  while (flock (fd, LOCK_EX | LOCK_NB) == -1)
+    {
+      gint errsv = errno;
+
+      if (errsv == EINTR)
+        continue;
+
+      if (errsv == EWOULDBLOCK)
+        {
+          if (g_cancellable_set_error_if_cancelled (cancellable, error))
+            {
+              close (fd);
+              return -1;
+            }
+
+          if (g_get_monotonic_time () >= deadline)
+            {
+              g_set_error (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_TIMED_OUT,
+                           "Timed out waiting for lock on %s",
+                           lock_path);
+              close (fd);
+              return -1;
+            }
+
+          g_usleep (LOCK_RETRY_USEC);
+          continue;
+        }
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to lock %s: %s",
+                   lock_path, g_strerror (errsv));
+      close (fd);
+      return -1;
+    }
+
+  return fd;
+}
+
+static void
+unlock_index (gint fd)
+{
+  if (fd != -1)
+    {
+      flock (fd, LOCK_UN);
+      close (fd);
+    }
+}
+
+/*
+ * Creates an empty file with a unique name next to @path, so that it
+ * can be renamed over @path without crossing file systems. Processes
+ * writing the same index never share a temporary file.
+ */
+static gchar *
+create_temp_path (const gchar  *path,
+                  GError      **error)
+{
+  g_autofree gchar *tmp_path = g_strdup_printf ("%s.XXXXXX", path);
+  gint fd;
+
+  g_assert (path != NULL);
+
+  fd = g_mkstemp_full (tmp_path, O_RDWR | O_CLOEXEC, 0640);
+
+  if (fd == -1)
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to create temporary file for %s: %s",
+                   path, g_strerror (errsv));
+      return NULL;
+    }
+
+  close (fd);
+
+  return g_steal_pointer (&tmp_path);
+}
+
+/*
+ * Flushes @path to disk, so that renaming it into place cannot leave
+ * an empty or truncated index behind after a power loss.
+ */
+static gboolean
+sync_path (const gchar  *path,
+           GError      **error)
+{
+  gint errsv;
+  gint fd;
+
+  g_assert (path != NULL);
+
+  fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+
+  if (fd != -1 && fsync (fd) == 0)
+    {
+      close (fd);
+      return TRUE;
+    }
+
+  errsv = errno;
+
+  if (fd != -1)
+    close (fd);
+
+  g_set_error (error,
+               G_IO_ERROR,
+               g_io_error_from_errno (errsv),
+               "Failed to sync %s: %s",
+               path, g_strerror (errsv));
+
+  return FALSE;
+}
+
+/*
+ * Writes both indexes next to their final location and then renames
+ * them into place, so that neither a crash nor another process reading
+ * the cache ever sees a partially written index.
+ */
+static gboolean
+write_indexes (FuzzyIndex       *index,
+               RtfmGirDocIndex  *doc_index,
+               const gchar      *index_path,
+               const gchar      *doc_index_path,
+               GError          **error)
+{
+  g_autofree gchar *tmp_path = NULL;
+  g_autofree gchar *doc_tmp_path = NULL;
+  g_autoptr(GFile) tmp_file = NULL;
+  g_autoptr(GFile) doc_tmp_file = NULL;
+
+  g_assert (FUZZY_IS_INDEX (index));
+  g_assert (RTFM_GIR_IS_DOC_INDEX (doc_index));
+
+  if (NULL == (tmp_path = create_temp_path (index_path, error)) ||
+      NULL == (doc_tmp_path = create_temp_path (doc_index_path, error)))
+    goto failure;
+
+  tmp_file = g_file_new_for_path (tmp_path);
+  doc_tmp_file = g_file_new_for_path (doc_tmp_path);
+
+  if (!fuzzy_index_write (index, tmp_file, G_PRIORITY_LOW, NULL, error) ||
+      !rtfm_gir_doc_index_write (doc_index, doc_tmp_file, NULL, error) ||
+      !sync_path (tmp_path, error) ||
+      !sync_path (doc_tmp_path, error))
+    goto failure;
+
+  /*
+   * The name index is renamed last. Both carry the mtime of the .gir
+   * file, so a crash in between leaves a pair that is simply rebuilt.
+   */
+  if (g_rename (doc_tmp_path, doc_index_path) != 0 ||
+      g_rename (tmp_path, index_path) != 0)
+    {
+      gint errsv = errno;
+
+      g_set_error (error,
+                   G_IO_ERROR,
+                   g_io_error_from_errno (errsv),
+                   "Failed to rename index into place: %s",
+                   g_strerror (errsv));
+      goto failure;
+    }
+
+  return TRUE;
+
+failure:
+  if (tmp_path != NULL)
+    g_unlink (tmp_path);
+
+  if (doc_tmp_path != NULL)
+    g_unlink (doc_tmp_path);
+
+  return FALSE;
+}
+
+/*
+ * Parses @file and builds both of its indexes in memory, handing back
+ * the parsed tree in @repository_out when it is not %NULL. Nothing here
+ * depends on where the indexes end up, so that compiling the same .gir
+ * file always produces the same bytes.
+ */
+static gboolean
+build_indexes (RtfmGirFile        *self,
+               GFile              *file,
+               guint64             mtime,
+               GCancellable       *cancellable,
+               FuzzyIndex        **index,
+               RtfmGirDocIndex   **doc_index,
+               RtfmGirRepository **repository_out,
+               GError            **error)
+{
+  g_autoptr(RtfmGirParser) parser = NULL;
+  g_autoptr(RtfmGirRepository) repository = NULL;
+  g_autoptr(FuzzyIndexBuilder) builder = NULL;
+  g_autoptr(RtfmGirDocIndexBuilder) doc_builder = NULL;
+  g_autofree gchar *nsname = NULL;
+  gchar *tmp;
+
+  g_assert (RTFM_GIR_IS_FILE (self));
+  g_assert (G_IS_FILE (file));
+  g_assert (index != NULL);
+  g_assert (doc_index != NULL);
+
+  /*
+   * Parse our own copy of the repository so that we don't need
+   * to synchronize with the repository being parsed. We can also
+   * through away the parsed tree afterwards to reclaim some memory,
+   * which means that building indexes need-not consume extra memory
+   * after building, until the user opens the namespace.
+   */
+
+  parser = rtfm_gir_parser_new ();
+
+  repository = rtfm_gir_parser_parse_file (parser, file, cancellable, error);
+  if (repository == NULL)
+    return FALSE;
+
+  /*
+   * Translate namespace "Foo-1.0.gir" to "Foo 1.0".
+   */
+  nsname = g_file_get_basename (file);
+  if (NULL != (tmp = strrchr (nsname, '.')))
+    *tmp = '\0';
+  if (NULL != (tmp = strchr (nsname, '-')))
+    *tmp = ' ';
+
+  /*
+   * Now build our index from strings in the repository.
+   */
+  builder = fuzzy_index_builder_new ();
+  fuzzy_index_builder_set_metadata_uint64 (builder, "mtime", mtime);
+  fuzzy_index_builder_set_metadata_string (builder, "namespace", nsname);
+  fuzzy_index_builder_set_metadata_uint32 (builder, "version", INDEX_VERSION);
+  fuzzy_index_builder_set_metadata_uint64 (builder, "popularity", rtfm_gir_get_popularity_mtime ());
+
+  doc_builder = rtfm_gir_doc_index_builder_new ();
+  rtfm_gir_doc_index_builder_set_metadata (doc_builder, "mtime", g_variant_new_uint64 (mtime));
+  rtfm_gir_doc_index_builder_set_metadata (doc_builder, "namespace", g_variant_new_string (nsname));
+  rtfm_gir_doc_index_builder_set_metadata (doc_builder, "version", g_variant_new_uint32 (INDEX_VERSION));
+
+  rtfm_gir_file_build_index (self, builder, doc_builder, repository);
+
+  *index = fuzzy_index_builder_build_index (builder);
+  *doc_index = rtfm_gir_doc_index_builder_build_index (doc_builder);
+
+  if (repository_out != NULL)
+    *repository_out = g_steal_pointer (&repository);
+
+  return TRUE;
+}
+
+/*
+ * Compiled indexes are named after the .gir file they were built from,
+ * such as "Gtk-3.0.rtfm" and "Gtk-3.0.docs.rtfm" for "Gtk-3.0.gir".
+ */
+static gchar *
+get_compiled_filename (const gchar *directory,
+                       GFile       *file,
+                       const gchar *suffix)
+{
+  g_autofree gchar *name = g_file_get_basename (file);
+  g_autofree gchar *compiled_name = NULL;
+
+  if (g_str_has_suffix (name, ".gir"))
+    name [strlen (name) - strlen (".gir")] = '\0';
+
+  compiled_name = g_strdup_printf ("%s%s", name, suffix);
+
+  return g_build_filename (directory, compiled_name, NULL);
+}
+
+/*
+ * The directories rtfm-gir-compiler output is looked up in: our own data
+ * directory, and then each of the system data directories.
+ */
+static GPtrArray *
+get_compiled_dirs (void)
+{
+  const gchar * const *data_dirs;
+  GPtrArray *dirs;
+  guint i;
+
+  dirs = g_ptr_array_new_with_free_func (g_free);
+  g_ptr_array_add (dirs, g_strdup (RTFM_GIR_COMPILED_DIR));
+
+  data_dirs = g_get_system_data_dirs ();
+
+  for (i = 0; data_dirs [i] != NULL; i++)
+    g_ptr_array_add (dirs, g_build_filename (data_dirs [i], "rtfm", "gobject-introspection", NULL));
+
+  return dirs;
+}
+
+/*
+ * Looks for indexes compiled by rtfm-gir-compiler. They are only used if
+ * they were compiled from the .gir file as of @mtime.
+ */
+static gboolean
+load_compiled_indexes (GFile            *file,
+                       guint64           mtime,
+                       FuzzyIndex      **index,
+                       RtfmGirDocIndex **doc_index,
+                       GCancellable     *cancellable)
+{
+  g_autoptr(GPtrArray) dirs = NULL;
+  guint i;
+
+  g_assert (G_IS_FILE (file));
+
+  dirs = get_compiled_dirs ();
+
+  for (i = 0; i < dirs->len; i++)
+    {
+      const gchar *dir = g_ptr_array_index (dirs, i);
+      g_autofree gchar *index_path = get_compiled_filename (dir, file, ".rtfm");
+      g_autofree gchar *doc_index_path = get_compiled_filename (dir, file, ".docs.rtfm");
+      g_autoptr(GFile) index_file = g_file_new_for_path (index_path);
+      g_autoptr(GFile) doc_index_file = g_file_new_for_path (doc_index_path);
+
+      if (load_indexes (file, mtime, index_file, doc_index_file, index, doc_index, cancellable))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 static void
 rtfm_gir_file_load_index_worker (GTask        *task,
                                  gpointer      source_object,
                                  gpointer      task_data,
                                  GCancellable *cancellable)
 {
-  g_autoptr(RtfmGirParser) parser = NULL;
-  g_autoptr(RtfmGirRepository) repository = NULL;
-  g_autoptr(FuzzyIndexBuilder) builder = NULL;
   g_autoptr(FuzzyIndex) new_index = NULL;
+  g_autoptr(RtfmGirDocIndex) new_doc_index = NULL;
+  g_autoptr(RtfmGirRepository) new_repository = NULL;
   g_autoptr(GFile) index_file = NULL;
+  g_autoptr(GFile) doc_index_file = NULL;
   g_autoptr(GFileInfo) file_info = NULL;
   g_autofree gchar *index_path = NULL;
-  g_autofree gchar *nsname = NULL;
+  g_autofree gchar *doc_index_path = NULL;
+  g_autofree gchar *index_dir = NULL;
   RtfmGirFile *self = source_object;
   FuzzyIndex *result = NULL;
-  gchar *tmp;
+  RtfmGirDocIndex *doc_result = NULL;
   GSList *list;
   GSList *iter;
   GFile *file = task_data;
   GError *error = NULL;
   guint64 mtime = 0;
+  gboolean needs_write = FALSE;
+  gint lock_fd = -1;
 
   g_assert (RTFM_GIR_IS_FILE (self));
   g_assert (G_IS_TASK (task));
   g_assert (G_IS_FILE (file));
   g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
 
+  /*
+   * The build may have been queued again at a better priority, in which
+   * case whichever copy runs first does the work and completes every
+   * waiting task, including ours.
+   */
+  g_mutex_lock (&self->mutex);
+  if (self->index_running || self->index_tasks == NULL)
+    {
+      g_mutex_unlock (&self->mutex);
+      return;
+    }
+  self->index_running = TRUE;
+  g_mutex_unlock (&self->mutex);
+
   /*
    * Query information on our .gir file so we have an mtime to
    * validate against the search index.
@@ -637,86 +1381,83 @@ rtfm_gir_file_load_index_worker (GTask        *task,
 
   mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
 
+  /* Distributions may have compiled the indexes ahead of time */
+  if (load_compiled_indexes (file, mtime, &new_index, &new_doc_index, cancellable))
+    {
+      result = new_index;
+      doc_result = new_doc_index;
+      goto finish;
+    }
+
   /*
    * Open the previous search index if it exists, and see if it is up to
    * date or requires and update.
    */
-  index_path = get_search_index_filename (file);
+  index_path = get_search_index_filename (file, ".gvariant");
   index_file = g_file_new_for_path (index_path);
 
-  if (g_file_query_exists (index_file, cancellable))
-    {
-      g_autoptr(FuzzyIndex) prev_index = fuzzy_index_new ();
+  doc_index_path = get_search_index_filename (file, ".docs.gvariant");
+  doc_index_file = g_file_new_for_path (doc_index_path);
 
-      if (fuzzy_index_load_file (prev_index, index_file, cancellable, &error) &&
-          check_index_version (prev_index, file, mtime, &error))
-        {
-          result = prev_index;
-          goto finish;
-        }
-
-      g_message ("%s", error->message);
-
-      g_clear_error (&error);
+  if (load_indexes (file, mtime, index_file, doc_index_file, &new_index, &new_doc_index, cancellable))
+    {
+      result = new_index;
+      doc_result = new_doc_index;
+      goto finish;
     }
 
   /*
-   * Parse our own copy of the repository so that we don't need
-   * to synchronize with the repository being parsed. We can also
-   * through away the parsed tree afterwards to reclaim some memory,
-   * which means that building indexes need-not consume extra memory
-   * after building, until the user opens the namespace.
+   * Another rtfm process may be building the same indexes, such as the
+   * application and a --search from the command line. Wait for it, and
+   * use what it wrote if that is current. Without the lock we can still
+   * build the indexes, we just might duplicate the work.
    */
+  index_dir = g_path_get_dirname (index_path);
 
-  parser = rtfm_gir_parser_new ();
+  /* Created here so that the main thread never touches the cache */
+  g_mkdir_with_parents (index_dir, 0750);
 
-  repository = rtfm_gir_parser_parse_file (parser, file, cancellable, &error);
-  if (repository == NULL)
-    goto finish;
-
-  /*
-   * Translate namespace "Foo-1.0.gir" to "Foo 1.0".
-   */
-  nsname = g_file_get_basename (file);
-  if (NULL != (tmp = strrchr (nsname, '.')))
-    *tmp = '\0';
-  if (NULL != (tmp = strchr (nsname, '-')))
-    *tmp = ' ';
+  if (-1 == (lock_fd = lock_index (index_path, cancellable, &error)))
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        goto finish;
 
-  /*
-   * Now build our index from strings in the repository.
-   */
-  builder = fuzzy_index_builder_new ();
-  fuzzy_index_builder_set_metadata_string (builder, "self", index_path);
-  fuzzy_index_builder_set_metadata_uint64 (builder, "mtime", mtime);
-  fuzzy_index_builder_set_metadata_string (builder, "namespace", nsname);
-  fuzzy_index_builder_set_metadata_uint32 (builder, "version", INDEX_VERSION);
-  rtfm_gir_file_build_index (self, builder, repository);
+      g_warning ("%s", error->message);
+      g_clear_error (&error);
+    }
+  else if (load_indexes (file, mtime, index_file, doc_index_file, &new_index, &new_doc_index, cancellable))
+    {
+      result = new_index;
+      doc_result = new_doc_index;
+      goto finish;
+    }
 
-  /*
-   * Write the search index to disk.
-   */
-  if (!fuzzy_index_builder_write (builder,
-                                  index_file,
-                                  g_task_get_priority (task),
-                                  cancellable,
-                                  &error))
+  if (!build_indexes (self, file, mtime, cancellable, &new_index, &new_doc_index, &new_repository, &error))
     goto finish;
 
   /*
-   * Now mmap()'d our search index.
+   * The indexes are built in memory so that searches can use them right
+   * away. They are written to disk after we have handed them out, below.
    */
-  new_index = fuzzy_index_new ();
-  if (!fuzzy_index_load_file (new_index, index_file, cancellable, &error))
-    goto finish;
-
   result = new_index;
+  doc_result = new_doc_index;
+  needs_write = TRUE;
 
 finish:
   g_mutex_lock (&self->mutex);
 
+  if (result != NULL && self->index == NULL)
+    self->index = g_object_ref (result);
+
+  if (doc_result != NULL && self->doc_index == NULL)
+    {
+      self->doc_index = g_object_ref (doc_result);
+      rtfm_gir_doc_index_set_scheduler (self->doc_index, self->scheduler);
+    }
+
   list = self->index_tasks;
   self->index_tasks = NULL;
+  self->index_running = FALSE;
 
   for (iter = list; iter != NULL; iter = iter->next)
     {
@@ -732,16 +1473,113 @@ finish:
 
   g_slist_free_full (list, g_object_unref);
   g_clear_error (&error);
+
+  /*
+   * Save the freshly built indexes so the next startup can simply map
+   * them. Failing here only costs us a rebuild next time.
+   */
+  if (needs_write &&
+      !write_indexes (new_index, new_doc_index, index_path, doc_index_path, &error))
+    {
+      g_warning ("Failed to save index: %s", error->message);
+      g_clear_error (&error);
+    }
+
+  if (needs_write)
+    {
+      g_autofree gchar *repository_path = get_search_index_filename (file, ".repository");
+
+      if (!rtfm_gir_binary_write (new_repository, mtime, repository_path, &error))
+        {
+          g_warning ("Failed to save repository: %s", error->message);
+          g_clear_error (&error);
+        }
+    }
+
+  /* Only now can a waiting process find our indexes */
+  unlock_index (lock_fd);
+}
+
+/**
+ * rtfm_gir_file_compile:
+ * @self: An #RtfmGirFile
+ * @directory: The directory to write the compiled indexes to
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @error: A location for a #GError or %NULL
+ *
+ * Builds the indexes for the file and writes them to @directory along
+ * with its binary repository, from where rtfm_gir_file_load_index_async()
+ * and g_async_initable_init_async() can use them instead of building
+ * the work themselves. This is used by rtfm-gir-compiler, and the
+ * output only depends on the contents and mtime of the .gir file.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+rtfm_gir_file_compile (RtfmGirFile   *self,
+                       GFile         *directory,
+                       GCancellable  *cancellable,
+                       GError       **error)
+{
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(RtfmGirDocIndex) doc_index = NULL;
+  g_autoptr(RtfmGirRepository) repository = NULL;
+  g_autoptr(GFileInfo) file_info = NULL;
+  g_autofree gchar *dir = NULL;
+  g_autofree gchar *index_path = NULL;
+  g_autofree gchar *doc_index_path = NULL;
+  g_autofree gchar *repository_path = NULL;
+  guint64 mtime;
+
+  g_return_val_if_fail (RTFM_GIR_IS_FILE (self), FALSE);
+  g_return_val_if_fail (G_IS_FILE (directory), FALSE);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), FALSE);
+
+  file_info = g_file_query_info (self->file,
+                                 G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                 G_FILE_QUERY_INFO_NONE,
+                                 cancellable,
+                                 error);
+  if (file_info == NULL)
+    return FALSE;
+
+  mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  if (!build_indexes (self, self->file, mtime, cancellable, &index, &doc_index, &repository, error))
+    return FALSE;
+
+  dir = g_file_get_path (directory);
+  index_path = get_compiled_filename (dir, self->file, ".rtfm");
+  doc_index_path = get_compiled_filename (dir, self->file, ".docs.rtfm");
+  repository_path = get_compiled_filename (dir, self->file, ".repository.rtfm");
+
+  return write_indexes (index, doc_index, index_path, doc_index_path, error) &&
+         rtfm_gir_binary_write (repository, mtime, repository_path, error);
 }
 
+/**
+ * rtfm_gir_file_load_index_async:
+ * @self: An #RtfmGirFile
+ * @io_priority: The I/O priority of the request
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: A callback to execute upon completion
+ * @user_data: User data for @callback
+ *
+ * Loads the search index for the file, building it first if it is
+ * missing or out of date. Requests with an @io_priority lower than
+ * %G_PRIORITY_DEFAULT are run as background work, anything else is
+ * assumed to have the user waiting on it.
+ */
 void
 rtfm_gir_file_load_index_async (RtfmGirFile         *self,
+                                gint                 io_priority,
                                 GCancellable        *cancellable,
                                 GAsyncReadyCallback  callback,
                                 gpointer             user_data)
 {
   g_autoptr(GTask) task = NULL;
   g_autoptr(GMutexLocker) locker = NULL;
+  RtfmSchedulerPriority priority;
 
   g_return_if_fail (RTFM_GIR_IS_FILE (self));
   g_return_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable));
@@ -751,6 +1589,7 @@ rtfm_gir_file_load_index_async (RtfmGirFile         *self,
   task = g_task_new (self, cancellable, callback, user_data);
   g_task_set_check_cancellable (task, FALSE);
   g_task_set_task_data (task, g_object_ref (self->file), g_object_unref);
+  g_task_set_priority (task, io_priority);
 
   if (self->index != NULL)
     {
@@ -758,13 +1597,29 @@ rtfm_gir_file_load_index_async (RtfmGirFile         *self,
       return;
     }
 
+  priority = io_priority > G_PRIORITY_DEFAULT
+    ? RTFM_SCHEDULER_PRIORITY_BACKGROUND
+    : RTFM_SCHEDULER_PRIORITY_INTERACTIVE;
+
   /*
    * If there is another build request active, queue the result to
    * be completed by that worker instead of queing duplicated work.
+   * Should that request still be waiting behind background work while
+   * the user is waiting on us, queue it again at our priority. The
+   * worker which runs first completes both.
    */
   self->index_tasks = g_slist_prepend (self->index_tasks, g_object_ref (task));
-  if (self->index_tasks->next == NULL)
-    g_task_run_in_thread (task, rtfm_gir_file_load_index_worker);
+
+  if (self->index_tasks->next == NULL ||
+      (!self->index_running && priority < self->index_priority))
+    {
+      self->index_priority = priority;
+      rtfm_scheduler_run_in_thread (rtfm_gir_file_get_scheduler (self),
+                                    task,
+                                    priority,
+                                    0,
+                                    rtfm_gir_file_load_index_worker);
+    }
 }
 
 FuzzyIndex *
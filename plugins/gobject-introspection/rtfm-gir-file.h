@@ -21,7 +21,10 @@
 
 #include <fuzzy-glib.h>
 #include <gio/gio.h>
+#include <rtfm.h>
 
+#include "rtfm-gir-doc-index.h"
+#include "rtfm-gir-doc-index-builder.h"
 #include "rtfm-gir-item.h"
 #include "rtfm-gir-repository.h"
 
@@ -29,12 +32,28 @@ G_BEGIN_DECLS
 
 #define RTFM_GIR_TYPE_FILE (rtfm_gir_file_get_type())
 
+/* The RtfmScheduler group for parsing files on behalf of the tree */
+#define RTFM_GIR_FILE_PARSE_GROUP (rtfm_gir_file_parse_group_quark())
+
 G_DECLARE_FINAL_TYPE (RtfmGirFile, rtfm_gir_file, RTFM_GIR, FILE, GObject)
 
+GQuark             rtfm_gir_file_parse_group_quark (void);
 RtfmGirFile       *rtfm_gir_file_new               (GFile                *file);
+RtfmGirFile       *rtfm_gir_file_new_for_scheduler (GFile                *file,
+                                                    RtfmScheduler        *scheduler);
 GFile             *rtfm_gir_file_get_file          (RtfmGirFile          *self);
 RtfmGirRepository *rtfm_gir_file_get_repository    (RtfmGirFile          *self);
+RtfmGirDocIndex   *rtfm_gir_file_get_doc_index     (RtfmGirFile          *self);
+void               rtfm_gir_file_build_indexes     (RtfmGirFile          *self,
+                                                    RtfmGirRepository    *repository,
+                                                    FuzzyIndexBuilder    *builder,
+                                                    RtfmGirDocIndexBuilder *doc_builder);
+gboolean           rtfm_gir_file_compile           (RtfmGirFile          *self,
+                                                    GFile                *directory,
+                                                    GCancellable         *cancellable,
+                                                    GError              **error);
 void               rtfm_gir_file_load_index_async  (RtfmGirFile          *self,
+                                                    gint                  io_priority,
                                                     GCancellable          *cancellable,
                                                     GAsyncReadyCallback   callback,
                                                     gpointer              user_data);
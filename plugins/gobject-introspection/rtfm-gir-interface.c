@@ -442,6 +442,10 @@ rtfm_gir_interface_ingest (RtfmGirParserObject *object,
   self->c_type = rtfm_gir_parser_context_intern_string (parser_context, c_type);
   self->glib_type_struct = rtfm_gir_parser_context_intern_string (parser_context, glib_type_struct);
 
+  /* Members are parsed when the node is first browsed */
+  if (_rtfm_gir_parser_object_defer (RTFM_GIR_PARSER_OBJECT (self), context, element_name))
+    return TRUE;
+
   g_markup_parse_context_push (context, &markup_parser, self);
 
   return TRUE;
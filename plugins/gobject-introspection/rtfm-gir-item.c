@@ -438,7 +438,7 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
   else if (RTFM_GIR_IS_NAMESPACE (priv->object))
     {
       const gchar *id = rtfm_item_get_id (RTFM_ITEM (self));
-      g_autoptr(GPtrArray) ar = NULL;
+      GPtrArray *ar = NULL;
 
       if (FALSE) {}
       else if (g_strcmp0 ("gir:classes", id) == 0)
@@ -475,7 +475,7 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
   else if (RTFM_GIR_IS_CLASS (priv->object))
     {
       const gchar *id = rtfm_item_get_id (RTFM_ITEM (self));
-      g_autoptr(GPtrArray) ar = NULL;
+      GPtrArray *ar = NULL;
 
       if (FALSE) {}
       else if (g_strcmp0 ("gir:methods", id) == 0)
@@ -577,8 +577,6 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
                   item = rtfm_gir_item_new (object);
                   rtfm_collection_append (collection, g_steal_pointer (&item));
                 }
-
-              g_clear_pointer (&ar, g_ptr_array_unref);
             }
 
           ar = GET_CHILDREN_TYPED (record, UNION);
@@ -593,8 +591,6 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
                   item = rtfm_gir_item_new (object);
                   rtfm_collection_append (collection, g_steal_pointer (&item));
                 }
-
-              g_clear_pointer (&ar, g_ptr_array_unref);
             }
         }
       else if (HAS_CHILD_TYPED (record, FIELD) || HAS_CHILD_TYPED (record, UNION))
@@ -624,7 +620,7 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
   else if (RTFM_GIR_IS_ENUMERATION (priv->object))
     {
       RtfmGirEnumeration *enumeration = RTFM_GIR_ENUMERATION (priv->object);
-      g_autoptr(GPtrArray) ar = GET_CHILDREN_TYPED (enumeration, MEMBER);
+      GPtrArray *ar = GET_CHILDREN_TYPED (enumeration, MEMBER);
 
       if (ar != NULL)
         {
@@ -643,7 +639,7 @@ rtfm_gir_item_populate_async (RtfmGirItem         *self,
   else if (RTFM_GIR_IS_BITFIELD (priv->object))
     {
       RtfmGirBitfield *bitfield = RTFM_GIR_BITFIELD (priv->object);
-      g_autoptr(GPtrArray) ar = GET_CHILDREN_TYPED (bitfield, MEMBER);
+      GPtrArray *ar = GET_CHILDREN_TYPED (bitfield, MEMBER);
 
       if (ar != NULL)
         {
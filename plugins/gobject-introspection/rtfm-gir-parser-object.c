@@ -18,20 +18,59 @@
 
 #define G_LOG_DOMAIN "rtfm-gir-parser-object"
 
+#include <string.h>
+
 #include "rtfm-gir-parser-types.h"
 
 typedef struct
 {
-  RtfmGirParserObject  *parent;
-  RtfmGirParserContext *parser_context;
+  RtfmGirParserObject    *parent;
+  RtfmGirParserContext   *parser_context;
+
+  /*
+   * Objects loaded from a binary repository, or whose body was skipped
+   * while parsing, create their children the first time they are asked
+   * for them.
+   */
+  RtfmGirMaterializeFunc  materialize;
+  gpointer                materialize_data;
+  GDestroyNotify          materialize_notify;
+
+  /*
+   * The children by type, built in one pass the first time they are
+   * asked for by type. Maps GType to a GPtrArray of borrowed children.
+   */
+  GHashTable             *buckets;
 } RtfmGirParserObjectPrivate;
 
 struct _RtfmGirParserContext
 {
-  volatile gint ref_count;
-  GStringChunk *strings;
+  volatile gint  ref_count;
+  GStringChunk  *strings;
+
+  /*
+   * The text being parsed, when element bodies may be deferred, and the
+   * offset of the line GMarkup is on within it. GMarkup only tells us
+   * the line and column, so this is advanced as it goes.
+   */
+  GBytes        *contents;
+  gsize          base;
+  gint           line;
+  gsize          line_offset;
 };
 
+typedef struct
+{
+  GBytes *contents;
+  gsize   offset;
+} Deferred;
+
+typedef struct
+{
+  RtfmGirParserObject *object;
+  guint                done : 1;
+} DeferredParse;
+
 enum {
   PROP_0,
   PROP_PARSER_CONTEXT,
@@ -40,6 +79,9 @@ enum {
 
 static GParamSpec *properties [N_PROPS];
 
+static GMutex materialize_mutex;
+static GMutex buckets_mutex;
+
 G_DEFINE_TYPE_WITH_PRIVATE (RtfmGirParserObject, rtfm_gir_parser_object, G_TYPE_OBJECT)
 G_DEFINE_BOXED_TYPE (RtfmGirParserContext, rtfm_gir_parser_context, rtfm_gir_parser_context_ref, rtfm_gir_parser_context_unref)
 
@@ -75,20 +117,164 @@ rtfm_gir_parser_context_unref (RtfmGirParserContext *self)
   if (g_atomic_int_dec_and_test (&self->ref_count))
     {
       g_string_chunk_free (self->strings);
+      g_clear_pointer (&self->contents, g_bytes_unref);
       g_slice_free (RtfmGirParserContext, self);
     }
 }
 
+/*
+ * Attribute values which most elements of every repository repeat, such
+ * as "none", "full" and the fundamental type names. These are shared by
+ * all repositories rather than copied into each of them. The set is
+ * fixed, so unlike the strings of a context it never grows.
+ */
+static const gchar *vocabulary[] = {
+  "0", "1",
+  "in", "out", "inout",
+  "none", "container", "full", "floating",
+  "call", "async", "notified", "forever",
+  "Stable", "Unstable", "Private",
+  "gboolean", "gchar", "guchar", "gint", "guint", "gint8", "guint8",
+  "gint16", "guint16", "gint32", "guint32", "gint64", "guint64",
+  "glong", "gulong", "gsize", "gssize", "gfloat", "gdouble",
+  "gpointer", "gconstpointer", "utf8", "filename", "GType",
+  "gchar*", "const gchar*", "void",
+};
+
+static GHashTable *
+get_vocabulary (void)
+{
+  static GHashTable *table;
+
+  if (g_once_init_enter (&table))
+    {
+      GHashTable *ret = g_hash_table_new (g_str_hash, g_str_equal);
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (vocabulary); i++)
+        g_hash_table_add (ret, (gchar *)vocabulary [i]);
+
+      g_once_init_leave (&table, ret);
+    }
+
+  return table;
+}
+
+/**
+ * rtfm_gir_parser_context_intern_string:
+ * @self: A #RtfmGirParserContext
+ * @string: (nullable): A string or %NULL
+ *
+ * Gets a copy of @string which lives as long as @self. Common attribute
+ * values are shared with every other context instead.
+ *
+ * Returns: (nullable): The interned copy of @string.
+ */
 const gchar *
 rtfm_gir_parser_context_intern_string (RtfmGirParserContext *self,
-                                       const gchar *string)
+                                       const gchar          *string)
 {
+  const gchar *ret;
+
   g_return_val_if_fail (self != NULL, NULL);
 
   if (string == NULL)
     return NULL;
-  else
-    return g_string_chunk_insert_const (self->strings, string);
+
+  if (NULL != (ret = g_hash_table_lookup (get_vocabulary (), string)))
+    return ret;
+
+  return g_string_chunk_insert_const (self->strings, string);
+}
+
+/*
+ * While @contents is set, the bodies of classes, interfaces and records
+ * found in it are skipped and parsed when their children are needed.
+ * @base is the offset within @contents that GMarkup is given.
+ */
+void
+_rtfm_gir_parser_context_set_contents (RtfmGirParserContext *self,
+                                       GBytes               *contents,
+                                       gsize                 base)
+{
+  g_return_if_fail (self != NULL);
+
+  if (contents != NULL)
+    g_bytes_ref (contents);
+
+  g_clear_pointer (&self->contents, g_bytes_unref);
+
+  self->contents = contents;
+  self->base = base;
+  self->line = 1;
+  self->line_offset = base;
+}
+
+/*
+ * Finds where the start tag GMarkup has just read begins. Returns FALSE
+ * if it cannot be found exactly, or the element has no body, in which
+ * case it is parsed as usual.
+ */
+static gboolean
+rtfm_gir_parser_context_locate (RtfmGirParserContext *self,
+                                GMarkupParseContext  *context,
+                                const gchar          *element_name,
+                                gsize                *offset)
+{
+  const gchar *data;
+  gsize element_len;
+  gsize len;
+  gsize end;
+  gsize pos;
+  gint line = 0;
+  gint char_number = 0;
+
+  g_assert (self != NULL);
+  g_assert (self->contents != NULL);
+
+  data = g_bytes_get_data (self->contents, &len);
+  element_len = strlen (element_name);
+
+  g_markup_parse_context_get_position (context, &line, &char_number);
+
+  /* GMarkup counts the newline as the first character of the next line */
+  while (self->line < line)
+    {
+      const gchar *nl = NULL;
+
+      if (self->line_offset + 1 < len)
+        nl = memchr (data + self->line_offset + 1, '\n', len - self->line_offset - 1);
+
+      if (nl == NULL)
+        return FALSE;
+
+      self->line++;
+      self->line_offset = nl - data;
+    }
+
+  /* GMarkup is just past the '>' of the start tag */
+  end = self->line_offset + char_number - 1;
+
+  if (end > self->base && end <= len && data [end - 1] == '>')
+    end--;
+  else if (end >= len || data [end] != '>')
+    return FALSE;
+
+  if (end <= self->base || data [end - 1] == '/')
+    return FALSE;
+
+  /* Attribute values cannot contain '<', so this is the start of the tag */
+  for (pos = end; pos > self->base && data [pos] != '<'; pos--) { }
+
+  if (data [pos] != '<' ||
+      end - pos <= element_len ||
+      strncmp (&data [pos + 1], element_name, element_len) != 0 ||
+      !(g_ascii_isspace (data [pos + 1 + element_len]) || data [pos + 1 + element_len] == '>'))
+    return FALSE;
+
+  *offset = pos;
+
+  return TRUE;
 }
 
 /**
@@ -109,6 +295,28 @@ rtfm_gir_parser_object_get_parser_context (RtfmGirParserObject *self)
   return priv->parser_context;
 }
 
+/*
+ * Forgets the children of @self sorted by type, as they are about to
+ * change.
+ */
+static void
+rtfm_gir_parser_object_clear_buckets (RtfmGirParserObject *self)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+
+  /* Nothing was asked for by type yet while parsing, so skip the lock */
+  if G_LIKELY (g_atomic_pointer_get (&priv->buckets) == NULL)
+    return;
+
+  g_mutex_lock (&buckets_mutex);
+  g_clear_pointer (&priv->buckets, g_hash_table_unref);
+  g_mutex_unlock (&buckets_mutex);
+}
+
+/*
+ * Every parser calls this right before appending @self to the children
+ * of @parent, so it also forgets the buckets of @parent.
+ */
 void
 _rtfm_gir_parser_object_set_parent (RtfmGirParserObject *self,
                                     RtfmGirParserObject *parent)
@@ -119,6 +327,195 @@ _rtfm_gir_parser_object_set_parent (RtfmGirParserObject *self,
   g_return_if_fail (!parent || RTFM_GIR_IS_PARSER_OBJECT (parent));
 
   priv->parent = parent;
+
+  if (parent != NULL)
+    rtfm_gir_parser_object_clear_buckets (parent);
+}
+
+/*
+ * Defers creating the children of @self until they are first needed,
+ * at which point @func is called with the (empty) children array of
+ * @self to fill in.
+ */
+void
+_rtfm_gir_parser_object_set_materialize (RtfmGirParserObject    *self,
+                                         RtfmGirMaterializeFunc  func,
+                                         gpointer                user_data,
+                                         GDestroyNotify          notify)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+
+  g_return_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self));
+  g_return_if_fail (func != NULL);
+  g_return_if_fail (priv->materialize == NULL);
+
+  priv->materialize_data = user_data;
+  priv->materialize_notify = notify;
+  g_atomic_pointer_set (&priv->materialize, func);
+}
+
+static void
+rtfm_gir_parser_object_materialize (RtfmGirParserObject *self)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+
+  g_assert (RTFM_GIR_IS_PARSER_OBJECT (self));
+
+  /* The tree is browsed from the main thread but indexed from workers */
+  g_mutex_lock (&materialize_mutex);
+
+  if (priv->materialize != NULL)
+    {
+      RtfmGirMaterializeFunc func = priv->materialize;
+      GPtrArray *children = NULL;
+
+      if (RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->get_children)
+        children = RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->get_children (self);
+
+      if (children != NULL)
+        func (self, children, priv->materialize_data);
+
+      rtfm_gir_parser_object_clear_buckets (self);
+
+      if (priv->materialize_notify != NULL)
+        priv->materialize_notify (priv->materialize_data);
+
+      priv->materialize_data = NULL;
+      priv->materialize_notify = NULL;
+      g_atomic_pointer_set (&priv->materialize, NULL);
+    }
+
+  g_mutex_unlock (&materialize_mutex);
+}
+
+static void
+deferred_free (gpointer data)
+{
+  Deferred *deferred = data;
+
+  g_bytes_unref (deferred->contents);
+  g_slice_free (Deferred, deferred);
+}
+
+static void
+deferred_start_element (GMarkupParseContext  *context,
+                        const gchar          *element_name,
+                        const gchar         **attribute_names,
+                        const gchar         **attribute_values,
+                        gpointer              user_data,
+                        GError              **error)
+{
+  DeferredParse *state = user_data;
+
+  rtfm_gir_parser_object_ingest (state->object,
+                                 context,
+                                 element_name,
+                                 attribute_names,
+                                 attribute_values,
+                                 error);
+}
+
+static void
+deferred_end_element (GMarkupParseContext  *context,
+                      const gchar          *element_name,
+                      gpointer              user_data,
+                      GError              **error)
+{
+  DeferredParse *state = user_data;
+
+  g_markup_parse_context_pop (context);
+
+  /* Stops GMarkup from reading on into the rest of the file */
+  state->done = TRUE;
+  g_set_error_literal (error, G_MARKUP_ERROR, G_MARKUP_ERROR_PARSE, "Element parsed");
+}
+
+static const GMarkupParser deferred_parser = {
+  deferred_start_element,
+  deferred_end_element,
+  NULL,
+  NULL,
+  NULL,
+};
+
+/* Ignores the body of an element until it is parsed for real */
+static const GMarkupParser skip_parser = { NULL };
+
+static void
+rtfm_gir_parser_object_parse_deferred (RtfmGirParserObject *self,
+                                       GPtrArray           *children,
+                                       gpointer             user_data)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+  g_autoptr(GMarkupParseContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  DeferredParse state = { self, FALSE };
+  Deferred *deferred = user_data;
+  const gchar *data;
+  gsize len;
+
+  g_assert (RTFM_GIR_IS_PARSER_OBJECT (self));
+  g_assert (deferred != NULL);
+
+  data = g_bytes_get_data (deferred->contents, &len);
+
+  /*
+   * The element is parsed again from its start tag, so that it is set up
+   * exactly as it would have been. Only the children are new.
+   */
+  _rtfm_gir_parser_context_set_contents (priv->parser_context, deferred->contents, deferred->offset);
+
+  context = g_markup_parse_context_new (&deferred_parser, 0, &state, NULL);
+
+  if (!g_markup_parse_context_parse (context, data + deferred->offset, len - deferred->offset, &error) &&
+      !state.done)
+    g_warning ("Failed to parse %s: %s", G_OBJECT_TYPE_NAME (self), error->message);
+
+  _rtfm_gir_parser_context_set_contents (priv->parser_context, NULL, 0);
+}
+
+/*
+ * Called from the ingest of elements with large bodies. If the parser
+ * context allows it, the body is skipped over and @self is set up to
+ * parse it when its children are first needed, and %TRUE is returned.
+ * Otherwise the caller should parse the body as usual.
+ */
+gboolean
+_rtfm_gir_parser_object_defer (RtfmGirParserObject *self,
+                               GMarkupParseContext *context,
+                               const gchar         *element_name)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+  const GSList *stack;
+  Deferred *deferred;
+  gsize offset;
+
+  g_return_val_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self), FALSE);
+  g_return_val_if_fail (context != NULL, FALSE);
+
+  if (priv->parser_context == NULL || priv->parser_context->contents == NULL)
+    return FALSE;
+
+  /* The element at the root is the one whose body is being parsed */
+  stack = g_markup_parse_context_get_element_stack (context);
+  if (stack == NULL || stack->next == NULL)
+    return FALSE;
+
+  if (!rtfm_gir_parser_context_locate (priv->parser_context, context, element_name, &offset))
+    return FALSE;
+
+  deferred = g_slice_new (Deferred);
+  deferred->contents = g_bytes_ref (priv->parser_context->contents);
+  deferred->offset = offset;
+
+  _rtfm_gir_parser_object_set_materialize (self,
+                                           rtfm_gir_parser_object_parse_deferred,
+                                           deferred,
+                                           deferred_free);
+
+  g_markup_parse_context_push (context, &skip_parser, NULL);
+
+  return TRUE;
 }
 
 /**
@@ -148,6 +545,11 @@ rtfm_gir_parser_object_finalize (GObject *object)
 
   g_clear_pointer (&priv->parser_context, rtfm_gir_parser_context_unref);
 
+  if (priv->materialize_notify != NULL)
+    priv->materialize_notify (priv->materialize_data);
+
+  g_clear_pointer (&priv->buckets, g_hash_table_unref);
+
   G_OBJECT_CLASS (rtfm_gir_parser_object_parent_class)->finalize (object);
 }
 
@@ -226,49 +628,107 @@ rtfm_gir_parser_object_init (RtfmGirParserObject *self)
 GPtrArray *
 rtfm_gir_parser_object_get_children (RtfmGirParserObject *self)
 {
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+
   g_return_val_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self), NULL);
 
+  if G_UNLIKELY (g_atomic_pointer_get (&priv->materialize) != NULL)
+    rtfm_gir_parser_object_materialize (self);
+
   if (RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->get_children)
     return RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->get_children (self);
 
   return NULL;
 }
 
+/*
+ * Gets the children of @self of @type, sorting all of the children into
+ * buckets by their exact type the first time. Every node type is final,
+ * so that is all that is needed unless @type is an ancestor, in which
+ * case its bucket is filled in separately.
+ *
+ * Must be called with buckets_mutex held.
+ */
+static GPtrArray *
+rtfm_gir_parser_object_get_bucket (RtfmGirParserObject *self,
+                                   GType                type)
+{
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+  GPtrArray *children;
+  GPtrArray *bucket;
+  guint i;
+
+  if G_UNLIKELY (priv->buckets == NULL)
+    {
+      priv->buckets = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify)g_ptr_array_unref);
+
+      if (NULL != (children = rtfm_gir_parser_object_get_children (self)))
+        {
+          for (i = 0; i < children->len; i++)
+            {
+              RtfmGirParserObject *child = g_ptr_array_index (children, i);
+              GType child_type = G_OBJECT_TYPE (child);
+
+              bucket = g_hash_table_lookup (priv->buckets, GSIZE_TO_POINTER (child_type));
+
+              if (bucket == NULL)
+                {
+                  bucket = g_ptr_array_new ();
+                  g_hash_table_insert (priv->buckets, GSIZE_TO_POINTER (child_type), bucket);
+                }
+
+              g_ptr_array_add (bucket, child);
+            }
+        }
+    }
+
+  if (NULL != (bucket = g_hash_table_lookup (priv->buckets, GSIZE_TO_POINTER (type))))
+    return bucket;
+
+  bucket = g_ptr_array_new ();
+
+  if (NULL != (children = rtfm_gir_parser_object_get_children (self)))
+    {
+      for (i = 0; i < children->len; i++)
+        {
+          RtfmGirParserObject *child = g_ptr_array_index (children, i);
+
+          if (g_type_is_a (G_OBJECT_TYPE (child), type))
+            g_ptr_array_add (bucket, child);
+        }
+    }
+
+  g_hash_table_insert (priv->buckets, GSIZE_TO_POINTER (type), bucket);
+
+  return bucket;
+}
+
 /**
  * rtfm_gir_parser_object_get_children_typed:
  * @self: An #RtfmGirParserObject
  * @type: A #GType
  *
- * Gets all children of @self which are of type @type.
+ * Gets all children of @self which are of type @type, in document
+ * order. The array belongs to @self and must not be modified. It is
+ * only valid until the children of @self change.
  *
- * Returns: (transfer container) (element-type RtfmGir.ParserObject): An
+ * Returns: (transfer none) (element-type RtfmGir.ParserObject): An
  *   array of RtfmGirParserObject instances matching @type.
  */
 GPtrArray *
 rtfm_gir_parser_object_get_children_typed (RtfmGirParserObject *self,
                                            GType type)
 {
-  GPtrArray *ar;
   GPtrArray *ret;
 
   g_return_val_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self), NULL);
 
-  ret = g_ptr_array_new ();
+  /* Creates the children, if needed, before we take our lock */
+  rtfm_gir_parser_object_get_children (self);
 
-  ar = rtfm_gir_parser_object_get_children (self);
-
-  if (ar != NULL)
-    {
-      guint i;
-
-      for (i = 0; i < ar->len; i++)
-        {
-          RtfmGirParserObject *item = g_ptr_array_index (ar, i);
-
-          if (g_type_is_a (G_OBJECT_TYPE (item), type))
-            g_ptr_array_add (ret, item);
-        }
-    }
+  g_mutex_lock (&buckets_mutex);
+  ret = rtfm_gir_parser_object_get_bucket (self, type);
+  g_mutex_unlock (&buckets_mutex);
 
   return ret;
 }
@@ -277,20 +737,36 @@ gboolean
 rtfm_gir_parser_object_has_child_typed (RtfmGirParserObject *self,
                                         GType type)
 {
-  GPtrArray *ar;
+  RtfmGirParserObjectPrivate *priv = rtfm_gir_parser_object_get_instance_private (self);
+  GPtrArray *children;
+  GPtrArray *bucket = NULL;
+  gboolean found = FALSE;
   guint i;
 
   g_return_val_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self), FALSE);
 
-  ar = rtfm_gir_parser_object_get_children (self);
+  /* Creates the children, if needed, before we take our lock */
+  children = rtfm_gir_parser_object_get_children (self);
 
-  if (ar != NULL)
+  /* Use the bucket when the children were already sorted by type */
+  if (g_atomic_pointer_get (&priv->buckets) != NULL)
     {
-      for (i = 0; i < ar->len; i++)
-        {
-          GObject *object = g_ptr_array_index (ar, i);
+      g_mutex_lock (&buckets_mutex);
+      if (priv->buckets != NULL &&
+          NULL != (bucket = g_hash_table_lookup (priv->buckets, GSIZE_TO_POINTER (type))))
+        found = bucket->len > 0;
+      g_mutex_unlock (&buckets_mutex);
+
+      if (bucket != NULL)
+        return found;
+    }
 
-          if (g_type_is_a (G_TYPE_FROM_INSTANCE (object), type))
+  /* Otherwise stop at the first match, without sorting the children */
+  if (children != NULL)
+    {
+      for (i = 0; i < children->len; i++)
+        {
+          if (g_type_is_a (G_OBJECT_TYPE (g_ptr_array_index (children, i)), type))
             return TRUE;
         }
     }
@@ -326,6 +802,9 @@ rtfm_gir_parser_object_printf (RtfmGirParserObject *self,
   g_return_if_fail (RTFM_GIR_IS_PARSER_OBJECT (self));
   g_return_if_fail (str != NULL);
 
+  /* The printf implementations use the children directly */
+  rtfm_gir_parser_object_get_children (self);
+
   if (RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->printf)
     RTFM_GIR_PARSER_OBJECT_GET_CLASS (self)->printf (self, str, depth);
 }
@@ -138,6 +138,18 @@ gboolean   rtfm_gir_parser_object_has_child_typed    (RtfmGirParserObject *self,
 
 void _rtfm_gir_parser_object_set_parent (RtfmGirParserObject *self,
                                          RtfmGirParserObject *parent) G_GNUC_INTERNAL;
+
+typedef void (*RtfmGirMaterializeFunc) (RtfmGirParserObject *self,
+                                        GPtrArray *children,
+                                        gpointer user_data);
+
+void _rtfm_gir_parser_object_set_materialize (RtfmGirParserObject *self,
+                                              RtfmGirMaterializeFunc func,
+                                              gpointer user_data,
+                                              GDestroyNotify notify) G_GNUC_INTERNAL;
+gboolean _rtfm_gir_parser_object_defer (RtfmGirParserObject *self,
+                                        GMarkupParseContext *context,
+                                        const gchar *element_name) G_GNUC_INTERNAL;
 RtfmGirParserObject *rtfm_gir_parser_object_get_parent (RtfmGirParserObject *self);
 
 RtfmGirParserContext *rtfm_gir_parser_object_get_parser_context (RtfmGirParserObject *self);
@@ -155,6 +167,7 @@ RtfmGirParserContext *rtfm_gir_parser_context_new (void);
 RtfmGirParserContext *rtfm_gir_parser_context_ref (RtfmGirParserContext *self);
 void rtfm_gir_parser_context_unref (RtfmGirParserContext *self);
 const gchar *rtfm_gir_parser_context_intern_string (RtfmGirParserContext *self, const gchar *string);
+void _rtfm_gir_parser_context_set_contents (RtfmGirParserContext *self, GBytes *contents, gsize base) G_GNUC_INTERNAL;
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (RtfmGirParserContext, rtfm_gir_parser_context_unref)
 
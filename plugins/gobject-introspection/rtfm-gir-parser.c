@@ -25,6 +25,14 @@ struct _RtfmGirParser
   GObject parent_instance;
 };
 
+typedef struct
+{
+  RtfmGirRepository *result;
+
+  /* Set when the bodies of large elements are to be parsed on demand */
+  GBytes            *contents;
+} ParseState;
+
 G_DEFINE_TYPE (RtfmGirParser, rtfm_gir_parser, G_TYPE_OBJECT)
 
 static void
@@ -45,13 +53,13 @@ rtfm_gir_start_element (GMarkupParseContext *context,
                         gpointer user_data,
                         GError **error)
 {
-  RtfmGirRepository **result = user_data;
+  ParseState *state = user_data;
 
   g_assert (context != NULL);
   g_assert (element_name != NULL);
   g_assert (attribute_names != NULL);
   g_assert (attribute_values != NULL);
-  g_assert (result != NULL);
+  g_assert (state != NULL);
 
   if (g_str_equal (element_name, "repository"))
     {
@@ -61,6 +69,9 @@ rtfm_gir_start_element (GMarkupParseContext *context,
       parser_context = rtfm_gir_parser_context_new ();
       child = rtfm_gir_repository_new (parser_context);
 
+      if (state->contents != NULL)
+        _rtfm_gir_parser_context_set_contents (parser_context, state->contents, 0);
+
       if (rtfm_gir_parser_object_ingest (RTFM_GIR_PARSER_OBJECT (child),
                                          context,
                                          element_name,
@@ -68,8 +79,8 @@ rtfm_gir_start_element (GMarkupParseContext *context,
                                          attribute_values,
                                          error))
         {
-          g_clear_object (result);
-          *result = g_steal_pointer (&child);
+          g_clear_object (&state->result);
+          state->result = g_steal_pointer (&child);
         }
     }
 }
@@ -97,6 +108,62 @@ static const GMarkupParser markup_parser = {
   NULL,
 };
 
+static RtfmGirRepository *
+rtfm_gir_parser_parse (RtfmGirParser  *self,
+                       GFile          *file,
+                       gboolean        skeleton,
+                       GCancellable   *cancellable,
+                       GError        **error)
+{
+  g_autoptr(GMarkupParseContext) context = NULL;
+  g_autoptr(GBytes) contents = NULL;
+  ParseState state = { NULL, NULL };
+  gchar *content = NULL;
+  gsize content_len = 0;
+  gboolean ret;
+
+  g_assert (RTFM_GIR_IS_PARSER (self));
+  g_assert (G_IS_FILE (file));
+
+  if (!g_file_load_contents (file, cancellable, &content, &content_len, NULL, error))
+    return NULL;
+
+  contents = g_bytes_new_take (content, content_len);
+
+  if (skeleton)
+    state.contents = contents;
+
+  context = g_markup_parse_context_new (&markup_parser, 0, &state, NULL);
+
+  ret = g_markup_parse_context_parse (context, content, content_len, error) &&
+        g_markup_parse_context_end_parse (context, error);
+
+  if (state.result != NULL)
+    {
+      RtfmGirParserObject *object = RTFM_GIR_PARSER_OBJECT (state.result);
+
+      /* Skipped bodies hold on to the contents themselves */
+      _rtfm_gir_parser_context_set_contents (rtfm_gir_parser_object_get_parser_context (object), NULL, 0);
+    }
+
+  if (!ret)
+    {
+      g_clear_object (&state.result);
+      return NULL;
+    }
+
+  if (state.result == NULL)
+    {
+      g_set_error (error,
+                   G_MARKUP_ERROR,
+                   G_MARKUP_ERROR_INVALID_CONTENT,
+                   "Failed to locate \"repository\" element");
+      return NULL;
+    }
+
+  return state.result;
+}
+
 /**
  * rtfm_gir_parser_parse_file:
  * @self: A #RtfmGirParser
@@ -114,36 +181,39 @@ rtfm_gir_parser_parse_file (RtfmGirParser *self,
                             GCancellable *cancellable,
                             GError **error)
 {
-  g_autoptr(GMarkupParseContext) context = NULL;
-  g_autoptr(RtfmGirRepository) ret = NULL;
-  g_autofree gchar *content = NULL;
-  gsize content_len = 0;
-
   g_return_val_if_fail (RTFM_GIR_IS_PARSER (self), NULL);
   g_return_val_if_fail (G_IS_FILE (file), NULL);
   g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
 
-  if (!g_file_load_contents (file, cancellable, &content, &content_len, NULL, error))
-    return NULL;
-
-  context = g_markup_parse_context_new (&markup_parser, 0, &ret, NULL);
-
-  if (!g_markup_parse_context_parse (context, content, content_len, error))
-    return NULL;
-
-  if (!g_markup_parse_context_end_parse (context, error))
-    return NULL;
+  return rtfm_gir_parser_parse (self, file, FALSE, cancellable, error);
+}
 
-  if (ret == NULL)
-    {
-      g_set_error (error,
-                   G_MARKUP_ERROR,
-                   G_MARKUP_ERROR_INVALID_CONTENT,
-                   "Failed to locate \"repository\" element");
-      return NULL;
-    }
+/**
+ * rtfm_gir_parser_parse_skeleton:
+ * @self: A #RtfmGirParser
+ * @file: A #GFile
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @error: A location for a #GError or %NULL.
+ *
+ * Like rtfm_gir_parser_parse_file(), but the members of classes,
+ * interfaces and records are skipped over. Each of them remembers where
+ * its element starts and parses it when its children are first needed,
+ * so that the cost of opening a namespace does not grow with everything
+ * in it. The contents of @file are kept in memory until then.
+ *
+ * Returns: (transfer full): An #RtfmGirRepository or %NULL upon failure.
+ */
+RtfmGirRepository *
+rtfm_gir_parser_parse_skeleton (RtfmGirParser *self,
+                                GFile *file,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+  g_return_val_if_fail (RTFM_GIR_IS_PARSER (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (!cancellable || G_IS_CANCELLABLE (cancellable), NULL);
 
-  return g_steal_pointer (&ret);
+  return rtfm_gir_parser_parse (self, file, TRUE, cancellable, error);
 }
 
 RtfmGirParser *
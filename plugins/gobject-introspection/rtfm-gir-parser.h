@@ -35,6 +35,10 @@ RtfmGirRepository *rtfm_gir_parser_parse_file (RtfmGirParser *self,
                                            GFile *file,
                                            GCancellable *cancellable,
                                            GError **error);
+RtfmGirRepository *rtfm_gir_parser_parse_skeleton (RtfmGirParser *self,
+                                                   GFile *file,
+                                                   GCancellable *cancellable,
+                                                   GError **error);
 
 G_END_DECLS
 
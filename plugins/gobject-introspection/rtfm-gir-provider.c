@@ -31,16 +31,51 @@
 #include "rtfm-gir-search-result.h"
 
 #define RTFM_GIR_PROVIDER_SEARCH_MAX 25
+#define RTFM_GIR_PROVIDER_RECENT_MAX 8
+#define RTFM_GIR_PROVIDER_DISCOVER_BATCH 50
+#define RTFM_GIR_PROVIDER_REFRESH_DELAY 1
+
+/*
+ * BM25 scores are unbounded, so documentation matches are squashed into
+ * [0, DOC_SCORE_SCALE) to be comparable with name matches. A BM25 score
+ * of DOC_SCORE_HALF maps to half of that range.
+ */
+#define RTFM_GIR_PROVIDER_DOC_SCORE_SCALE 0.5f
+#define RTFM_GIR_PROVIDER_DOC_SCORE_HALF  10.0f
 
 struct _RtfmGirProvider
 {
   GObject    object;
 
-  GPtrArray *files;
-  GPtrArray *search_indexes;
+  /* Unowned, set between initialize and shutdown */
+  RtfmLibrary *library;
+
+  GPtrArray  *files;
+  GPtrArray  *search_indexes;
+  GPtrArray  *doc_indexes;
+
+  /* RtfmGirFile to its FuzzyIndex, which is owned by search_indexes */
+  GHashTable *loaded;
+
+  /* Basenames of recently visited .gir files, most recent first */
+  GQueue      recent;
 
-  GSList    *search_index_tasks;
-  guint      search_indexes_loaded : 1;
+  /* Files left to load once we are idle, recently visited first */
+  GPtrArray  *prewarm_queue;
+  guint       prewarm_source;
+
+  /* Tasks waiting for the .gir files to be discovered */
+  GSList     *discover_tasks;
+  guint       discovered : 1;
+
+  /* The directories that were searched, and their GFileMonitors */
+  GPtrArray  *roots;
+  GPtrArray  *monitors;
+
+  /* Basenames of .gir files which changed since the last refresh */
+  GHashTable *changed;
+  guint       changed_source;
+  GCancellable *refresh_cancellable;
 };
 
 typedef struct
@@ -48,6 +83,13 @@ typedef struct
   RtfmSearchResults *results;
   gchar *query;
   guint active;
+
+  /*
+   * The ids of documents already added from name matches. Cursors publish
+   * provisional results before their final ones, so the same document can
+   * be seen more than once.
+   */
+  GHashTable *seen;
 } SearchState;
 
 typedef struct
@@ -55,214 +97,1332 @@ typedef struct
   guint active;
 } LoadIndexState;
 
-static void provider_iface_init (RtfmProviderInterface *iface);
+typedef struct
+{
+  GFile   *file;
+  guint64  mtime;
+} Candidate;
+
+typedef struct
+{
+  RtfmGirProvider *self;
+
+  /* The directories to search, in order of preference */
+  GPtrArray       *roots;
+  guint            root;
+
+  /* Basename, which is the namespace-version, to Candidate */
+  GHashTable      *found;
+} DiscoverState;
+
+typedef struct
+{
+  GPtrArray *roots;
+  GPtrArray *names;
+} RefreshState;
+
+static void provider_iface_init (RtfmProviderInterface *iface);
+
+G_DEFINE_TYPE_EXTENDED (RtfmGirProvider, rtfm_gir_provider, G_TYPE_OBJECT, 0,
+                        G_IMPLEMENT_INTERFACE (RTFM_TYPE_PROVIDER, provider_iface_init))
+
+static void
+candidate_free (gpointer data)
+{
+  Candidate *candidate = data;
+
+  /* Files that are gone are resolved to no candidate at all */
+  if (candidate == NULL)
+    return;
+
+  g_clear_object (&candidate->file);
+  g_slice_free (Candidate, candidate);
+}
+
+static void
+discover_state_free (DiscoverState *state)
+{
+  g_clear_object (&state->self);
+  g_clear_pointer (&state->roots, g_ptr_array_unref);
+  g_clear_pointer (&state->found, g_hash_table_unref);
+  g_slice_free (DiscoverState, state);
+}
+
+static void
+refresh_state_free (gpointer data)
+{
+  RefreshState *state = data;
+
+  g_clear_pointer (&state->roots, g_ptr_array_unref);
+  g_clear_pointer (&state->names, g_ptr_array_unref);
+  g_slice_free (RefreshState, state);
+}
+
+static void
+search_state_free (gpointer data)
+{
+  SearchState *state = data;
+
+  g_clear_pointer (&state->query, g_free);
+  g_clear_pointer (&state->seen, g_hash_table_unref);
+  g_clear_object (&state->results);
+  g_slice_free (SearchState, state);
+}
+
+static void
+rtfm_gir_provider_finalize (GObject *object)
+{
+  RtfmGirProvider *self = (RtfmGirProvider *)object;
+
+  g_clear_pointer (&self->files, g_ptr_array_unref);
+  g_clear_pointer (&self->search_indexes, g_ptr_array_unref);
+  g_clear_pointer (&self->doc_indexes, g_ptr_array_unref);
+  g_clear_pointer (&self->loaded, g_hash_table_unref);
+  g_clear_pointer (&self->prewarm_queue, g_ptr_array_unref);
+  g_clear_pointer (&self->roots, g_ptr_array_unref);
+  g_clear_pointer (&self->monitors, g_ptr_array_unref);
+  g_clear_pointer (&self->changed, g_hash_table_unref);
+  g_clear_object (&self->refresh_cancellable);
+
+  if (self->changed_source != 0)
+    {
+      g_source_remove (self->changed_source);
+      self->changed_source = 0;
+    }
+
+  g_queue_foreach (&self->recent, (GFunc)g_free, NULL);
+  g_queue_clear (&self->recent);
+
+  g_slist_free_full (self->discover_tasks, g_object_unref);
+  self->discover_tasks = NULL;
+
+  G_OBJECT_CLASS (rtfm_gir_provider_parent_class)->finalize (object);
+}
+
+static void
+rtfm_gir_provider_class_init (RtfmGirProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = rtfm_gir_provider_finalize;
+}
+
+static void
+rtfm_gir_provider_init (RtfmGirProvider *self)
+{
+  self->files = g_ptr_array_new_with_free_func (g_object_unref);
+  self->search_indexes = g_ptr_array_new_with_free_func (g_object_unref);
+  self->doc_indexes = g_ptr_array_new_with_free_func (g_object_unref);
+  self->loaded = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  self->changed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->refresh_cancellable = g_cancellable_new ();
+  g_queue_init (&self->recent);
+}
+
+static gboolean
+rtfm_gir_provider_has_file (RtfmGirProvider *self,
+                            RtfmGirFile     *file)
+{
+  guint i;
+
+  for (i = 0; i < self->files->len; i++)
+    {
+      if (g_ptr_array_index (self->files, i) == (gpointer)file)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+rtfm_gir_provider_warmup_cb (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  FuzzyIndex *index = (FuzzyIndex *)object;
+  g_autoptr(GError) error = NULL;
+  gsize resident = 0;
+  gsize mapped = 0;
+
+  g_assert (FUZZY_IS_INDEX (index));
+  g_assert (G_IS_ASYNC_RESULT (result));
+
+  if (!fuzzy_index_warmup_finish (index, result, &error))
+    {
+      g_debug ("Failed to warm up index: %s", error->message);
+      return;
+    }
+
+  fuzzy_index_get_residency (index, &resident, &mapped);
+
+  g_debug ("Warmed up %s index, %"G_GSIZE_FORMAT" of %"G_GSIZE_FORMAT" bytes resident",
+           fuzzy_index_get_metadata_string (index, "namespace"),
+           resident, mapped);
+}
+
+static void
+rtfm_gir_provider_load_index_cb (GObject      *object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+  RtfmGirFile *file = (RtfmGirFile *)object;
+  g_autoptr(FuzzyIndex) index = NULL;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GError) error = NULL;
+  RtfmGirProvider *self;
+  LoadIndexState *state;
+
+  g_assert (RTFM_GIR_IS_FILE (file));
+  g_assert (G_IS_TASK (task));
+  g_assert (G_IS_ASYNC_RESULT (result));
+
+  self = g_task_get_source_object (task);
+  state = g_task_get_task_data (task);
+
+  index = rtfm_gir_file_load_index_finish (file, result, &error);
+
+  /* The file may have been replaced or removed while it was loading */
+  if (index == NULL)
+    g_warning ("%s", error->message);
+  else if (!g_hash_table_contains (self->loaded, file) &&
+           rtfm_gir_provider_has_file (self, file))
+    {
+      RtfmGirDocIndex *doc_index;
+
+      g_hash_table_insert (self->loaded, g_object_ref (file), index);
+
+      /*
+       * Fault the index in from a worker right away, rather than once
+       * every index has been loaded, so that the namespaces prewarm loads
+       * first (the recent ones) are also the first to be resident.
+       */
+      fuzzy_index_warmup_async (index, NULL, rtfm_gir_provider_warmup_cb, NULL);
+
+      g_ptr_array_add (self->search_indexes, g_steal_pointer (&index));
+
+      if (NULL != (doc_index = rtfm_gir_file_get_doc_index (file)))
+        g_ptr_array_add (self->doc_indexes, doc_index);
+    }
+
+  state->active--;
+
+  if (state->active == 0)
+    g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * Loads the indexes of @files so that they are searched from now on.
+ * Files which are already loaded complete right away, and loads of the
+ * same file are shared by RtfmGirFile.
+ */
+static void
+rtfm_gir_provider_load_indexes_async (RtfmGirProvider     *self,
+                                      GPtrArray           *files,
+                                      gint                 io_priority,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  LoadIndexState *state;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (files != NULL);
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, rtfm_gir_provider_load_indexes_async);
+  g_task_set_check_cancellable (task, FALSE);
+
+  if (files->len == 0)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  state = g_new (LoadIndexState, 1);
+  state->active = files->len;
+  g_task_set_task_data (task, state, g_free);
+
+  for (i = 0; i < files->len; i++)
+    {
+      RtfmGirFile *file = g_ptr_array_index (files, i);
+
+      rtfm_gir_file_load_index_async (file,
+                                      io_priority,
+                                      cancellable,
+                                      rtfm_gir_provider_load_index_cb,
+                                      g_object_ref (task));
+    }
+}
+
+static gboolean
+rtfm_gir_provider_load_indexes_finish (RtfmGirProvider  *self,
+                                       GAsyncResult     *result,
+                                       GError          **error)
+{
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static gchar *
+get_file_basename (RtfmGirFile *file)
+{
+  return g_file_get_basename (rtfm_gir_file_get_file (file));
+}
+
+static gboolean
+rtfm_gir_provider_is_recent (RtfmGirProvider *self,
+                             RtfmGirFile     *file)
+{
+  g_autofree gchar *name = get_file_basename (file);
+
+  return g_queue_find_custom (&self->recent, name, (GCompareFunc)g_strcmp0) != NULL;
+}
+
+static gchar *
+get_recent_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "rtfm",
+                           "gobject-introspection",
+                           "recent",
+                           NULL);
+}
+
+static void
+rtfm_gir_provider_set_recent (RtfmGirProvider *self,
+                              const gchar     *contents)
+{
+  g_auto(GStrv) lines = NULL;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (contents != NULL);
+
+  /* Rediscovery reloads the file, which replaces what we knew */
+  g_queue_foreach (&self->recent, (GFunc)g_free, NULL);
+  g_queue_clear (&self->recent);
+
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (i = 0; lines [i] != NULL && self->recent.length < RTFM_GIR_PROVIDER_RECENT_MAX; i++)
+    {
+      if (*lines [i] != '\0')
+        g_queue_push_tail (&self->recent, g_strdup (lines [i]));
+    }
+}
+
+/*
+ * Remembers that the user opened @file, so that its index is loaded
+ * ahead of the others and searches do not wait on the rest.
+ */
+static void
+rtfm_gir_provider_visit (RtfmGirProvider *self,
+                         RtfmGirFile     *file)
+{
+  g_autofree gchar *name = get_file_basename (file);
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *dir = NULL;
+  g_autoptr(GString) str = NULL;
+  g_autoptr(GError) error = NULL;
+  GList *link;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (RTFM_GIR_IS_FILE (file));
+
+  if (NULL != (link = g_queue_find_custom (&self->recent, name, (GCompareFunc)g_strcmp0)))
+    {
+      if (link == self->recent.head)
+        return;
+
+      g_free (link->data);
+      g_queue_delete_link (&self->recent, link);
+    }
+
+  g_queue_push_head (&self->recent, g_steal_pointer (&name));
+
+  while (self->recent.length > RTFM_GIR_PROVIDER_RECENT_MAX)
+    g_free (g_queue_pop_tail (&self->recent));
+
+  str = g_string_new (NULL);
+  for (link = self->recent.head; link != NULL; link = link->next)
+    g_string_append_printf (str, "%s\n", (const gchar *)link->data);
+
+  path = get_recent_filename ();
+  dir = g_path_get_dirname (path);
+
+  g_mkdir_with_parents (dir, 0750);
+
+  if (!g_file_set_contents (path, str->str, str->len, &error))
+    g_debug ("Failed to save recent namespaces: %s", error->message);
+}
+
+/*
+ * Folds an identifier so that "gtk_widget", "GtkWidget" and "gtkwidget"
+ * can be compared to the namespace "Gtk".
+ */
+static gchar *
+fold_identifier (const gchar *str)
+{
+  GString *folded = g_string_new (NULL);
+
+  for (; *str; str = g_utf8_next_char (str))
+    {
+      gunichar ch = g_utf8_get_char (str);
+
+      if (ch != '_')
+        g_string_append_unichar (folded, g_unichar_tolower (ch));
+    }
+
+  return g_string_free (folded, FALSE);
+}
+
+static gboolean
+file_matches_query (RtfmGirFile *file,
+                    const gchar *folded)
+{
+  g_autofree gchar *name = get_file_basename (file);
+  g_autofree gchar *nsname = NULL;
+  gchar *tmp;
+
+  /* "GtkSource-3.0.gir" is the namespace "GtkSource" */
+  if (NULL != (tmp = strchr (name, '-')))
+    *tmp = '\0';
+  nsname = fold_identifier (name);
+
+  if (*nsname == '\0' || *folded == '\0')
+    return FALSE;
+
+  /* Either "gtk_widget_show" within Gtk, or "gt" while typing "gtk" */
+  return g_str_has_prefix (folded, nsname) || g_str_has_prefix (nsname, folded);
+}
+
+/*
+ * Plans which indexes @query has to wait for. Queries usually start
+ * with a namespace, such as "gtk_widget_show" or "GtkWidget", or are
+ * still typing one, so only the matching namespaces and the recently
+ * visited ones are needed. Anything else could match in any namespace,
+ * but loading every index would stall the search, so it only searches
+ * the indexes which are already loaded and leaves the rest to prewarm.
+ * Indexes which are already loaded are always searched and are not part
+ * of the plan.
+ */
+static GPtrArray *
+rtfm_gir_provider_plan (RtfmGirProvider *self,
+                        const gchar     *query)
+{
+  g_autofree gchar *folded = NULL;
+  GPtrArray *plan;
+  gboolean hinted = FALSE;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (query != NULL);
+
+  plan = g_ptr_array_new_with_free_func (g_object_unref);
+  folded = fold_identifier (query);
+
+  for (i = 0; !hinted && i < self->files->len; i++)
+    hinted = file_matches_query (g_ptr_array_index (self->files, i), folded);
+
+  if (!hinted)
+    return plan;
+
+  for (i = 0; i < self->files->len; i++)
+    {
+      RtfmGirFile *file = g_ptr_array_index (self->files, i);
+
+      if (g_hash_table_contains (self->loaded, file))
+        continue;
+
+      if (file_matches_query (file, folded) ||
+          rtfm_gir_provider_is_recent (self, file))
+        g_ptr_array_add (plan, g_object_ref (file));
+    }
+
+  return plan;
+}
+
+static gboolean rtfm_gir_provider_prewarm (gpointer user_data);
+
+static void
+rtfm_gir_provider_prewarm_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  RtfmGirProvider *self = (RtfmGirProvider *)object;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_ASYNC_RESULT (result));
+
+  rtfm_gir_provider_load_indexes_finish (self, result, NULL);
+
+  if (self->prewarm_queue != NULL && self->prewarm_source == 0)
+    self->prewarm_source = g_idle_add_full (G_PRIORITY_LOW,
+                                            rtfm_gir_provider_prewarm,
+                                            g_object_ref (self),
+                                            g_object_unref);
+}
+
+/*
+ * Loads one more index each time the main loop is idle, so that searches
+ * rarely have to wait on an index but startup does not either.
+ */
+static gboolean
+rtfm_gir_provider_prewarm (gpointer user_data)
+{
+  RtfmGirProvider *self = user_data;
+  g_autoptr(GPtrArray) files = NULL;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+
+  self->prewarm_source = 0;
+
+  if (self->prewarm_queue == NULL)
+    {
+      guint i;
+
+      self->prewarm_queue = g_ptr_array_new_with_free_func (g_object_unref);
+
+      for (i = 0; i < self->files->len; i++)
+        {
+          RtfmGirFile *file = g_ptr_array_index (self->files, i);
+
+          if (rtfm_gir_provider_is_recent (self, file))
+            g_ptr_array_add (self->prewarm_queue, g_object_ref (file));
+        }
+
+      for (i = 0; i < self->files->len; i++)
+        {
+          RtfmGirFile *file = g_ptr_array_index (self->files, i);
+
+          if (!rtfm_gir_provider_is_recent (self, file))
+            g_ptr_array_add (self->prewarm_queue, g_object_ref (file));
+        }
+    }
+
+  while (self->prewarm_queue->len > 0)
+    {
+      g_autoptr(RtfmGirFile) file = g_object_ref (g_ptr_array_index (self->prewarm_queue, 0));
+
+      g_ptr_array_remove_index (self->prewarm_queue, 0);
+
+      if (!g_hash_table_contains (self->loaded, file))
+        {
+          files = g_ptr_array_new_with_free_func (g_object_unref);
+          g_ptr_array_add (files, g_steal_pointer (&file));
+          break;
+        }
+    }
+
+  if (files == NULL)
+    {
+      g_clear_pointer (&self->prewarm_queue, g_ptr_array_unref);
+      return G_SOURCE_REMOVE;
+    }
+
+  rtfm_gir_provider_load_indexes_async (self,
+                                        files,
+                                        G_PRIORITY_LOW,
+                                        NULL,
+                                        rtfm_gir_provider_prewarm_cb,
+                                        NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void rtfm_gir_provider_discover_next_root (DiscoverState *state);
+static void rtfm_gir_provider_watch              (RtfmGirProvider *self,
+                                                  GPtrArray       *roots);
+
+static gint
+compare_file_basename (gconstpointer a,
+                       gconstpointer b)
+{
+  RtfmGirFile *file_a = *(RtfmGirFile * const *)a;
+  RtfmGirFile *file_b = *(RtfmGirFile * const *)b;
+  g_autofree gchar *name_a = get_file_basename (file_a);
+  g_autofree gchar *name_b = get_file_basename (file_b);
+
+  return g_strcmp0 (name_a, name_b);
+}
+
+static RtfmGirFile *
+rtfm_gir_provider_new_file (RtfmGirProvider *self,
+                            GFile           *file)
+{
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_FILE (file));
+
+  return rtfm_gir_file_new_for_scheduler (file,
+                                          self->library != NULL
+                                            ? rtfm_library_get_scheduler (self->library)
+                                            : NULL);
+}
+
+static void
+rtfm_gir_provider_discover_complete (DiscoverState *state)
+{
+  RtfmGirProvider *self = state->self;
+  GHashTableIter iter;
+  Candidate *candidate;
+  GSList *tasks;
+  GSList *list;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+
+  g_hash_table_iter_init (&iter, state->found);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&candidate))
+    g_ptr_array_add (self->files, rtfm_gir_provider_new_file (self, candidate->file));
+
+  g_ptr_array_sort (self->files, compare_file_basename);
+
+  g_debug ("Discovered %u .gir files in %u directories",
+           self->files->len, state->roots->len);
+
+  self->discovered = TRUE;
+
+  if (self->library != NULL)
+    rtfm_gir_provider_watch (self, state->roots);
+
+  tasks = self->discover_tasks;
+  self->discover_tasks = NULL;
+
+  for (list = tasks; list != NULL; list = list->next)
+    {
+      g_autoptr(GTask) task = list->data;
+
+      g_task_return_boolean (task, TRUE);
+    }
+
+  g_slist_free (tasks);
+
+  /* Indexes are loaded when a search needs them, or once we are idle */
+  if (self->prewarm_source == 0)
+    self->prewarm_source = g_idle_add_full (G_PRIORITY_LOW,
+                                            rtfm_gir_provider_prewarm,
+                                            g_object_ref (self),
+                                            g_object_unref);
+
+  discover_state_free (state);
+}
+
+static void
+rtfm_gir_provider_discover_add (DiscoverState *state,
+                                GFile         *parent,
+                                GFileInfo     *file_info)
+{
+  const gchar *name = g_file_info_get_name (file_info);
+  Candidate *candidate;
+  guint64 mtime;
+
+  g_assert (state != NULL);
+  g_assert (G_IS_FILE (parent));
+  g_assert (G_IS_FILE_INFO (file_info));
+
+  if (!g_str_has_suffix (name, ".gir") ||
+      g_file_info_get_file_type (file_info) != G_FILE_TYPE_REGULAR)
+    return;
+
+  mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  /*
+   * The same namespace-version may be installed in more than one root,
+   * such as a development copy in the home directory. Prefer the newest
+   * of them, or the first root on ties.
+   */
+  if (NULL != (candidate = g_hash_table_lookup (state->found, name)))
+    {
+      if (mtime <= candidate->mtime)
+        return;
+
+      g_clear_object (&candidate->file);
+    }
+  else
+    {
+      candidate = g_slice_new0 (Candidate);
+      g_hash_table_insert (state->found, g_strdup (name), candidate);
+    }
+
+  candidate->file = g_file_get_child (parent, name);
+  candidate->mtime = mtime;
+}
+
+static void
+rtfm_gir_provider_discover_next_files_cb (GObject      *object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  GFileEnumerator *enumerator = (GFileEnumerator *)object;
+  DiscoverState *state = user_data;
+  g_autoptr(GError) error = NULL;
+  GList *infos;
+  GList *iter;
+
+  g_assert (G_IS_FILE_ENUMERATOR (enumerator));
+  g_assert (state != NULL);
+
+  infos = g_file_enumerator_next_files_finish (enumerator, result, &error);
+
+  if (infos == NULL)
+    {
+      if (error != NULL)
+        g_warning ("%s", error->message);
+
+      g_object_unref (enumerator);
+      state->root++;
+      rtfm_gir_provider_discover_next_root (state);
+      return;
+    }
+
+  for (iter = infos; iter != NULL; iter = iter->next)
+    rtfm_gir_provider_discover_add (state,
+                                    g_file_enumerator_get_container (enumerator),
+                                    iter->data);
+
+  g_list_free_full (infos, g_object_unref);
+
+  g_file_enumerator_next_files_async (enumerator,
+                                      RTFM_GIR_PROVIDER_DISCOVER_BATCH,
+                                      G_PRIORITY_LOW,
+                                      NULL,
+                                      rtfm_gir_provider_discover_next_files_cb,
+                                      state);
+}
+
+static void
+rtfm_gir_provider_discover_enumerate_cb (GObject      *object,
+                                         GAsyncResult *result,
+                                         gpointer      user_data)
+{
+  GFile *root = (GFile *)object;
+  DiscoverState *state = user_data;
+  g_autoptr(GError) error = NULL;
+  GFileEnumerator *enumerator;
+
+  g_assert (G_IS_FILE (root));
+  g_assert (state != NULL);
+
+  enumerator = g_file_enumerate_children_finish (root, result, &error);
+
+  if (enumerator == NULL)
+    {
+      /* Most of the data directories have no .gir files at all */
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        g_warning ("%s", error->message);
+
+      state->root++;
+      rtfm_gir_provider_discover_next_root (state);
+      return;
+    }
+
+  g_file_enumerator_next_files_async (enumerator,
+                                      RTFM_GIR_PROVIDER_DISCOVER_BATCH,
+                                      G_PRIORITY_LOW,
+                                      NULL,
+                                      rtfm_gir_provider_discover_next_files_cb,
+                                      state);
+}
+
+static void
+rtfm_gir_provider_discover_next_root (DiscoverState *state)
+{
+  GFile *root;
+
+  g_assert (state != NULL);
+
+  if (state->root >= state->roots->len)
+    {
+      rtfm_gir_provider_discover_complete (state);
+      return;
+    }
+
+  root = g_ptr_array_index (state->roots, state->root);
+
+  g_file_enumerate_children_async (root,
+                                   G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                   G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                   G_FILE_QUERY_INFO_NONE,
+                                   G_PRIORITY_LOW,
+                                   NULL,
+                                   rtfm_gir_provider_discover_enumerate_cb,
+                                   state);
+}
+
+static void
+rtfm_gir_provider_load_recent_cb (GObject      *object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  GFile *file = (GFile *)object;
+  DiscoverState *state = user_data;
+  g_autofree gchar *contents = NULL;
+  gsize len = 0;
+
+  g_assert (G_IS_FILE (file));
+  g_assert (state != NULL);
+
+  /* The file does not exist until something has been visited */
+  if (g_file_load_contents_finish (file, result, &contents, &len, NULL, NULL))
+    rtfm_gir_provider_set_recent (state->self, contents);
+
+  rtfm_gir_provider_discover_next_root (state);
+}
+
+static void
+add_root (GPtrArray   *roots,
+          const gchar *path)
+{
+  g_autoptr(GFile) file = NULL;
+  guint i;
+
+  if (path == NULL || *path == '\0')
+    return;
+
+  file = g_file_new_for_path (path);
+
+  for (i = 0; i < roots->len; i++)
+    {
+      if (g_file_equal (file, g_ptr_array_index (roots, i)))
+        return;
+    }
+
+  g_ptr_array_add (roots, g_steal_pointer (&file));
+}
+
+/*
+ * Finds the .gir files in GI_GIR_PATH and the gir-1.0 directory of each
+ * XDG data directory, a batch at a time so that the main loop is never
+ * blocked on a slow directory.
+ */
+static void
+rtfm_gir_provider_discover (RtfmGirProvider *self)
+{
+  const gchar * const *data_dirs;
+  const gchar *gir_path;
+  g_autoptr(GFile) recent_file = NULL;
+  g_autofree gchar *recent_path = NULL;
+  g_autofree gchar *user_dir = NULL;
+  DiscoverState *state;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+
+  state = g_slice_new0 (DiscoverState);
+  state->self = g_object_ref (self);
+  state->roots = g_ptr_array_new_with_free_func (g_object_unref);
+  state->found = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, candidate_free);
+
+  if (NULL != (gir_path = g_getenv ("GI_GIR_PATH")))
+    {
+      g_auto(GStrv) paths = g_strsplit (gir_path, G_SEARCHPATH_SEPARATOR_S, 0);
+
+      for (i = 0; paths [i] != NULL; i++)
+        add_root (state->roots, paths [i]);
+    }
+
+  user_dir = g_build_filename (g_get_user_data_dir (), "gir-1.0", NULL);
+  add_root (state->roots, user_dir);
+
+  data_dirs = g_get_system_data_dirs ();
+
+  for (i = 0; data_dirs [i] != NULL; i++)
+    {
+      g_autofree gchar *path = g_build_filename (data_dirs [i], "gir-1.0", NULL);
+
+      add_root (state->roots, path);
+    }
+
+  recent_path = get_recent_filename ();
+  recent_file = g_file_new_for_path (recent_path);
+
+  g_file_load_contents_async (recent_file,
+                              NULL,
+                              rtfm_gir_provider_load_recent_cb,
+                              state);
+}
+
+static void
+rtfm_gir_provider_discover_async (RtfmGirProvider     *self,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  g_autoptr(GTask) task = NULL;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, rtfm_gir_provider_discover_async);
+
+  if (self->discovered)
+    {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+
+  self->discover_tasks = g_slist_prepend (self->discover_tasks, g_object_ref (task));
+
+  if (self->discover_tasks->next == NULL)
+    rtfm_gir_provider_discover (self);
+}
+
+static gboolean
+rtfm_gir_provider_discover_finish (RtfmGirProvider  *self,
+                                   GAsyncResult     *result,
+                                   GError          **error)
+{
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_TASK (result));
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/*
+ * Forgets the indexes of @file, which is being replaced or removed.
+ */
+static void
+rtfm_gir_provider_unload (RtfmGirProvider *self,
+                          RtfmGirFile     *file)
+{
+  g_autoptr(RtfmGirDocIndex) doc_index = NULL;
+  FuzzyIndex *index;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (RTFM_GIR_IS_FILE (file));
+
+  if (self->prewarm_queue != NULL)
+    g_ptr_array_remove (self->prewarm_queue, file);
+
+  if (NULL == (index = g_hash_table_lookup (self->loaded, file)))
+    return;
+
+  /* Searches in flight hold their own references to the indexes */
+  g_ptr_array_remove (self->search_indexes, index);
+
+  if (NULL != (doc_index = rtfm_gir_file_get_doc_index (file)))
+    g_ptr_array_remove (self->doc_indexes, doc_index);
+
+  g_hash_table_remove (self->loaded, file);
+}
+
+/*
+ * Finds the item for @file among the top-level items of the library.
+ * There is none until the root has been populated.
+ */
+static RtfmItem *
+rtfm_gir_provider_find_item (RtfmGirProvider *self,
+                             RtfmGirFile     *file)
+{
+  RtfmItem *root;
+  guint n_items;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (RTFM_GIR_IS_FILE (file));
+
+  if (self->library == NULL)
+    return NULL;
+
+  root = rtfm_library_get_root (self->library);
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (root));
+
+  for (i = 0; i < n_items; i++)
+    {
+      g_autoptr(RtfmItem) item = g_list_model_get_item (G_LIST_MODEL (root), i);
+
+      if (RTFM_GIR_IS_ITEM (item) &&
+          rtfm_gir_item_get_object (RTFM_GIR_ITEM (item)) == (GObject *)file)
+        return g_steal_pointer (&item);
+    }
+
+  return NULL;
+}
+
+/*
+ * Updates the tree for the file at @position in self->files. @old_file
+ * is the file it replaces, if any. The new item takes the place of the
+ * old one in a single pass of the main loop, so the tree is never seen
+ * without the namespace.
+ */
+static void
+rtfm_gir_provider_update_item (RtfmGirProvider *self,
+                               guint            position,
+                               RtfmGirFile     *old_file)
+{
+  g_autoptr(RtfmGirItem) gir_item = NULL;
+  g_autoptr(RtfmItem) sibling = NULL;
+  RtfmGirFile *file;
+  RtfmItem *root;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (position < self->files->len);
+
+  if (self->library == NULL)
+    return;
+
+  root = rtfm_library_get_root (self->library);
+  file = g_ptr_array_index (self->files, position);
+  gir_item = rtfm_gir_item_new (G_OBJECT (file));
+
+  if (old_file != NULL &&
+      NULL != (sibling = rtfm_gir_provider_find_item (self, old_file)))
+    {
+      rtfm_item_insert_before (root, sibling, RTFM_ITEM (gir_item));
+      rtfm_item_remove (root, sibling);
+      return;
+    }
+
+  /* Keep the namespaces sorted by inserting next to a neighbour */
+  if (position > 0 &&
+      NULL != (sibling = rtfm_gir_provider_find_item (self, g_ptr_array_index (self->files, position - 1))))
+    rtfm_item_insert_after (root, sibling, RTFM_ITEM (gir_item));
+  else if (position + 1 < self->files->len &&
+           NULL != (sibling = rtfm_gir_provider_find_item (self, g_ptr_array_index (self->files, position + 1))))
+    rtfm_item_insert_before (root, sibling, RTFM_ITEM (gir_item));
+}
+
+static void
+rtfm_gir_provider_refresh_cb (GObject      *object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  RtfmGirProvider *self = (RtfmGirProvider *)object;
+  g_autoptr(GHashTable) resolved = NULL;
+  g_autoptr(GPtrArray) reload = NULL;
+  g_autoptr(GError) error = NULL;
+  GHashTableIter iter;
+  const gchar *name;
+  Candidate *candidate;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_TASK (result));
+
+  if (NULL == (resolved = g_task_propagate_pointer (G_TASK (result), &error)))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_warning ("%s", error->message);
+      return;
+    }
+
+  reload = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_hash_table_iter_init (&iter, resolved);
+
+  while (g_hash_table_iter_next (&iter, (gpointer *)&name, (gpointer *)&candidate))
+    {
+      g_autoptr(RtfmGirFile) old_file = NULL;
+      guint position;
+
+      /* Find the file, or where it belongs, as self->files is sorted */
+      for (position = 0; position < self->files->len; position++)
+        {
+          RtfmGirFile *file = g_ptr_array_index (self->files, position);
+          g_autofree gchar *file_name = get_file_basename (file);
+          gint cmp = g_strcmp0 (file_name, name);
+
+          if (cmp == 0)
+            old_file = g_object_ref (file);
+
+          if (cmp >= 0)
+            break;
+        }
+
+      if (old_file != NULL)
+        {
+          g_autoptr(RtfmItem) item = NULL;
+
+          rtfm_gir_provider_unload (self, old_file);
 
-G_DEFINE_TYPE_EXTENDED (RtfmGirProvider, rtfm_gir_provider, G_TYPE_OBJECT, 0,
-                        G_IMPLEMENT_INTERFACE (RTFM_TYPE_PROVIDER, provider_iface_init))
+          if (candidate == NULL)
+            {
+              g_debug ("Removing %s", name);
 
-static void
-search_state_free (gpointer data)
-{
-  SearchState *state = data;
+              if (NULL != (item = rtfm_gir_provider_find_item (self, old_file)))
+                rtfm_item_remove (rtfm_library_get_root (self->library), item);
 
-  g_clear_pointer (&state->query, g_free);
-  g_clear_object (&state->results);
-  g_slice_free (SearchState, state);
-}
+              g_ptr_array_remove_index (self->files, position);
 
-static void
-rtfm_gir_provider_finalize (GObject *object)
-{
-  RtfmGirProvider *self = (RtfmGirProvider *)object;
+              continue;
+            }
 
-  g_clear_pointer (&self->files, g_ptr_array_unref);
-  g_clear_pointer (&self->search_indexes, g_ptr_array_unref);
+          g_ptr_array_remove_index (self->files, position);
+        }
+      else if (candidate == NULL)
+        continue;
 
-  g_slist_free_full (self->search_index_tasks, g_object_unref);
-  self->search_index_tasks = NULL;
+      g_debug ("Reindexing %s", name);
 
-  G_OBJECT_CLASS (rtfm_gir_provider_parent_class)->finalize (object);
-}
+      g_ptr_array_insert (self->files, position, rtfm_gir_provider_new_file (self, candidate->file));
+      g_ptr_array_add (reload, g_object_ref (g_ptr_array_index (self->files, position)));
 
-static void
-rtfm_gir_provider_class_init (RtfmGirProviderClass *klass)
-{
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+      if (self->prewarm_queue != NULL)
+        g_ptr_array_add (self->prewarm_queue, g_object_ref (g_ptr_array_index (self->files, position)));
 
-  object_class->finalize = rtfm_gir_provider_finalize;
-}
+      rtfm_gir_provider_update_item (self, position, old_file);
+    }
 
-static void
-rtfm_gir_provider_init (RtfmGirProvider *self)
-{
-  self->files = g_ptr_array_new_with_free_func (g_object_unref);
-  self->search_indexes = g_ptr_array_new_with_free_func (g_object_unref);
+  /*
+   * Only the files that changed are parsed again. The others keep their
+   * indexes, and a file whose index is still current just loads it.
+   */
+  rtfm_gir_provider_load_indexes_async (self,
+                                        reload,
+                                        G_PRIORITY_LOW,
+                                        NULL,
+                                        NULL,
+                                        NULL);
 }
 
+/*
+ * Finds the newest copy of each changed .gir file across the roots, in
+ * the same way as discovery does. Files which are gone from every root
+ * map to %NULL.
+ */
 static void
-rtfm_gir_provider_load_index_cb (GObject      *object,
-                                 GAsyncResult *result,
-                                 gpointer      user_data)
+rtfm_gir_provider_refresh_worker (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
 {
-  RtfmGirFile *file = (RtfmGirFile *)object;
-  g_autoptr(FuzzyIndex) index = NULL;
-  g_autoptr(GTask) task = user_data;
-  RtfmGirProvider *self;
-  LoadIndexState *state;
-  GError *error = NULL;
+  RefreshState *state = task_data;
+  g_autoptr(GHashTable) resolved = NULL;
+  guint i;
+  guint j;
 
-  g_assert (RTFM_GIR_IS_FILE (file));
   g_assert (G_IS_TASK (task));
-  g_assert (G_IS_ASYNC_RESULT (result));
-
-  self = g_task_get_source_object (task);
-  state = g_task_get_task_data (task);
-
-  index = rtfm_gir_file_load_index_finish (file, result, &error);
-
-  if (index == NULL)
-    g_warning ("%s", error->message);
-  else
-    g_ptr_array_add (self->search_indexes, g_steal_pointer (&index));
+  g_assert (state != NULL);
 
-  state->active--;
+  resolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, candidate_free);
 
-  if (state->active == 0)
+  for (i = 0; i < state->names->len; i++)
     {
-      GSList *tasks;
-      GSList *iter;
-
-      self->search_indexes_loaded = TRUE;
-
-      tasks = self->search_index_tasks;
-      self->search_index_tasks = NULL;
+      const gchar *name = g_ptr_array_index (state->names, i);
+      Candidate *candidate = NULL;
 
-      for (iter = tasks; iter != NULL; iter = iter->next)
+      for (j = 0; j < state->roots->len; j++)
         {
-          g_autoptr(GTask) iter_task = iter->data;
-
-          g_task_return_boolean (iter_task, TRUE);
+          g_autoptr(GFile) file = g_file_get_child (g_ptr_array_index (state->roots, j), name);
+          g_autoptr(GFileInfo) file_info = NULL;
+          guint64 mtime;
+
+          file_info = g_file_query_info (file,
+                                         G_FILE_ATTRIBUTE_STANDARD_TYPE","
+                                         G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                         G_FILE_QUERY_INFO_NONE,
+                                         cancellable,
+                                         NULL);
+
+          if (file_info == NULL ||
+              g_file_info_get_file_type (file_info) != G_FILE_TYPE_REGULAR)
+            continue;
+
+          mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+          if (candidate == NULL)
+            candidate = g_slice_new0 (Candidate);
+          else if (mtime <= candidate->mtime)
+            continue;
+
+          g_clear_object (&candidate->file);
+          candidate->file = g_steal_pointer (&file);
+          candidate->mtime = mtime;
         }
 
-      g_slist_free (tasks);
+      g_hash_table_insert (resolved, g_strdup (name), candidate);
     }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  g_task_return_pointer (task, g_steal_pointer (&resolved), (GDestroyNotify)g_hash_table_unref);
 }
 
-static void
-rtfm_gir_provider_load_indexes_async (RtfmGirProvider     *self,
-                                      GCancellable        *cancellable,
-                                      GAsyncReadyCallback  callback,
-                                      gpointer             user_data)
+static gboolean
+rtfm_gir_provider_refresh (gpointer user_data)
 {
+  RtfmGirProvider *self = user_data;
   g_autoptr(GTask) task = NULL;
-  LoadIndexState *state;
-  guint i;
+  RefreshState *state;
+  GHashTableIter iter;
+  gchar *name;
 
   g_assert (RTFM_IS_GIR_PROVIDER (self));
-  g_assert (!cancellable || G_IS_CANCELLABLE (cancellable));
+  g_assert (RTFM_IS_LIBRARY (self->library));
 
-  task = g_task_new (self, cancellable, callback, user_data);
-  g_task_set_source_tag (task, rtfm_gir_provider_load_indexes_async);
-  g_task_set_check_cancellable (task, FALSE);
+  self->changed_source = 0;
 
-  if (self->search_indexes_loaded || self->files->len == 0)
+  state = g_slice_new0 (RefreshState);
+  state->roots = g_ptr_array_ref (self->roots);
+  state->names = g_ptr_array_new_with_free_func (g_free);
+
+  g_hash_table_iter_init (&iter, self->changed);
+
+  while (g_hash_table_iter_next (&iter, (gpointer *)&name, NULL))
     {
-      g_task_return_boolean (task, TRUE);
-      return;
+      g_ptr_array_add (state->names, name);
+      g_hash_table_iter_steal (&iter);
     }
 
-  state = g_new (LoadIndexState, 1);
-  state->active = self->files->len;
-  g_task_set_task_data (task, state, g_free);
+  task = g_task_new (self, self->refresh_cancellable, rtfm_gir_provider_refresh_cb, NULL);
+  g_task_set_source_tag (task, rtfm_gir_provider_refresh);
+  g_task_set_task_data (task, state, refresh_state_free);
 
-  self->search_index_tasks = g_slist_prepend (self->search_index_tasks, g_object_ref (task));
-
-  for (i = 0; i < self->files->len; i++)
-    {
-      RtfmGirFile *file = g_ptr_array_index (self->files, i);
+  rtfm_scheduler_run_in_thread (rtfm_library_get_scheduler (self->library),
+                                task,
+                                RTFM_SCHEDULER_PRIORITY_BACKGROUND,
+                                0,
+                                rtfm_gir_provider_refresh_worker);
 
-      rtfm_gir_file_load_index_async (file,
-                                      cancellable,
-                                      rtfm_gir_provider_load_index_cb,
-                                      g_object_ref (task));
-    }
+  return G_SOURCE_REMOVE;
 }
 
-static gboolean
-rtfm_gir_provider_load_indexes_finish (RtfmGirProvider  *self,
-                                       GAsyncResult     *result,
-                                       GError          **error)
+static void
+rtfm_gir_provider_monitor_changed (RtfmGirProvider   *self,
+                                   GFile             *file,
+                                   GFile             *other_file,
+                                   GFileMonitorEvent  event,
+                                   GFileMonitor      *monitor)
 {
+  g_autofree gchar *name = NULL;
+
   g_assert (RTFM_IS_GIR_PROVIDER (self));
-  g_assert (G_IS_TASK (result));
+  g_assert (G_IS_FILE (file));
+  g_assert (G_IS_FILE_MONITOR (monitor));
 
-  return g_task_propagate_boolean (G_TASK (result), error);
+  if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+      event != G_FILE_MONITOR_EVENT_CREATED &&
+      event != G_FILE_MONITOR_EVENT_DELETED)
+    return;
+
+  name = g_file_get_basename (file);
+
+  if (!g_str_has_suffix (name, ".gir"))
+    return;
+
+  g_hash_table_add (self->changed, g_steal_pointer (&name));
+
+  /*
+   * Installing a package touches many files, possibly more than once,
+   * so wait for things to settle before looking at any of them.
+   */
+  if (self->changed_source != 0)
+    g_source_remove (self->changed_source);
+
+  self->changed_source = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                                     RTFM_GIR_PROVIDER_REFRESH_DELAY,
+                                                     rtfm_gir_provider_refresh,
+                                                     g_object_ref (self),
+                                                     g_object_unref);
 }
 
 static void
-rtfm_gir_provider_load_directory (RtfmGirProvider *self,
-                                  const gchar     *path,
-                                  GCancellable    *cancellable)
+rtfm_gir_provider_watch (RtfmGirProvider *self,
+                         GPtrArray       *roots)
 {
-  g_autoptr(GFile) parent = NULL;
-  g_autoptr(GFileEnumerator) enumerator = NULL;
-  g_autoptr(GError) error = NULL;
-  g_autofree gchar *index_dir = NULL;
-  gpointer ptr;
+  guint i;
 
   g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (roots != NULL);
+  g_assert (self->monitors == NULL);
 
-  if (!g_file_test (path, G_FILE_TEST_IS_DIR))
-    return;
+  g_clear_pointer (&self->roots, g_ptr_array_unref);
+  self->roots = g_ptr_array_ref (roots);
+  self->monitors = g_ptr_array_new_with_free_func (g_object_unref);
 
-  parent = g_file_new_for_path (path);
-  enumerator = g_file_enumerate_children (parent,
-                                          G_FILE_ATTRIBUTE_STANDARD_NAME,
-                                          G_FILE_QUERY_INFO_NONE,
-                                          NULL,
-                                          &error);
+  /* The previous one was cancelled when we last stopped watching */
+  g_clear_object (&self->refresh_cancellable);
+  self->refresh_cancellable = g_cancellable_new ();
 
-  if (enumerator == NULL)
+  /* Roots that do not exist yet are watched too, in case they appear */
+  for (i = 0; i < roots->len; i++)
     {
-      g_warning ("%s", error->message);
-      return;
-    }
+      GFile *root = g_ptr_array_index (roots, i);
+      g_autoptr(GFileMonitor) monitor = NULL;
+      g_autoptr(GError) error = NULL;
 
-  while (NULL != (ptr = g_file_enumerator_next_file (enumerator, cancellable, &error)))
-    {
-      g_autoptr(GFileInfo) file_info = ptr;
-      g_autoptr(GFile) file = NULL;
-      const gchar *name;
+      if (NULL == (monitor = g_file_monitor_directory (root, G_FILE_MONITOR_NONE, NULL, &error)))
+        {
+          g_debug ("Not watching for changes: %s", error->message);
+          continue;
+        }
 
-      name = g_file_info_get_name (file_info);
-      file = g_file_get_child (parent, name);
+      g_signal_connect_object (monitor,
+                               "changed",
+                               G_CALLBACK (rtfm_gir_provider_monitor_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
 
-      g_ptr_array_add (self->files, rtfm_gir_file_new (file));
+      g_ptr_array_add (self->monitors, g_steal_pointer (&monitor));
     }
+}
+
+static void
+rtfm_gir_provider_unwatch (RtfmGirProvider *self)
+{
+  guint i;
 
-  if (error != NULL)
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+
+  if (self->monitors != NULL)
     {
-      g_warning ("%s", error->message);
-      return;
+      for (i = 0; i < self->monitors->len; i++)
+        {
+          GFileMonitor *monitor = g_ptr_array_index (self->monitors, i);
+
+          g_signal_handlers_disconnect_by_data (monitor, self);
+          g_file_monitor_cancel (monitor);
+        }
     }
 
-  index_dir = g_build_filename (g_get_user_cache_dir (),
-                                "rtfm",
-                                "gobject-introspection",
-                                NULL);
+  g_clear_pointer (&self->monitors, g_ptr_array_unref);
 
-  if (!g_file_test (index_dir, G_FILE_TEST_IS_DIR))
-    g_mkdir_with_parents (index_dir, 0750);
+  if (self->changed_source != 0)
+    {
+      g_source_remove (self->changed_source);
+      self->changed_source = 0;
+    }
 
-  rtfm_gir_provider_load_indexes_async (self, NULL, NULL, NULL);
+  g_hash_table_remove_all (self->changed);
+  g_cancellable_cancel (self->refresh_cancellable);
 }
 
+/*
+ * Forgets the discovered files along with their indexes and looks for
+ * them again, so that a provider which was shut down and initialized
+ * again sees the current set of .gir files. The roots are watched again
+ * once discovery completes.
+ */
 static void
 rtfm_gir_provider_reload (RtfmGirProvider *self)
 {
   g_assert (RTFM_IS_GIR_PROVIDER (self));
 
-  rtfm_gir_provider_load_directory (self, "/usr/share/gir-1.0", NULL);
+  /* A discovery in flight will add the files and watch the roots */
+  if (self->discover_tasks == NULL)
+    {
+      rtfm_gir_provider_unwatch (self);
+      g_clear_pointer (&self->roots, g_ptr_array_unref);
+
+      if (self->prewarm_queue != NULL)
+        g_ptr_array_set_size (self->prewarm_queue, 0);
+
+      /* Searches in flight hold their own references to the indexes */
+      g_ptr_array_set_size (self->search_indexes, 0);
+      g_ptr_array_set_size (self->doc_indexes, 0);
+      g_hash_table_remove_all (self->loaded);
+      g_ptr_array_set_size (self->files, 0);
+
+      self->discovered = FALSE;
+    }
+
+  rtfm_gir_provider_discover_async (self, NULL, NULL, NULL);
 }
 
 static void
@@ -274,6 +1434,8 @@ rtfm_gir_provider_initialize (RtfmProvider *provider,
   g_assert (RTFM_IS_GIR_PROVIDER (self));
   g_assert (RTFM_IS_LIBRARY (library));
 
+  self->library = library;
+
   rtfm_gir_provider_reload (self);
 }
 
@@ -286,6 +1448,20 @@ rtfm_gir_provider_shutdown (RtfmProvider *provider,
   g_assert (RTFM_IS_GIR_PROVIDER (self));
   g_assert (RTFM_IS_LIBRARY (library));
 
+  if (self->prewarm_source != 0)
+    {
+      g_source_remove (self->prewarm_source);
+      self->prewarm_source = 0;
+    }
+
+  g_clear_pointer (&self->prewarm_queue, g_ptr_array_unref);
+
+  rtfm_gir_provider_unwatch (self);
+  self->library = NULL;
+
+  /* Nobody is left to show the parsed files to */
+  rtfm_scheduler_cancel_group (rtfm_library_get_scheduler (library),
+                               RTFM_GIR_FILE_PARSE_GROUP);
 }
 
 static void
@@ -307,6 +1483,39 @@ rtfm_gir_provider_populate_cb (GObject      *object,
     g_task_return_boolean (task, TRUE);
 }
 
+static void
+rtfm_gir_provider_populate_root_cb (GObject      *object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  RtfmGirProvider *self = (RtfmGirProvider *)object;
+  g_autoptr(GTask) task = user_data;
+  RtfmCollection *collection;
+  GError *error = NULL;
+  guint i;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_TASK (task));
+
+  if (!rtfm_gir_provider_discover_finish (self, result, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  collection = g_task_get_task_data (task);
+
+  for (i = 0; i < self->files->len; i++)
+    {
+      RtfmGirFile *file = g_ptr_array_index (self->files, i);
+      g_autoptr(RtfmGirItem) gir_item = rtfm_gir_item_new (G_OBJECT (file));
+
+      rtfm_collection_append (collection, RTFM_ITEM (gir_item));
+    }
+
+  g_task_return_boolean (task, TRUE);
+}
+
 static void
 rtfm_gir_provider_populate_async (RtfmProvider        *provider,
                                   RtfmItem            *parent,
@@ -331,22 +1540,19 @@ rtfm_gir_provider_populate_async (RtfmProvider        *provider,
 
   if (rtfm_path_is_empty (path))
     {
-      guint i;
-
-      for (i = 0; i < self->files->len; i++)
-        {
-          RtfmGirFile *file = g_ptr_array_index (self->files, i);
-          g_autoptr(RtfmGirItem) gir_item = rtfm_gir_item_new (G_OBJECT (file));
-
-          rtfm_collection_append (collection, RTFM_ITEM (gir_item));
-        }
-
-      g_task_return_boolean (task, TRUE);
-
+      rtfm_gir_provider_discover_async (self,
+                                        cancellable,
+                                        rtfm_gir_provider_populate_root_cb,
+                                        g_object_ref (task));
       return;
     }
   else if (RTFM_GIR_IS_ITEM (parent))
     {
+      GObject *object = rtfm_gir_item_get_object (RTFM_GIR_ITEM (parent));
+
+      if (RTFM_GIR_IS_FILE (object))
+        rtfm_gir_provider_visit (self, RTFM_GIR_FILE (object));
+
       rtfm_gir_item_populate_async (RTFM_GIR_ITEM (parent),
                                     collection,
                                     cancellable,
@@ -366,6 +1572,70 @@ rtfm_gir_provider_populate_finish (RtfmProvider  *provider,
   return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+static void
+rtfm_gir_provider_add_matches (SearchState *state,
+                               FuzzyIndex  *index,
+                               GListModel  *matches)
+{
+  const gchar *nsname;
+  guint n_items;
+  guint i;
+
+  g_assert (state != NULL);
+  g_assert (FUZZY_IS_INDEX (index));
+  g_assert (G_IS_LIST_MODEL (matches));
+
+  nsname = fuzzy_index_get_metadata_string (index, "namespace");
+
+  n_items = g_list_model_get_n_items (matches);
+
+  for (i = 0; i < n_items; i++)
+    {
+      g_autoptr(RtfmSearchResult) res = NULL;
+      g_autoptr(FuzzyIndexMatch) match = g_list_model_get_item (matches, i);
+      GVariant *variant = fuzzy_index_match_get_document (match);
+      gfloat score = fuzzy_index_match_get_score (match);
+      const gchar *id = NULL;
+
+      /*
+       * If this score is too low to get added to the results, then we can
+       * stop doing any more processing on these search results (as they
+       * are sorted by score).
+       */
+      if (!rtfm_search_results_accepts_with_score (state->results, score))
+        break;
+
+      if (!g_variant_lookup (variant, "id", "&s", &id) ||
+          !g_hash_table_add (state->seen, g_strdup (id)))
+        continue;
+
+      res = rtfm_gir_search_result_new (nsname, variant, score);
+
+      rtfm_search_results_add (state->results, res);
+    }
+}
+
+static void
+rtfm_gir_provider_query_changed (GListModel *model,
+                                 guint       position,
+                                 guint       removed,
+                                 guint       added,
+                                 GTask      *task)
+{
+  SearchState *state;
+
+  g_assert (FUZZY_IS_INDEX_CURSOR (model));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  /* Show provisional results while the rest of the query runs */
+  if (added > 0)
+    rtfm_gir_provider_add_matches (state,
+                                   fuzzy_index_cursor_get_index (FUZZY_INDEX_CURSOR (model)),
+                                   model);
+}
+
 static void
 rtfm_gir_provider_query_cb (GObject      *object,
                             GAsyncResult *result,
@@ -383,12 +1653,44 @@ rtfm_gir_provider_query_cb (GObject      *object,
   state = g_task_get_task_data (task);
 
   if (NULL != (ret = fuzzy_index_query_finish (index, result, &error)))
+    {
+      g_signal_handlers_disconnect_by_func (ret,
+                                            G_CALLBACK (rtfm_gir_provider_query_changed),
+                                            task);
+      rtfm_gir_provider_add_matches (state, index, ret);
+    }
+
+  g_clear_error (&error);
+
+  state->active--;
+
+  if (state->active == 0)
+    g_task_return_boolean (task, TRUE);
+}
+
+static void
+rtfm_gir_provider_doc_query_cb (GObject      *object,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  RtfmGirDocIndex *index = (RtfmGirDocIndex *)object;
+  g_autoptr(GListModel) ret = NULL;
+  g_autoptr(GTask) task = user_data;
+  SearchState *state;
+  GError *error = NULL;
+
+  g_assert (RTFM_GIR_IS_DOC_INDEX (index));
+  g_assert (G_IS_TASK (task));
+
+  state = g_task_get_task_data (task);
+
+  if (NULL != (ret = rtfm_gir_doc_index_query_finish (index, result, &error)))
     {
       const gchar *nsname;
       guint n_items;
       guint i;
 
-      nsname = fuzzy_index_get_metadata_string (index, "namespace");
+      nsname = rtfm_gir_doc_index_get_metadata_string (index, "namespace");
 
       n_items = g_list_model_get_n_items (ret);
 
@@ -399,20 +1701,20 @@ rtfm_gir_provider_query_cb (GObject      *object,
           GVariant *variant = fuzzy_index_match_get_document (match);
           gfloat score = fuzzy_index_match_get_score (match);
 
-          /*
-           * If this score is too low to get added to the results, then we can
-           * stop doing any more processing on these search results (as they
-           * are sorted by score).
-           */
+          score = RTFM_GIR_PROVIDER_DOC_SCORE_SCALE * score / (score + RTFM_GIR_PROVIDER_DOC_SCORE_HALF);
+
+          /* Results are sorted by score, so nothing after this will fit either */
           if (!rtfm_search_results_accepts_with_score (state->results, score))
             break;
 
-          res = rtfm_gir_search_result_new (nsname, variant, score);
+          res = rtfm_gir_search_result_new_for_doc (nsname, variant, score);
 
           rtfm_search_results_add (state->results, res);
         }
     }
 
+  g_clear_error (&error);
+
   state->active--;
 
   if (state->active == 0)
@@ -440,7 +1742,7 @@ rtfm_gir_provider_search_ready_cb (GObject      *object,
     }
 
   state = g_task_get_task_data (task);
-  state->active = self->search_indexes->len;
+  state->active = self->search_indexes->len + self->doc_indexes->len;
 
   if (state->active == 0)
     {
@@ -451,14 +1753,64 @@ rtfm_gir_provider_search_ready_cb (GObject      *object,
   for (i = 0; i < self->search_indexes->len; i++)
     {
       FuzzyIndex *index = g_ptr_array_index (self->search_indexes, i);
+      g_autoptr(GListModel) model = NULL;
+
+      model = fuzzy_index_query_begin (index,
+                                       state->query,
+                                       RTFM_GIR_PROVIDER_SEARCH_MAX,
+                                       g_task_get_cancellable (task),
+                                       rtfm_gir_provider_query_cb,
+                                       g_object_ref (task));
+
+      /* The task outlives the handler, which is removed in query_cb */
+      g_signal_connect (model,
+                        "items-changed",
+                        G_CALLBACK (rtfm_gir_provider_query_changed),
+                        task);
+    }
+
+  for (i = 0; i < self->doc_indexes->len; i++)
+    {
+      RtfmGirDocIndex *index = g_ptr_array_index (self->doc_indexes, i);
+
+      rtfm_gir_doc_index_query_async (index,
+                                      state->query,
+                                      RTFM_GIR_PROVIDER_SEARCH_MAX,
+                                      g_task_get_cancellable (task),
+                                      rtfm_gir_provider_doc_query_cb,
+                                      g_object_ref (task));
+    }
+}
+
+static void
+rtfm_gir_provider_search_discover_cb (GObject      *object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  RtfmGirProvider *self = (RtfmGirProvider *)object;
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(GPtrArray) plan = NULL;
+  SearchState *state;
+  GError *error = NULL;
+
+  g_assert (RTFM_IS_GIR_PROVIDER (self));
+  g_assert (G_IS_TASK (task));
 
-      fuzzy_index_query_async (index,
-                               state->query,
-                               RTFM_GIR_PROVIDER_SEARCH_MAX,
-                               g_task_get_cancellable (task),
-                               rtfm_gir_provider_query_cb,
-                               g_object_ref (task));
+  if (!rtfm_gir_provider_discover_finish (self, result, &error))
+    {
+      g_task_return_error (task, error);
+      return;
     }
+
+  state = g_task_get_task_data (task);
+  plan = rtfm_gir_provider_plan (self, state->query);
+
+  rtfm_gir_provider_load_indexes_async (self,
+                                        plan,
+                                        G_PRIORITY_DEFAULT,
+                                        g_task_get_cancellable (task),
+                                        rtfm_gir_provider_search_ready_cb,
+                                        g_object_ref (task));
 }
 
 static void
@@ -486,14 +1838,14 @@ rtfm_gir_provider_search_async (RtfmProvider        *provider,
   state = g_slice_new0 (SearchState);
   state->query = g_strdup (search_text);
   state->results = g_object_ref (search_results);
-  state->active = self->search_indexes->len;
+  state->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   g_task_set_task_data (task, state, search_state_free);
 
-  rtfm_gir_provider_load_indexes_async (self,
-                                        cancellable,
-                                        rtfm_gir_provider_search_ready_cb,
-                                        g_object_ref (task));
+  rtfm_gir_provider_discover_async (self,
+                                    cancellable,
+                                    rtfm_gir_provider_search_discover_cb,
+                                    g_object_ref (task));
 }
 
 static gboolean
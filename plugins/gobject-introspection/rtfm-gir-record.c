@@ -370,6 +370,10 @@ rtfm_gir_record_ingest (RtfmGirParserObject *object,
   self->foreign = rtfm_gir_parser_context_intern_string (parser_context, foreign);
   self->glib_is_gtype_struct_for = rtfm_gir_parser_context_intern_string (parser_context, glib_is_gtype_struct_for);
 
+  /* Members are parsed when the node is first browsed */
+  if (_rtfm_gir_parser_object_defer (RTFM_GIR_PARSER_OBJECT (self), context, element_name))
+    return TRUE;
+
   g_markup_parse_context_push (context, &markup_parser, self);
 
   return TRUE;
@@ -22,7 +22,6 @@
 #include <string.h>
 
 #include "rtfm-gir-search-result.h"
-#include "rtfm-gir-util.h"
 
 #include "rtfm-gir-constructor.h"
 #include "rtfm-gir-class.h"
@@ -209,12 +208,41 @@ rtfm_gir_search_result_new (const gchar *nsname,
                       "score", score,
                       NULL);
 
-  /* Rescore for categories, etc */
-  rtfm_search_result_set_score (RTFM_SEARCH_RESULT (ret), rtfm_gir_rescore (ret));
-
   return RTFM_SEARCH_RESULT (ret);
 }
 
+/**
+ * rtfm_gir_search_result_new_for_doc:
+ * @nsname: The namespace the document belongs to
+ * @document: The document that matched
+ * @score: The normalized score for the match
+ *
+ * Creates a search result for a match within the documentation text
+ * rather than the name of @document. These are grouped into their own
+ * category.
+ *
+ * Returns: (transfer full): A #RtfmSearchResult.
+ */
+RtfmSearchResult *
+rtfm_gir_search_result_new_for_doc (const gchar *nsname,
+                                    GVariant    *document,
+                                    gfloat       score)
+{
+  RtfmSearchResult *ret;
+
+  g_return_val_if_fail (document != NULL, NULL);
+
+  ret = g_object_new (RTFM_GIR_TYPE_SEARCH_RESULT,
+                      "subtitle", nsname,
+                      "document", document,
+                      "score", score,
+                      NULL);
+
+  rtfm_search_result_set_category (ret, _("Documentation"));
+
+  return ret;
+}
+
 GType
 rtfm_gir_search_result_get_item_type (RtfmGirSearchResult *self)
 {
@@ -30,6 +30,9 @@ G_DECLARE_FINAL_TYPE (RtfmGirSearchResult, rtfm_gir_search_result, RTFM_GIR, SEA
 RtfmSearchResult *rtfm_gir_search_result_new           (const gchar         *nsname,
                                                         GVariant            *document,
                                                         gfloat               score);
+RtfmSearchResult *rtfm_gir_search_result_new_for_doc   (const gchar         *nsname,
+                                                        GVariant            *document,
+                                                        gfloat               score);
 GType             rtfm_gir_search_result_get_item_type (RtfmGirSearchResult *self);
 
 G_END_DECLS
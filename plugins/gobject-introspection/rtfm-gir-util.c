@@ -18,8 +18,10 @@
 
 #define G_LOG_DOMAIN "rtfm-gir-util"
 
+#include <glib/gstdio.h>
+#include <math.h>
+
 #include "rtfm-gir-parser-types.h"
-#include "rtfm-gir-search-result.h"
 #include "rtfm-gir-util.h"
 
 #include "rtfm-gir-class.h"
@@ -102,39 +104,187 @@ rtfm_gir_generate_id (gpointer instance)
   return g_string_free (str, FALSE);
 }
 
-gfloat
-rtfm_gir_rescore (RtfmGirSearchResult *result)
+/*
+ * The popularity table is an optional file of "symbol count" lines, such
+ * as one generated from the symbols used by a project. It is loaded once
+ * and shared by every indexer, which may run from multiple threads.
+ */
+typedef struct
+{
+  GHashTable *counts;
+  guint64     mtime;
+  gdouble     max_weight;
+} Popularity;
+
+static gboolean popularity_disabled;
+
+static gchar *
+get_popularity_path (void)
+{
+  return g_build_filename (g_get_user_data_dir (),
+                           "rtfm",
+                           "gobject-introspection",
+                           "popularity",
+                           NULL);
+}
+
+static const Popularity *
+get_popularity (void)
 {
-  const gchar *text;
-  gfloat score;
-  GType type;
+  static Popularity *instance;
+
+  if (g_once_init_enter (&instance))
+    {
+      g_autofree gchar *path = get_popularity_path ();
+      g_autofree gchar *contents = NULL;
+      g_auto(GStrv) lines = NULL;
+      Popularity *popularity;
+      GStatBuf st;
+      guint i;
+
+      popularity = g_new0 (Popularity, 1);
+      popularity->counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+      if (!popularity_disabled &&
+          g_stat (path, &st) == 0 &&
+          g_file_get_contents (path, &contents, NULL, NULL))
+        {
+          popularity->mtime = st.st_mtime;
+          lines = g_strsplit (contents, "\n", 0);
+
+          for (i = 0; lines [i] != NULL; i++)
+            {
+              g_auto(GStrv) parts = NULL;
+              guint64 count;
+
+              g_strstrip (lines [i]);
+
+              if (lines [i][0] == '\0' || lines [i][0] == '#')
+                continue;
 
-  g_return_val_if_fail (RTFM_IS_SEARCH_RESULT (result), 0.0f);
+              parts = g_strsplit_set (lines [i], " \t", 2);
 
-  type = rtfm_gir_search_result_get_item_type (result);
-  score = rtfm_search_result_get_score (RTFM_SEARCH_RESULT (result));
-  text = rtfm_search_result_get_text (RTFM_SEARCH_RESULT (result));
+              if (parts [0] == NULL || parts [1] == NULL)
+                continue;
 
-  score *= .1f;
+              count = g_ascii_strtoull (g_strstrip (parts [1]), NULL, 10);
+
+              if (count == 0)
+                continue;
+
+              g_hash_table_insert (popularity->counts,
+                                   g_strdup (parts [0]),
+                                   GSIZE_TO_POINTER (MIN (count, G_MAXUINT)));
+              popularity->max_weight = MAX (popularity->max_weight, log1p (count));
+            }
+        }
+
+      g_once_init_leave (&instance, popularity);
+    }
+
+  return instance;
+}
+
+/**
+ * rtfm_gir_disable_popularity:
+ *
+ * Ignores the popularity table of the current user, so that the static
+ * ranks only depend on the .gir files. This must be called before any
+ * index is built, and is used when compiling indexes for everyone.
+ */
+void
+rtfm_gir_disable_popularity (void)
+{
+  popularity_disabled = TRUE;
+}
+
+/**
+ * rtfm_gir_get_popularity_mtime:
+ *
+ * Gets the modification time of the popularity table that was used
+ * when computing static ranks, so that indexes built with an older
+ * table can be rebuilt.
+ *
+ * Returns: The mtime of the table, or 0 if there is none.
+ */
+guint64
+rtfm_gir_get_popularity_mtime (void)
+{
+  return get_popularity ()->mtime;
+}
+
+static gboolean
+is_deprecated (gpointer instance)
+{
+  const gchar *deprecated = NULL;
+
+  if (FALSE) {}
+  else if (RTFM_GIR_IS_CLASS (instance))
+    deprecated = rtfm_gir_class_get_deprecated (instance);
+  else if (RTFM_GIR_IS_RECORD (instance))
+    deprecated = rtfm_gir_record_get_deprecated (instance);
+  else if (RTFM_GIR_IS_CONSTRUCTOR (instance))
+    deprecated = rtfm_gir_constructor_get_deprecated (instance);
+  else if (RTFM_GIR_IS_METHOD (instance))
+    deprecated = rtfm_gir_method_get_deprecated (instance);
+  else if (RTFM_GIR_IS_FUNCTION (instance))
+    deprecated = rtfm_gir_function_get_deprecated (instance);
+
+  return deprecated != NULL && g_strcmp0 (deprecated, "0") != 0;
+}
+
+/**
+ * rtfm_gir_get_static_rank:
+ * @instance: An #RtfmGirParserObject
+ * @word: The word the node is displayed as
+ *
+ * Computes the query-independent rank of a node, which is stored in the
+ * search index alongside its document. Namespaces and classes rank above
+ * records, constructors, methods and functions. Deprecated nodes rank at
+ * half of that, and private structures are buried entirely. Symbols found
+ * in the popularity table get a boost on top.
+ *
+ * Returns: The static rank for @instance.
+ */
+gdouble
+rtfm_gir_get_static_rank (gpointer     instance,
+                          const gchar *word)
+{
+  const Popularity *popularity;
+  gdouble rank = 0.0;
+  gpointer count;
+
+  g_return_val_if_fail (RTFM_GIR_IS_PARSER_OBJECT (instance), 0.0);
 
   /* Bury Private structures */
-  if (type == RTFM_GIR_TYPE_CLASS &&
-      (g_str_has_suffix (text, "Private") || g_str_has_suffix (text, "Priv")))
-    return score;
+  if ((RTFM_GIR_IS_CLASS (instance) || RTFM_GIR_IS_RECORD (instance)) &&
+      word != NULL &&
+      (g_str_has_suffix (word, "Private") || g_str_has_suffix (word, "Priv")))
+    return 0.0;
 
   if (FALSE) {}
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_NAMESPACE))
-    score += .6;
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_CLASS))
-    score += .5;
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_RECORD))
-    score += .4;
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_CONSTRUCTOR))
-    score += .3;
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_METHOD))
-    score += .2;
-  else if (g_type_is_a (type, RTFM_GIR_TYPE_FUNCTION))
-    score += .1;
-
-  return score;
+  else if (RTFM_GIR_IS_NAMESPACE (instance))
+    rank = .6;
+  else if (RTFM_GIR_IS_CLASS (instance))
+    rank = .5;
+  else if (RTFM_GIR_IS_RECORD (instance))
+    rank = .4;
+  else if (RTFM_GIR_IS_CONSTRUCTOR (instance))
+    rank = .3;
+  else if (RTFM_GIR_IS_METHOD (instance))
+    rank = .2;
+  else if (RTFM_GIR_IS_FUNCTION (instance))
+    rank = .1;
+
+  if (is_deprecated (instance))
+    rank *= .5;
+
+  popularity = get_popularity ();
+
+  if (word != NULL &&
+      popularity->max_weight > 0.0 &&
+      NULL != (count = g_hash_table_lookup (popularity->counts, word)))
+    rank += .1 * log1p (GPOINTER_TO_SIZE (count)) / popularity->max_weight;
+
+  return rank;
 }
@@ -21,12 +21,13 @@
 
 #include <glib.h>
 
-#include "rtfm-gir-search-result.h"
-
 G_BEGIN_DECLS
 
-gchar  *rtfm_gir_generate_id (gpointer             instance);
-gfloat  rtfm_gir_rescore     (RtfmGirSearchResult *result);
+gchar   *rtfm_gir_generate_id          (gpointer     instance);
+gdouble  rtfm_gir_get_static_rank      (gpointer     instance,
+                                        const gchar *word);
+guint64  rtfm_gir_get_popularity_mtime (void);
+void     rtfm_gir_disable_popularity   (void);
 
 G_END_DECLS
 
@@ -0,0 +1,239 @@
+/* test-doc-index.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fuzzy-glib.h>
+
+#include "rtfm-gir-doc-index.h"
+#include "rtfm-gir-doc-index-builder.h"
+
+static GMainLoop *main_loop;
+
+static void
+query_cb (GObject      *object,
+          GAsyncResult *result,
+          gpointer      user_data)
+{
+  GListModel **matches = user_data;
+  GError *error = NULL;
+
+  *matches = rtfm_gir_doc_index_query_finish (RTFM_GIR_DOC_INDEX (object), result, &error);
+  g_assert_no_error (error);
+  g_assert (*matches != NULL);
+
+  g_main_loop_quit (main_loop);
+}
+
+static GListModel *
+query (RtfmGirDocIndex *index,
+       const gchar     *text,
+       guint            max_matches)
+{
+  GListModel *matches = NULL;
+
+  rtfm_gir_doc_index_query_async (index, text, max_matches, NULL, query_cb, &matches);
+  g_main_loop_run (main_loop);
+
+  return matches;
+}
+
+static guint
+get_document (GListModel *matches,
+              guint       position)
+{
+  g_autoptr(FuzzyIndexMatch) match = g_list_model_get_item (matches, position);
+
+  g_assert (FUZZY_IS_INDEX_MATCH (match));
+
+  return g_variant_get_uint32 (fuzzy_index_match_get_document (match));
+}
+
+static void
+test_doc_index_tokenize (void)
+{
+  g_autofree gchar *max_word = g_strnfill (64, 'x');
+  g_autofree gchar *long_word = g_strnfill (65, 'y');
+  g_autofree gchar *text = NULL;
+  g_auto(GStrv) tokens = NULL;
+
+  /* Identifiers are split, stop words and single characters dropped */
+  tokens = rtfm_gir_doc_index_tokenize ("The gtk_widget_show() is a X call");
+  g_assert_cmpint (g_strv_length (tokens), ==, 4);
+  g_assert_cmpstr (tokens [0], ==, "gtk");
+  g_assert_cmpstr (tokens [1], ==, "widget");
+  g_assert_cmpstr (tokens [2], ==, "show");
+  g_assert_cmpstr (tokens [3], ==, "call");
+  g_clear_pointer (&tokens, g_strfreev);
+
+  /* Words are casefolded, and must be between 2 and 64 characters */
+  text = g_strdup_printf ("Ab %s %s", max_word, long_word);
+  tokens = rtfm_gir_doc_index_tokenize (text);
+  g_assert_cmpint (g_strv_length (tokens), ==, 2);
+  g_assert_cmpstr (tokens [0], ==, "ab");
+  g_assert_cmpstr (tokens [1], ==, max_word);
+  g_clear_pointer (&tokens, g_strfreev);
+
+  tokens = rtfm_gir_doc_index_tokenize (NULL);
+  g_assert_cmpint (g_strv_length (tokens), ==, 0);
+}
+
+static RtfmGirDocIndexBuilder *
+create_builder (void)
+{
+  RtfmGirDocIndexBuilder *builder;
+  guint i;
+
+  builder = rtfm_gir_doc_index_builder_new ();
+  rtfm_gir_doc_index_builder_set_metadata (builder, "namespace", g_variant_new_string ("Test 1.0"));
+
+  rtfm_gir_doc_index_builder_insert (builder, "Shows the widget on screen", g_variant_new_uint32 (0));
+  rtfm_gir_doc_index_builder_insert (builder, "Shows the widget and shows its children, shows everything", g_variant_new_uint32 (1));
+  rtfm_gir_doc_index_builder_insert (builder, "Hides the window", g_variant_new_uint32 (2));
+  rtfm_gir_doc_index_builder_insert (builder, "Allocation of the widget size", g_variant_new_uint32 (3));
+
+  /* Has no terms, and so is not indexed at all */
+  rtfm_gir_doc_index_builder_insert (builder, "the a of", g_variant_new_uint32 (99));
+
+  /* Enough documents between the rare ones that the deltas need several varint bytes */
+  for (i = 4; i < 400; i++)
+    {
+      g_autofree gchar *text = g_strdup_printf ("Filler %s", (i == 10 || i == 300) ? "rare" : "common");
+
+      rtfm_gir_doc_index_builder_insert (builder, text, g_variant_new_uint32 (i));
+    }
+
+  return builder;
+}
+
+static void
+check_index (RtfmGirDocIndex *index)
+{
+  g_autoptr(GListModel) matches = NULL;
+
+  g_assert_cmpstr (rtfm_gir_doc_index_get_metadata_string (index, "namespace"), ==, "Test 1.0");
+
+  /* More occurrences in a document rank it higher */
+  matches = query (index, "shows ", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 2);
+  g_assert_cmpint (get_document (matches, 0), ==, 1);
+  g_assert_cmpint (get_document (matches, 1), ==, 0);
+  g_clear_object (&matches);
+
+  /* The last word is a prefix while it is being typed ... */
+  matches = query (index, "wid", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 3);
+  g_clear_object (&matches);
+
+  matches = query (index, "win", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 1);
+  g_assert_cmpint (get_document (matches, 0), ==, 2);
+  g_clear_object (&matches);
+
+  /* ... but not once it is followed by a space */
+  matches = query (index, "wid ", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 0);
+  g_clear_object (&matches);
+
+  /* Every word counts towards the score */
+  matches = query (index, "widget allocation", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 3);
+  g_assert_cmpint (get_document (matches, 0), ==, 3);
+  g_clear_object (&matches);
+
+  matches = query (index, "the of ", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 0);
+  g_clear_object (&matches);
+
+  /* Postings decode across multi-byte deltas */
+  matches = query (index, "rare ", 0);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 2);
+  g_assert_cmpint (get_document (matches, 0), ==, 10);
+  g_assert_cmpint (get_document (matches, 1), ==, 300);
+  g_clear_object (&matches);
+
+  matches = query (index, "filler common", 5);
+  g_assert_cmpint (g_list_model_get_n_items (matches), ==, 5);
+  g_clear_object (&matches);
+}
+
+static void
+test_doc_index_basic (void)
+{
+  g_autoptr(RtfmGirDocIndexBuilder) builder = NULL;
+  g_autoptr(RtfmGirDocIndex) built = NULL;
+  g_autoptr(RtfmGirDocIndex) loaded = NULL;
+  g_autoptr(RtfmGirDocIndex) rewritten = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GFile) copy = NULL;
+  GError *error = NULL;
+  gboolean r;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  file = g_file_new_for_path ("doc-index.gvariant");
+  copy = g_file_new_for_path ("doc-index-copy.gvariant");
+
+  builder = create_builder ();
+
+  /* In memory, through rtfm_gir_doc_index_load_variant() */
+  built = rtfm_gir_doc_index_builder_build_index (builder);
+  g_assert (RTFM_GIR_IS_DOC_INDEX (built));
+  check_index (built);
+
+  /* Written by the builder and mapped back in */
+  r = rtfm_gir_doc_index_builder_write (builder, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  loaded = rtfm_gir_doc_index_new ();
+  r = rtfm_gir_doc_index_load_file (loaded, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+  check_index (loaded);
+
+  /* An index can only be loaded once */
+  r = rtfm_gir_doc_index_load_file (loaded, file, NULL, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVAL);
+  g_assert (!r);
+  g_clear_error (&error);
+
+  /* Written again from a loaded index */
+  r = rtfm_gir_doc_index_write (loaded, copy, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  rewritten = rtfm_gir_doc_index_new ();
+  r = rtfm_gir_doc_index_load_file (rewritten, copy, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+  check_index (rewritten);
+
+  g_file_delete (file, NULL, NULL);
+  g_file_delete (copy, NULL, NULL);
+
+  g_clear_pointer (&main_loop, g_main_loop_unref);
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Rtfm/Gir/DocIndex/tokenize", test_doc_index_tokenize);
+  g_test_add_func ("/Rtfm/Gir/DocIndex/basic", test_doc_index_basic);
+  return g_test_run ();
+}
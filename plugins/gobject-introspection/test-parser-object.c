@@ -0,0 +1,178 @@
+/* test-parser-object.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "rtfm-gir-class.h"
+#include "rtfm-gir-field.h"
+#include "rtfm-gir-method.h"
+#include "rtfm-gir-namespace.h"
+#include "rtfm-gir-parser.h"
+#include "rtfm-gir-record.h"
+
+static const gchar gir_contents[] =
+  "<?xml version=\"1.0\"?>\n"
+  "<repository version=\"1.2\"\n"
+  "            xmlns=\"http://www.gtk.org/introspection/core/1.0\"\n"
+  "            xmlns:c=\"http://www.gtk.org/introspection/c/1.0\"\n"
+  "            xmlns:glib=\"http://www.gtk.org/introspection/glib/1.0\">\n"
+  "  <namespace name=\"Test\" version=\"1.0\" c:identifier-prefixes=\"Test\" c:symbol-prefixes=\"test\">\n"
+  "    <class name=\"Widget\" c:type=\"TestWidget\" parent=\"GObject.Object\">\n"
+  "      <method name=\"show\" c:identifier=\"test_widget_show\">\n"
+  "        <return-value transfer-ownership=\"none\">\n"
+  "          <type name=\"none\" c:type=\"void\"/>\n"
+  "        </return-value>\n"
+  "      </method>\n"
+  "      <field name=\"parent_instance\">\n"
+  "        <type name=\"GObject.Object\" c:type=\"GObject\"/>\n"
+  "      </field>\n"
+  "      <method name=\"hide\" c:identifier=\"test_widget_hide\"/>\n"
+  "    </class>\n"
+  "    <record name=\"WidgetClass\" c:type=\"TestWidgetClass\">\n"
+  "      <field name=\"parent_class\">\n"
+  "        <type name=\"GObject.ObjectClass\" c:type=\"GObjectClass\"/>\n"
+  "      </field>\n"
+  "    </record>\n"
+  "    <function name=\"init\" c:identifier=\"test_init\"/>\n"
+  "  </namespace>\n"
+  "</repository>\n";
+
+static RtfmGirRepository *
+parse_skeleton (void)
+{
+  g_autoptr(RtfmGirParser) parser = NULL;
+  g_autoptr(GFile) file = NULL;
+  RtfmGirRepository *repository;
+  GError *error = NULL;
+  gboolean r;
+
+  file = g_file_new_for_path ("test-parser-object.gir");
+
+  r = g_file_replace_contents (file, gir_contents, strlen (gir_contents),
+                               NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  parser = rtfm_gir_parser_new ();
+  repository = rtfm_gir_parser_parse_skeleton (parser, file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (RTFM_GIR_IS_REPOSITORY (repository));
+
+  r = g_file_delete (file, NULL, &error);
+  g_assert_no_error (error);
+  g_assert (r);
+
+  return repository;
+}
+
+static RtfmGirParserObject *
+get_only_child (RtfmGirParserObject *object,
+                GType                type)
+{
+  GPtrArray *children = rtfm_gir_parser_object_get_children_typed (object, type);
+
+  g_assert (children != NULL);
+  g_assert_cmpint (children->len, ==, 1);
+
+  return g_ptr_array_index (children, 0);
+}
+
+static void
+test_parser_object_deferred (void)
+{
+  g_autoptr(RtfmGirRepository) repository = parse_skeleton ();
+  RtfmGirParserObject *namespace;
+  RtfmGirParserObject *klass;
+  RtfmGirParserObject *record;
+  GPtrArray *methods;
+
+  namespace = get_only_child (RTFM_GIR_PARSER_OBJECT (repository), RTFM_GIR_TYPE_NAMESPACE);
+  klass = get_only_child (namespace, RTFM_GIR_TYPE_CLASS);
+  record = get_only_child (namespace, RTFM_GIR_TYPE_RECORD);
+
+  /* The members of the class are only parsed by this lookup */
+  methods = rtfm_gir_parser_object_get_children_typed (klass, RTFM_GIR_TYPE_METHOD);
+  g_assert_cmpint (methods->len, ==, 2);
+  g_assert_cmpstr (rtfm_gir_method_get_name (g_ptr_array_index (methods, 0)), ==, "show");
+  g_assert_cmpstr (rtfm_gir_method_get_name (g_ptr_array_index (methods, 1)), ==, "hide");
+
+  /* Same for the record, asking whether there is any without sorting */
+  g_assert (rtfm_gir_parser_object_has_child_typed (record, RTFM_GIR_TYPE_FIELD));
+  g_assert (!rtfm_gir_parser_object_has_child_typed (record, RTFM_GIR_TYPE_METHOD));
+  get_only_child (record, RTFM_GIR_TYPE_FIELD);
+}
+
+static void
+test_parser_object_parent_type (void)
+{
+  g_autoptr(RtfmGirRepository) repository = parse_skeleton ();
+  RtfmGirParserObject *namespace;
+  RtfmGirParserObject *klass;
+  GPtrArray *children;
+  GPtrArray *typed;
+  guint i;
+
+  namespace = get_only_child (RTFM_GIR_PARSER_OBJECT (repository), RTFM_GIR_TYPE_NAMESPACE);
+  klass = get_only_child (namespace, RTFM_GIR_TYPE_CLASS);
+
+  /* Sorts the children of the class by their exact type first */
+  get_only_child (klass, RTFM_GIR_TYPE_FIELD);
+
+  children = rtfm_gir_parser_object_get_children (klass);
+  typed = rtfm_gir_parser_object_get_children_typed (klass, RTFM_GIR_TYPE_PARSER_OBJECT);
+  g_assert_cmpint (children->len, ==, 3);
+  g_assert_cmpint (typed->len, ==, children->len);
+
+  for (i = 0; i < children->len; i++)
+    g_assert (g_ptr_array_index (typed, i) == g_ptr_array_index (children, i));
+
+  g_assert (rtfm_gir_parser_object_has_child_typed (klass, RTFM_GIR_TYPE_PARSER_OBJECT));
+  g_assert (!rtfm_gir_parser_object_has_child_typed (klass, RTFM_GIR_TYPE_RECORD));
+}
+
+static void
+test_parser_object_append (void)
+{
+  g_autoptr(RtfmGirRepository) repository = parse_skeleton ();
+  RtfmGirParserObject *namespace;
+  RtfmGirParserObject *klass;
+  GPtrArray *classes;
+
+  namespace = get_only_child (RTFM_GIR_PARSER_OBJECT (repository), RTFM_GIR_TYPE_NAMESPACE);
+  get_only_child (namespace, RTFM_GIR_TYPE_CLASS);
+
+  /* Append a child the way the parsers do, after the buckets were made */
+  klass = RTFM_GIR_PARSER_OBJECT (rtfm_gir_class_new (rtfm_gir_parser_object_get_parser_context (namespace)));
+  _rtfm_gir_parser_object_set_parent (klass, namespace);
+  g_ptr_array_add (rtfm_gir_parser_object_get_children (namespace), klass);
+
+  classes = rtfm_gir_parser_object_get_children_typed (namespace, RTFM_GIR_TYPE_CLASS);
+  g_assert_cmpint (classes->len, ==, 2);
+  g_assert (g_ptr_array_index (classes, 1) == (gpointer)klass);
+}
+
+gint
+main (gint argc,
+      gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Rtfm/Gir/ParserObject/deferred", test_parser_object_deferred);
+  g_test_add_func ("/Rtfm/Gir/ParserObject/parent-type", test_parser_object_parent_type);
+  g_test_add_func ("/Rtfm/Gir/ParserObject/append", test_parser_object_append);
+  return g_test_run ();
+}
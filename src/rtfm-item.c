@@ -515,6 +515,11 @@ rtfm_item_unparent (RtfmItem *self)
       RtfmItem *iter;
       guint position = 0;
 
+      for (iter = GET_PRIVATE (parent)->first_child;
+           iter != NULL && iter != self;
+           iter = GET_PRIVATE (iter)->next)
+        position++;
+
       if (priv->prev != NULL)
         GET_PRIVATE (priv->prev)->next = priv->next;
       else
@@ -531,11 +536,6 @@ rtfm_item_unparent (RtfmItem *self)
       priv->next = NULL;
       priv->parent = NULL;
 
-      for (iter = GET_PRIVATE (parent)->first_child;
-           iter != NULL && iter != self;
-           iter = GET_PRIVATE (iter)->next)
-        position++;
-
       g_list_model_items_changed (G_LIST_MODEL (parent), position, 1, 0);
 
       rtfm_item_assert_valid (self);
@@ -694,6 +694,27 @@ rtfm_item_insert_before (RtfmItem *self,
   g_list_model_items_changed (G_LIST_MODEL (self), position, 0, 1);
 }
 
+/**
+ * rtfm_item_remove:
+ * @self: An #RtfmItem
+ * @child: An #RtfmItem that is a child of @self
+ *
+ * Removes @child from the children of @self, releasing the reference
+ * that @self held to it.
+ */
+void
+rtfm_item_remove (RtfmItem *self,
+                  RtfmItem *child)
+{
+  RtfmItemPrivate *childpriv = rtfm_item_get_instance_private (child);
+
+  g_return_if_fail (RTFM_IS_ITEM (self));
+  g_return_if_fail (RTFM_IS_ITEM (child));
+  g_return_if_fail (childpriv->parent == self);
+
+  rtfm_item_unparent (child);
+}
+
 /**
  * rtfm_item_get_children:
  * @self: An #RtfmItem
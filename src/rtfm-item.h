@@ -68,6 +68,8 @@ void         rtfm_item_insert_after        (RtfmItem    *self,
 void         rtfm_item_insert_before       (RtfmItem    *self,
                                             RtfmItem    *sibling,
                                             RtfmItem    *child);
+void         rtfm_item_remove              (RtfmItem    *self,
+                                            RtfmItem    *child);
 void         rtfm_item_remove_all          (RtfmItem    *self);
 gboolean     rtfm_item_get_visible         (RtfmItem    *self);
 void         rtfm_item_set_visible         (RtfmItem    *self,
@@ -29,6 +29,7 @@
 #include "rtfm-library.h"
 #include "rtfm-library-private.h"
 #include "rtfm-provider.h"
+#include "rtfm-scheduler.h"
 
 /**
  * SECTION:rtfm-library
@@ -56,6 +57,7 @@ struct _RtfmLibrary
   PeasEngine       *engine;
   PeasExtensionSet *providers;
   RtfmItem         *root;
+  RtfmScheduler    *scheduler;
 };
 
 typedef struct
@@ -217,6 +219,7 @@ rtfm_library_finalize (GObject *object)
   g_clear_object (&self->root);
   g_clear_object (&self->providers);
   g_clear_object (&self->engine);
+  g_clear_object (&self->scheduler);
 
   G_OBJECT_CLASS (rtfm_library_parent_class)->finalize (object);
 }
@@ -274,6 +277,8 @@ rtfm_library_class_init (RtfmLibraryClass *klass)
 static void
 rtfm_library_init (RtfmLibrary *self)
 {
+  self->scheduler = g_object_ref (rtfm_scheduler_get_default ());
+
   rtfm_library_reset (self);
 }
 
@@ -563,6 +568,25 @@ rtfm_library_get_root (RtfmLibrary *self)
   return self->root;
 }
 
+/**
+ * rtfm_library_get_scheduler:
+ * @self: An #RtfmLibrary
+ *
+ * Gets the scheduler that providers should use to run work on threads,
+ * so that searches are not queued behind indexing. This is the default
+ * scheduler, which is also used by code with no library at hand, so
+ * that all of the work shares one set of workers.
+ *
+ * Returns: (transfer none): An #RtfmScheduler.
+ */
+RtfmScheduler *
+rtfm_library_get_scheduler (RtfmLibrary *self)
+{
+  g_return_val_if_fail (RTFM_IS_LIBRARY (self), NULL);
+
+  return self->scheduler;
+}
+
 static void
 rtfm_library_search_cb (GObject      *object,
                         GAsyncResult *result,
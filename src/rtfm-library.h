@@ -25,30 +25,31 @@
 
 G_BEGIN_DECLS
 
-RtfmLibrary  *rtfm_library_new             (void);
-RtfmLibrary  *rtfm_library_get_default     (void);
-RtfmItem     *rtfm_library_get_item_by_id  (RtfmLibrary           *self,
-                                            const gchar           *id);
-RtfmProvider *rtfm_library_get_provider    (RtfmLibrary           *self,
-                                            const gchar           *id);
-RtfmItem     *rtfm_library_get_root        (RtfmLibrary           *self);
-void          rtfm_library_populate_async  (RtfmLibrary           *self,
-                                            RtfmItem              *item,
-                                            GCancellable          *cancellable,
-                                            GAsyncReadyCallback    callback,
-                                            gpointer               user_data);
-gboolean      rtfm_library_populate_finish (RtfmLibrary           *self,
-                                            GAsyncResult          *result,
-                                            GError               **error);
-void          rtfm_library_search_async    (RtfmLibrary           *self,
-                                            RtfmSearchSettings    *search_settings,
-                                            RtfmSearchResults     *search_results,
-                                            GCancellable          *cancellable,
-                                            GAsyncReadyCallback    callback,
-                                            gpointer               user_data);
-gboolean      rtfm_library_search_finish   (RtfmLibrary           *self,
-                                            GAsyncResult          *result,
-                                            GError               **error);
+RtfmLibrary   *rtfm_library_new             (void);
+RtfmLibrary   *rtfm_library_get_default     (void);
+RtfmItem      *rtfm_library_get_item_by_id  (RtfmLibrary           *self,
+                                             const gchar           *id);
+RtfmProvider  *rtfm_library_get_provider    (RtfmLibrary           *self,
+                                             const gchar           *id);
+RtfmItem      *rtfm_library_get_root        (RtfmLibrary           *self);
+RtfmScheduler *rtfm_library_get_scheduler   (RtfmLibrary           *self);
+void           rtfm_library_populate_async  (RtfmLibrary           *self,
+                                             RtfmItem              *item,
+                                             GCancellable          *cancellable,
+                                             GAsyncReadyCallback    callback,
+                                             gpointer               user_data);
+gboolean       rtfm_library_populate_finish (RtfmLibrary           *self,
+                                             GAsyncResult          *result,
+                                             GError               **error);
+void           rtfm_library_search_async    (RtfmLibrary           *self,
+                                             RtfmSearchSettings    *search_settings,
+                                             RtfmSearchResults     *search_results,
+                                             GCancellable          *cancellable,
+                                             GAsyncReadyCallback    callback,
+                                             gpointer               user_data);
+gboolean       rtfm_library_search_finish   (RtfmLibrary           *self,
+                                             GAsyncResult          *result,
+                                             GError               **error);
 
 G_END_DECLS
 
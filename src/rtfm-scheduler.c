@@ -0,0 +1,405 @@
+/* rtfm-scheduler.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#define G_LOG_DOMAIN "rtfm-scheduler"
+
+#include "rtfm-scheduler.h"
+
+/**
+ * SECTION:rtfm-scheduler
+ * @title: RtfmScheduler
+ * @short_description: Runs background work by priority
+ *
+ * The #RtfmScheduler runs the worker of a #GTask on a thread, much like
+ * g_task_run_in_thread(), but queued by priority class so that searches
+ * the user is waiting on do not have to wait for indexing to complete.
+ *
+ * Interactive and visible work share one set of workers, bounded by the
+ * number of processors, and are run in that order. Background work has
+ * a separate and smaller set of workers so that it can never occupy all
+ * of the threads available to interactive work.
+ *
+ * Work may be placed in a cancellation group, so that everything still
+ * queued for a group can be dropped at once with
+ * rtfm_scheduler_cancel_group().
+ */
+
+struct _RtfmScheduler
+{
+  GObject      parent_instance;
+
+  GMutex       mutex;
+
+  /* Interactive and visible jobs, sorted by priority */
+  GThreadPool *foreground;
+  GThreadPool *background;
+
+  /* GQuark of the group to the number of times it was cancelled */
+  GHashTable  *group_serials;
+
+  guint64      sequence;
+  guint        max_workers;
+};
+
+typedef struct
+{
+  GTask                 *task;
+  GTaskThreadFunc        thread_func;
+  RtfmSchedulerPriority  priority;
+  GQuark                 group;
+  guint                  serial;
+  guint64                sequence;
+} Job;
+
+enum {
+  PROP_0,
+  PROP_MAX_WORKERS,
+  N_PROPS
+};
+
+G_DEFINE_TYPE (RtfmScheduler, rtfm_scheduler, G_TYPE_OBJECT)
+
+static GParamSpec *properties [N_PROPS];
+
+GType
+rtfm_scheduler_priority_get_type (void)
+{
+  static gsize type_id;
+  static const GEnumValue values[] = {
+    { RTFM_SCHEDULER_PRIORITY_INTERACTIVE, "RTFM_SCHEDULER_PRIORITY_INTERACTIVE", "interactive" },
+    { RTFM_SCHEDULER_PRIORITY_VISIBLE, "RTFM_SCHEDULER_PRIORITY_VISIBLE", "visible" },
+    { RTFM_SCHEDULER_PRIORITY_BACKGROUND, "RTFM_SCHEDULER_PRIORITY_BACKGROUND", "background" },
+    { 0 }
+  };
+
+  if (g_once_init_enter (&type_id))
+    g_once_init_leave (&type_id, g_enum_register_static ("RtfmSchedulerPriority", values));
+
+  return type_id;
+}
+
+static void
+job_free (Job *job)
+{
+  g_clear_object (&job->task);
+  g_slice_free (Job, job);
+}
+
+static gint
+job_compare (gconstpointer a,
+             gconstpointer b,
+             gpointer      user_data)
+{
+  const Job *job_a = a;
+  const Job *job_b = b;
+
+  if (job_a->priority != job_b->priority)
+    return job_a->priority < job_b->priority ? -1 : 1;
+
+  return (job_a->sequence > job_b->sequence) - (job_a->sequence < job_b->sequence);
+}
+
+static void
+rtfm_scheduler_worker (gpointer data,
+                       gpointer user_data)
+{
+  RtfmScheduler *self = user_data;
+  Job *job = data;
+  gboolean group_cancelled = FALSE;
+
+  g_assert (RTFM_IS_SCHEDULER (self));
+  g_assert (job != NULL);
+  g_assert (G_IS_TASK (job->task));
+
+  /*
+   * Tasks which do not check their cancellable complete themselves on
+   * cancellation, often along with other tasks waiting on the same
+   * work, so they must always be run.
+   */
+  if (!g_task_get_check_cancellable (job->task))
+    goto run;
+
+  if (job->group != 0)
+    {
+      g_mutex_lock (&self->mutex);
+      group_cancelled = job->serial != GPOINTER_TO_UINT (g_hash_table_lookup (self->group_serials,
+                                                                              GUINT_TO_POINTER (job->group)));
+      g_mutex_unlock (&self->mutex);
+    }
+
+  if (group_cancelled)
+    {
+      g_task_return_new_error (job->task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_CANCELLED,
+                               "The operation was cancelled");
+      goto cleanup;
+    }
+
+  if (g_task_return_error_if_cancelled (job->task))
+    goto cleanup;
+
+run:
+  job->thread_func (job->task,
+                    g_task_get_source_object (job->task),
+                    g_task_get_task_data (job->task),
+                    g_task_get_cancellable (job->task));
+
+cleanup:
+  job_free (job);
+}
+
+static void
+rtfm_scheduler_constructed (GObject *object)
+{
+  RtfmScheduler *self = (RtfmScheduler *)object;
+
+  G_OBJECT_CLASS (rtfm_scheduler_parent_class)->constructed (object);
+
+  if (self->max_workers == 0)
+    self->max_workers = MAX (2, g_get_num_processors ());
+
+  self->foreground = g_thread_pool_new (rtfm_scheduler_worker,
+                                        self,
+                                        self->max_workers,
+                                        FALSE,
+                                        NULL);
+  g_thread_pool_set_sort_function (self->foreground, job_compare, NULL);
+
+  self->background = g_thread_pool_new (rtfm_scheduler_worker,
+                                        self,
+                                        MAX (1, self->max_workers / 2),
+                                        FALSE,
+                                        NULL);
+  g_thread_pool_set_sort_function (self->background, job_compare, NULL);
+}
+
+static void
+rtfm_scheduler_finalize (GObject *object)
+{
+  RtfmScheduler *self = (RtfmScheduler *)object;
+
+  /* Queued jobs still hold tasks, so let them complete */
+  g_thread_pool_free (self->foreground, FALSE, TRUE);
+  self->foreground = NULL;
+
+  g_thread_pool_free (self->background, FALSE, TRUE);
+  self->background = NULL;
+
+  g_clear_pointer (&self->group_serials, g_hash_table_unref);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (rtfm_scheduler_parent_class)->finalize (object);
+}
+
+static void
+rtfm_scheduler_get_property (GObject    *object,
+                             guint       prop_id,
+                             GValue     *value,
+                             GParamSpec *pspec)
+{
+  RtfmScheduler *self = RTFM_SCHEDULER (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_WORKERS:
+      g_value_set_uint (value, rtfm_scheduler_get_max_workers (self));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+rtfm_scheduler_set_property (GObject      *object,
+                             guint         prop_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  RtfmScheduler *self = RTFM_SCHEDULER (object);
+
+  switch (prop_id)
+    {
+    case PROP_MAX_WORKERS:
+      self->max_workers = g_value_get_uint (value);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+rtfm_scheduler_class_init (RtfmSchedulerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->constructed = rtfm_scheduler_constructed;
+  object_class->finalize = rtfm_scheduler_finalize;
+  object_class->get_property = rtfm_scheduler_get_property;
+  object_class->set_property = rtfm_scheduler_set_property;
+
+  properties [PROP_MAX_WORKERS] =
+    g_param_spec_uint ("max-workers",
+                       "Max Workers",
+                       "The max number of threads for interactive work, or 0 for the number of processors.",
+                       0,
+                       G_MAXUINT,
+                       0,
+                       (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_properties (object_class, N_PROPS, properties);
+}
+
+static void
+rtfm_scheduler_init (RtfmScheduler *self)
+{
+  g_mutex_init (&self->mutex);
+  self->group_serials = g_hash_table_new (NULL, NULL);
+}
+
+/**
+ * rtfm_scheduler_new:
+ * @max_workers: The max number of threads for interactive work, or 0
+ *   to use the number of processors.
+ *
+ * Creates a new #RtfmScheduler. Most code should share the scheduler
+ * from rtfm_library_get_scheduler() instead.
+ *
+ * Returns: (transfer full): A #RtfmScheduler
+ */
+RtfmScheduler *
+rtfm_scheduler_new (guint max_workers)
+{
+  return g_object_new (RTFM_TYPE_SCHEDULER,
+                       "max-workers", max_workers,
+                       NULL);
+}
+
+/**
+ * rtfm_scheduler_get_default:
+ *
+ * Gets the scheduler shared by the library and its plugins.
+ *
+ * Returns: (transfer none): An #RtfmScheduler.
+ */
+RtfmScheduler *
+rtfm_scheduler_get_default (void)
+{
+  static RtfmScheduler *instance;
+
+  if (g_once_init_enter (&instance))
+    g_once_init_leave (&instance, rtfm_scheduler_new (0));
+
+  return instance;
+}
+
+guint
+rtfm_scheduler_get_max_workers (RtfmScheduler *self)
+{
+  g_return_val_if_fail (RTFM_IS_SCHEDULER (self), 0);
+
+  return self->max_workers;
+}
+
+/**
+ * rtfm_scheduler_run_in_thread:
+ * @self: An #RtfmScheduler
+ * @task: A #GTask
+ * @priority: The priority class of the work
+ * @group: A cancellation group, or 0
+ * @thread_func: (scope async): The function to run on a worker thread
+ *
+ * Queues @thread_func to be run on a worker thread, like
+ * g_task_run_in_thread(). @thread_func must complete @task.
+ *
+ * Work with a higher priority class is run before any queued work with
+ * a lower one, and work within the same class is run in the order it
+ * was queued. If the cancellable of @task is cancelled before a worker
+ * picks it up, @task is completed with %G_IO_ERROR_CANCELLED without
+ * running @thread_func, unless g_task_set_check_cancellable() was used
+ * to disable that for @task.
+ */
+void
+rtfm_scheduler_run_in_thread (RtfmScheduler         *self,
+                              GTask                 *task,
+                              RtfmSchedulerPriority  priority,
+                              GQuark                 group,
+                              GTaskThreadFunc        thread_func)
+{
+  g_autoptr(GError) error = NULL;
+  GThreadPool *pool;
+  Job *job;
+
+  g_return_if_fail (RTFM_IS_SCHEDULER (self));
+  g_return_if_fail (G_IS_TASK (task));
+  g_return_if_fail (priority <= RTFM_SCHEDULER_PRIORITY_BACKGROUND);
+  g_return_if_fail (thread_func != NULL);
+
+  job = g_slice_new0 (Job);
+  job->task = g_object_ref (task);
+  job->thread_func = thread_func;
+  job->priority = priority;
+  job->group = group;
+
+  g_mutex_lock (&self->mutex);
+  job->sequence = self->sequence++;
+  if (group != 0)
+    job->serial = GPOINTER_TO_UINT (g_hash_table_lookup (self->group_serials,
+                                                         GUINT_TO_POINTER (group)));
+  g_mutex_unlock (&self->mutex);
+
+  if (priority == RTFM_SCHEDULER_PRIORITY_BACKGROUND)
+    pool = self->background;
+  else
+    pool = self->foreground;
+
+  if (!g_thread_pool_push (pool, job, &error))
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      job_free (job);
+    }
+}
+
+/**
+ * rtfm_scheduler_cancel_group:
+ * @self: An #RtfmScheduler
+ * @group: The cancellation group
+ *
+ * Cancels all work in @group which has not yet started, completing
+ * the tasks with %G_IO_ERROR_CANCELLED. Work which is already running
+ * should be stopped through the #GCancellable of its task. Tasks which
+ * do not check their cancellable are still run.
+ */
+void
+rtfm_scheduler_cancel_group (RtfmScheduler *self,
+                             GQuark         group)
+{
+  gpointer key = GUINT_TO_POINTER (group);
+  guint serial;
+
+  g_return_if_fail (RTFM_IS_SCHEDULER (self));
+  g_return_if_fail (group != 0);
+
+  g_mutex_lock (&self->mutex);
+  serial = GPOINTER_TO_UINT (g_hash_table_lookup (self->group_serials, key));
+  g_hash_table_insert (self->group_serials, key, GUINT_TO_POINTER (serial + 1));
+  g_mutex_unlock (&self->mutex);
+}
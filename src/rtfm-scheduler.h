@@ -0,0 +1,51 @@
+/* rtfm-scheduler.h
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTFM_SCHEDULER_H
+#define RTFM_SCHEDULER_H
+
+#include <gio/gio.h>
+
+#include "rtfm-types.h"
+
+G_BEGIN_DECLS
+
+#define RTFM_TYPE_SCHEDULER_PRIORITY (rtfm_scheduler_priority_get_type())
+
+typedef enum
+{
+  RTFM_SCHEDULER_PRIORITY_INTERACTIVE,
+  RTFM_SCHEDULER_PRIORITY_VISIBLE,
+  RTFM_SCHEDULER_PRIORITY_BACKGROUND,
+} RtfmSchedulerPriority;
+
+GType          rtfm_scheduler_priority_get_type (void);
+RtfmScheduler *rtfm_scheduler_new               (guint                  max_workers);
+RtfmScheduler *rtfm_scheduler_get_default       (void);
+guint          rtfm_scheduler_get_max_workers   (RtfmScheduler         *self);
+void           rtfm_scheduler_run_in_thread     (RtfmScheduler         *self,
+                                                 GTask                 *task,
+                                                 RtfmSchedulerPriority  priority,
+                                                 GQuark                 group,
+                                                 GTaskThreadFunc        thread_func);
+void           rtfm_scheduler_cancel_group      (RtfmScheduler         *self,
+                                                 GQuark                 group);
+
+G_END_DECLS
+
+#endif /* RTFM_SCHEDULER_H */
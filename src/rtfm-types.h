@@ -30,6 +30,7 @@ G_BEGIN_DECLS
 #define RTFM_TYPE_PATH_BAR (rtfm_path_bar_get_type())
 #define RTFM_TYPE_PATH_ELEMENT (rtfm_path_element_get_type())
 #define RTFM_TYPE_PROVIDER (rtfm_provider_get_type ())
+#define RTFM_TYPE_SCHEDULER (rtfm_scheduler_get_type())
 #define RTFM_TYPE_SEARCH_RESULT (rtfm_search_result_get_type())
 #define RTFM_TYPE_SEARCH_RESULTS (rtfm_search_results_get_type())
 #define RTFM_TYPE_SEARCH_SETTINGS (rtfm_search_settings_get_type())
@@ -53,6 +54,7 @@ G_DECLARE_FINAL_TYPE (RtfmLibrary, rtfm_library, RTFM, LIBRARY, GObject)
 G_DECLARE_FINAL_TYPE (RtfmPath, rtfm_path, RTFM, PATH, GObject)
 G_DECLARE_FINAL_TYPE (RtfmPathBar, rtfm_path_bar, RTFM, PATH_BAR, GtkBox)
 G_DECLARE_FINAL_TYPE (RtfmPathElement, rtfm_path_element, RTFM, PATH_ELEMENT, GObject)
+G_DECLARE_FINAL_TYPE (RtfmScheduler, rtfm_scheduler, RTFM, SCHEDULER, GObject)
 G_DECLARE_FINAL_TYPE (RtfmSearchResults, rtfm_search_results, RTFM, SEARCH_RESULTS, GObject)
 G_DECLARE_FINAL_TYPE (RtfmSearchSettings, rtfm_search_settings, RTFM, SEARCH_SETTINGS, GObject)
 G_DECLARE_FINAL_TYPE (RtfmSidebarRow, rtfm_sidebar_row, RTFM, SIDEBAR_ROW, GtkListBoxRow)
@@ -32,6 +32,7 @@ G_BEGIN_DECLS
 # include "rtfm-path-bar.h"
 # include "rtfm-path-element.h"
 # include "rtfm-provider.h"
+# include "rtfm-scheduler.h"
 # include "rtfm-sidebar.h"
 # include "rtfm-sidebar-row.h"
 # include "rtfm-search-result.h"
@@ -0,0 +1,433 @@
+/* bench-search.c
+ *
+ * Copyright (C) 2016 Christian Hergert <chergert@redhat.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Replays recorded typing against RtfmLibrary without a window, the
+ * same way RtfmWindow issues searches: every keystroke cancels the
+ * active search and (re)queues a new one after a short delay.
+ *
+ * The recording contains one keystroke per line, as the delay in
+ * milliseconds since the previous keystroke followed by the contents
+ * of the search entry after it. Blank lines separate sequences, which
+ * are replayed one after another once the searches of the previous
+ * sequence have settled. Lines starting with # are ignored.
+ *
+ * Run it from the top of the build directory so that the in-tree
+ * plugins are found.
+ */
+
+#include <math.h>
+#include <rtfm.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Keep in sync with rtfm-window.c */
+#define SEARCH_TIMEOUT_DELAY 10
+#define SEARCH_MAX_RESULTS   25
+
+typedef struct
+{
+  gint64  delay;
+  gchar  *text;
+} Keystroke;
+
+typedef struct
+{
+  RtfmLibrary        *library;
+  RtfmSearchSettings *search_settings;
+  GMainLoop          *main_loop;
+
+  /* Array of GPtrArray of Keystroke */
+  GPtrArray          *sequences;
+  guint               sequence;
+  guint               keystroke;
+
+  /* The state of the emulated search entry */
+  gchar              *text;
+  gint64              last_keystroke;
+  guint               queued_search;
+  GCancellable       *search_cancellable;
+  guint               active_search_count;
+
+  GArray             *first_result;
+  GArray             *stable_result;
+  guint               n_cancelled;
+  guint               n_empty;
+} Harness;
+
+typedef struct
+{
+  Harness           *harness;
+  RtfmSearchResults *search_results;
+  gint64             keystroke;
+  gint64             first_result;
+} Search;
+
+static gboolean warmup;
+
+static GOptionEntry entries[] = {
+  { "warmup", 'w', 0, G_OPTION_ARG_NONE, &warmup, "Run each sequence once before measuring", NULL },
+  { NULL }
+};
+
+static void harness_next_keystroke (Harness *harness);
+static void harness_next_sequence  (Harness *harness);
+
+static void
+keystroke_free (gpointer data)
+{
+  Keystroke *keystroke = data;
+
+  g_free (keystroke->text);
+  g_slice_free (Keystroke, keystroke);
+}
+
+static GPtrArray *
+load_sequences (const gchar  *path,
+                GError      **error)
+{
+  g_autoptr(GPtrArray) sequences = NULL;
+  g_autofree gchar *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  GPtrArray *sequence = NULL;
+  guint i;
+
+  if (!g_file_get_contents (path, &contents, NULL, error))
+    return NULL;
+
+  sequences = g_ptr_array_new_with_free_func ((GDestroyNotify)g_ptr_array_unref);
+  lines = g_strsplit (contents, "\n", 0);
+
+  for (i = 0; lines [i] != NULL; i++)
+    {
+      const gchar *line = lines [i];
+      Keystroke *keystroke;
+      gchar *end = NULL;
+      gint64 delay;
+
+      if (*line == '#')
+        continue;
+
+      if (*line == '\0')
+        {
+          sequence = NULL;
+          continue;
+        }
+
+      delay = g_ascii_strtoll (line, &end, 10);
+
+      if (end == line || delay < 0 || (*end != ' ' && *end != '\t'))
+        {
+          g_set_error (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "%s:%u: expected \"DELAY TEXT\"",
+                       path, i + 1);
+          return NULL;
+        }
+
+      if (sequence == NULL)
+        {
+          sequence = g_ptr_array_new_with_free_func (keystroke_free);
+          g_ptr_array_add (sequences, sequence);
+        }
+
+      keystroke = g_slice_new0 (Keystroke);
+      keystroke->delay = delay;
+      keystroke->text = g_strdup (end + 1);
+      g_ptr_array_add (sequence, keystroke);
+    }
+
+  return g_steal_pointer (&sequences);
+}
+
+static void
+search_results_items_changed (GListModel *model,
+                              guint       position,
+                              guint       removed,
+                              guint       added,
+                              Search     *search)
+{
+  if (search->first_result == 0 && g_list_model_get_n_items (model) > 0)
+    search->first_result = g_get_monotonic_time ();
+}
+
+static void
+harness_maybe_next_sequence (Harness *harness)
+{
+  GPtrArray *sequence = g_ptr_array_index (harness->sequences, harness->sequence);
+
+  if (harness->keystroke == sequence->len &&
+      harness->queued_search == 0 &&
+      harness->active_search_count == 0)
+    {
+      harness->sequence++;
+      harness_next_sequence (harness);
+    }
+}
+
+static void
+harness_search_cb (GObject      *object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+  Search *search = user_data;
+  Harness *harness = search->harness;
+  g_autoptr(GError) error = NULL;
+  gint64 now = g_get_monotonic_time ();
+
+  harness->active_search_count--;
+
+  g_signal_handlers_disconnect_by_func (search->search_results,
+                                        G_CALLBACK (search_results_items_changed),
+                                        search);
+
+  if (!rtfm_library_search_finish (RTFM_LIBRARY (object), result, &error))
+    {
+      if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        harness->n_cancelled++;
+      else
+        g_printerr ("%s\n", error->message);
+    }
+  else if (harness->first_result != NULL)
+    {
+      gdouble msec;
+
+      if (search->first_result != 0)
+        {
+          msec = (search->first_result - search->keystroke) / 1000.0;
+          g_array_append_val (harness->first_result, msec);
+        }
+      else
+        harness->n_empty++;
+
+      msec = (now - search->keystroke) / 1000.0;
+      g_array_append_val (harness->stable_result, msec);
+    }
+
+  g_object_unref (search->search_results);
+  g_slice_free (Search, search);
+
+  harness_maybe_next_sequence (harness);
+}
+
+static gboolean
+harness_do_search (gpointer user_data)
+{
+  Harness *harness = user_data;
+  Search *search;
+
+  harness->queued_search = 0;
+
+  if (harness->text == NULL || *harness->text == '\0')
+    {
+      harness_maybe_next_sequence (harness);
+      return G_SOURCE_REMOVE;
+    }
+
+  search = g_slice_new0 (Search);
+  search->harness = harness;
+  search->keystroke = harness->last_keystroke;
+  search->search_results = rtfm_search_results_new (SEARCH_MAX_RESULTS);
+
+  g_signal_connect (search->search_results,
+                    "items-changed",
+                    G_CALLBACK (search_results_items_changed),
+                    search);
+
+  harness->search_cancellable = g_cancellable_new ();
+  rtfm_search_settings_set_search_text (harness->search_settings, harness->text);
+
+  harness->active_search_count++;
+
+  rtfm_library_search_async (harness->library,
+                             harness->search_settings,
+                             search->search_results,
+                             harness->search_cancellable,
+                             harness_search_cb,
+                             search);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+harness_keystroke (gpointer user_data)
+{
+  Harness *harness = user_data;
+  GPtrArray *sequence = g_ptr_array_index (harness->sequences, harness->sequence);
+  Keystroke *keystroke = g_ptr_array_index (sequence, harness->keystroke++);
+
+  g_free (harness->text);
+  harness->text = g_strdup (keystroke->text);
+  harness->last_keystroke = g_get_monotonic_time ();
+
+  /* Cancel any active search request, like the search entry does */
+  if (harness->search_cancellable != NULL)
+    g_cancellable_cancel (harness->search_cancellable);
+  g_clear_object (&harness->search_cancellable);
+
+  if (harness->queued_search == 0)
+    harness->queued_search = g_timeout_add (SEARCH_TIMEOUT_DELAY, harness_do_search, harness);
+
+  harness_next_keystroke (harness);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+harness_next_keystroke (Harness *harness)
+{
+  GPtrArray *sequence = g_ptr_array_index (harness->sequences, harness->sequence);
+  Keystroke *keystroke;
+
+  if (harness->keystroke >= sequence->len)
+    return;
+
+  keystroke = g_ptr_array_index (sequence, harness->keystroke);
+  g_timeout_add (keystroke->delay, harness_keystroke, harness);
+}
+
+static void
+harness_next_sequence (Harness *harness)
+{
+  if (harness->sequence >= harness->sequences->len)
+    {
+      g_main_loop_quit (harness->main_loop);
+      return;
+    }
+
+  harness->keystroke = 0;
+  g_clear_pointer (&harness->text, g_free);
+
+  harness_next_keystroke (harness);
+}
+
+static void
+harness_run (Harness *harness)
+{
+  harness->sequence = 0;
+  harness_next_sequence (harness);
+  g_main_loop_run (harness->main_loop);
+}
+
+static gint
+compare_double (gconstpointer a,
+                gconstpointer b)
+{
+  gdouble da = *(const gdouble *)a;
+  gdouble db = *(const gdouble *)b;
+
+  return (da > db) - (da < db);
+}
+
+static gdouble
+percentile (GArray  *sorted,
+            gdouble  pct)
+{
+  guint pos;
+
+  if (sorted->len == 0)
+    return 0.0;
+
+  pos = (guint)ceil (pct / 100.0 * sorted->len);
+  pos = CLAMP (pos, 1, sorted->len);
+
+  return g_array_index (sorted, gdouble, pos - 1);
+}
+
+static void
+report (const gchar *name,
+        GArray      *timings)
+{
+  g_array_sort (timings, compare_double);
+
+  g_print ("%s.p50\t%.3lf\tmsec\n", name, percentile (timings, 50));
+  g_print ("%s.p95\t%.3lf\tmsec\n", name, percentile (timings, 95));
+  g_print ("%s.p99\t%.3lf\tmsec\n", name, percentile (timings, 99));
+  g_print ("%s.max\t%.3lf\tmsec\n", name, percentile (timings, 100));
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+  g_autoptr(GOptionContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  Harness harness = { 0 };
+
+  context = g_option_context_new ("RECORDING - replay typing against the library");
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (argc != 2)
+    {
+      g_autofree gchar *help = g_option_context_get_help (context, TRUE, NULL);
+      g_printerr ("%s\n", help);
+      return EXIT_FAILURE;
+    }
+
+  if (NULL == (harness.sequences = load_sequences (argv[1], &error)))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (harness.sequences->len == 0)
+    {
+      g_printerr ("No keystrokes found in %s\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+
+  /* Load the plugins from the build tree rather than the installed ones */
+  g_setenv ("RTFM_IN_TREE_PLUGINS", "1", FALSE);
+
+  harness.library = rtfm_library_get_default ();
+  harness.search_settings = rtfm_search_settings_new ();
+  harness.main_loop = g_main_loop_new (NULL, FALSE);
+
+  /* Timings are only collected once these are set */
+  if (warmup)
+    harness_run (&harness);
+
+  harness.first_result = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  harness.stable_result = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  harness.n_cancelled = 0;
+  harness.n_empty = 0;
+
+  harness_run (&harness);
+
+  g_print ("searches\t%u\tsearches\n", harness.stable_result->len);
+  g_print ("cancelled\t%u\tsearches\n", harness.n_cancelled);
+  g_print ("empty\t%u\tsearches\n", harness.n_empty);
+  report ("first-result", harness.first_result);
+  report ("stable-result", harness.stable_result);
+
+  g_clear_pointer (&harness.first_result, g_array_unref);
+  g_clear_pointer (&harness.stable_result, g_array_unref);
+  g_clear_pointer (&harness.sequences, g_ptr_array_unref);
+  g_clear_pointer (&harness.main_loop, g_main_loop_unref);
+  g_clear_pointer (&harness.text, g_free);
+  g_clear_object (&harness.search_settings);
+
+  return EXIT_SUCCESS;
+}
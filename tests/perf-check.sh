@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# Runs the benchmarks on fixed synthetic inputs and compares their
+# counters against perf-baseline.txt, failing if any of them grew by
+# more than its tolerance. Only instruction and heap counters are
+# compared, as wall-clock time is too noisy to gate on.
+#
+# With --update, the baseline is rewritten with the current results,
+# keeping the tolerances.
+
+srcdir="${G_TEST_SRCDIR:-.}"
+top_builddir="${RTFM_TOP_BUILDDIR:-..}"
+baseline="$srcdir/perf-baseline.txt"
+update=no
+
+if test "$1" = "--update"; then
+	update=yes
+fi
+
+# These change what the allocator does, and with it the counters.
+unset G_DEBUG G_SLICE MALLOC_CHECK_ MALLOC_PERTURB_
+
+tmpdir=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmpdir"' EXIT
+
+run_bench () {
+	name="$1"
+	shift
+	if ! "$@" > "$tmpdir/$name.out"; then
+		echo "$name: $* failed" >&2
+		exit 1
+	fi
+	sed "s/^/$name	/" "$tmpdir/$name.out" >> "$tmpdir/results"
+}
+
+run_bench fuzzy "$top_builddir/contrib/fuzzy-glib/bench-fuzzy" --keys 10000 --queries 200
+run_bench gir "$top_builddir/plugins/gobject-introspection/bench-gir" --scale 0.1
+
+if test "$update" = yes; then
+	awk -F '\t' -v OFS='\t' '
+		FILENAME == ARGV[1] { result[$1 SUBSEP $2] = $3; next }
+		/^#/ || NF < 4 { print; next }
+		{ if (($1 SUBSEP $2) in result) $3 = result[$1 SUBSEP $2]; print }
+	' "$tmpdir/results" "$baseline" > "$tmpdir/baseline" &&
+	cp "$tmpdir/baseline" "$baseline"
+	exit $?
+fi
+
+awk -F '\t' '
+	FILENAME == ARGV[1] { result[$1 SUBSEP $2] = $3; next }
+	/^#/ || NF < 4 { next }
+	{
+		key = $1 SUBSEP $2
+		name = $1 "/" $2
+		if (!(key in result)) {
+			printf "SKIP %s: not measured on this host\n", name
+		} else if ($3 == "-") {
+			printf "SKIP %s: %s, no baseline recorded\n", name, result[key]
+		} else {
+			limit = $3 + ($3 < 0 ? -$3 : $3) * $4 / 100
+			# Allow for allocator bookkeeping on small heaps
+			if ($2 ~ /\.heap$/ && limit < $3 + 65536)
+				limit = $3 + 65536
+			if (result[key] > limit) {
+				printf "FAIL %s: %s exceeds %s (baseline %s +%s%%)\n", name, result[key], limit, $3, $4
+				failed++
+			} else {
+				printf "PASS %s: %s (baseline %s)\n", name, result[key], $3
+			}
+			checked++
+		}
+	}
+	END { exit failed ? 1 : (checked ? 0 : 77) }
+' "$tmpdir/results" "$baseline"